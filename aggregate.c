@@ -0,0 +1,211 @@
+#include "redismodule.h"
+#include "module.h"
+#include <string.h>
+
+// Aggregates over every counter whose key matches a glob pattern. Walking the keyspace can take a while, so it runs as a
+// background job (background.c) that only holds the GIL for BACKGROUND_KEYS_PER_LOCK keys at a time, and the caller
+// stays blocked until the result is ready. Everything else keeps being served in between the chunks.
+//
+// Like SCAN, keys that exist for the whole walk are counted exactly once, keys created or deleted in the middle of it may
+// or may not be.
+
+typedef enum AggregateOperation {
+    AggregateSum,
+    AggregateCountAbove
+} AggregateOperation;
+
+typedef struct AggregateJob {
+    BackgroundJob background; // Has to come first.
+    AggregateOperation operation;
+    char *pattern;
+    size_t pattern_len;
+    double threshold; // Only used by AggregateCountAbove.
+    double sum;
+    long long count;
+} AggregateJob;
+
+// Glob style matching with the same syntax as KEYS and SCAN MATCH: `*`, `?`, `[abc]`, `[^a-z]` and `\` escapes. `*`
+// is handled by remembering where it was and backtracking, so there's no recursion.
+int aggregate_glob_match(const char *pattern, const size_t pattern_len, const char *string, const size_t string_len) {
+    size_t p = 0, s = 0;
+    size_t star_p = (size_t)-1, star_s = 0;
+
+    while (s < string_len) {
+        if (p < pattern_len) {
+            const char c = pattern[p];
+
+            if (c == '*') {
+                star_p = p++;
+                star_s = s;
+                continue;
+            }
+
+            if (c == '?') {
+                p++;
+                s++;
+                continue;
+            }
+
+            if (c == '[') {
+                size_t q = p + 1;
+                int negate = 0, matched = 0;
+
+                if (q < pattern_len && pattern[q] == '^') {
+                    negate = 1;
+                    q++;
+                }
+
+                while (q < pattern_len && pattern[q] != ']') {
+                    if (pattern[q] == '\\' && q + 1 < pattern_len) {
+                        q++;
+                        matched |= pattern[q] == string[s];
+                    } else if (q + 2 < pattern_len && pattern[q + 1] == '-' && pattern[q + 2] != ']') {
+                        char low = pattern[q], high = pattern[q + 2];
+
+                        if (low > high) {
+                            const char swap = low;
+                            low = high;
+                            high = swap;
+                        }
+
+                        matched |= string[s] >= low && string[s] <= high;
+                        q += 2;
+                    } else {
+                        matched |= pattern[q] == string[s];
+                    }
+
+                    q++;
+                }
+
+                if (matched != negate) {
+                    p = q < pattern_len ? q + 1 : q;
+                    s++;
+                    continue;
+                }
+            } else {
+                const size_t literal = c == '\\' && p + 1 < pattern_len ? p + 1 : p;
+
+                if (pattern[literal] == string[s]) {
+                    p = literal + 1;
+                    s++;
+                    continue;
+                }
+            }
+        }
+
+        // No match here, let the last `*` swallow one more character and try again.
+        if (star_p == (size_t)-1) {
+            return 0;
+        }
+
+        p = star_p + 1;
+        s = ++star_s;
+    }
+
+    while (p < pattern_len && pattern[p] == '*') {
+        p++;
+    }
+
+    return p == pattern_len;
+}
+
+int aggregate_scan_filter(BackgroundJob *background, const char *name, const size_t name_len) {
+    const AggregateJob *job = (const AggregateJob *)background;
+
+    return aggregate_glob_match(job->pattern, job->pattern_len, name, name_len);
+}
+
+void aggregate_scan_counter(RedisModuleCtx *ctx, BackgroundJob *background, RedisModuleString *key_name,
+                            const DegradingCounterData *counter) {
+    AggregateJob *job = (AggregateJob *)background;
+    const double value = degrading_counter_compute_value(ctx, counter, background->now);
+
+    job->sum += value;
+    job->count += value > job->threshold;
+}
+
+void aggregate_reply(RedisModuleCtx *ctx, const BackgroundJob *background) {
+    const AggregateJob *job = (const AggregateJob *)background;
+
+    if (job->operation == AggregateSum) {
+        RedisModule_ReplyWithDouble(ctx, job->sum);
+    } else {
+        RedisModule_ReplyWithLongLong(ctx, job->count);
+    }
+}
+
+void aggregate_free_job(BackgroundJob *background) {
+    AggregateJob *job = (AggregateJob *)background;
+
+    RedisModule_Free(job->pattern);
+    RedisModule_Free(job);
+}
+
+static AggregateJob *aggregate_create_job(const AggregateOperation operation, RedisModuleString *pattern) {
+    AggregateJob *job = RedisModule_Calloc(1, sizeof(AggregateJob));
+    size_t pattern_len;
+    const char *pattern_str = RedisModule_StringPtrLen(pattern, &pattern_len);
+
+    job->background.run = background_scan;
+    job->background.reply = aggregate_reply;
+    job->background.free = aggregate_free_job;
+    job->background.scan_filter = aggregate_scan_filter;
+    job->background.scan_counter = aggregate_scan_counter;
+    job->operation = operation;
+
+    // The arguments are gone by the time the thread runs, so it gets its own copy of the pattern.
+    job->pattern = RedisModule_Alloc(pattern_len);
+    job->pattern_len = pattern_len;
+    memcpy(job->pattern, pattern_str, pattern_len);
+
+    return job;
+}
+
+// DC.SUM pattern
+int aggregate_sum_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    AggregateJob *job = aggregate_create_job(AggregateSum, argv[1]);
+
+    return background_start(ctx, &job->background);
+}
+
+// DC.COUNTABOVE pattern threshold
+int aggregate_count_above_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    double threshold;
+
+    if (RedisModule_StringToDouble(argv[2], &threshold) != REDISMODULE_OK) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR invalid value for threshold: must be a signed double.");
+    }
+
+    AggregateJob *job = aggregate_create_job(AggregateCountAbove, argv[1]);
+    job->threshold = threshold;
+
+    return background_start(ctx, &job->background);
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(aggregate_sum_RedisCommand, StatsSum)
+DEGRADING_COUNTER_TIMED_COMMAND(aggregate_count_above_RedisCommand, StatsCountAbove)
+
+// Called from `RedisModule_OnLoad` to create the commands.
+int aggregate_register(RedisModuleCtx *ctx) {
+    // Neither command takes key names, the pattern is matched against whatever the scan finds.
+    if (RedisModule_CreateCommand(ctx, "dc.sum",
+        aggregate_sum_RedisCommand_Timed, "readonly", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.countabove",
+        aggregate_count_above_RedisCommand_Timed, "readonly", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,128 @@
+#include "redismodule.h"
+#include "module.h"
+#include <pthread.h>
+#include <sched.h>
+
+// The plumbing shared by the commands that work through a whole database (DC.SUM, DC.COUNTABOVE, DC.EXPORT and
+// DC.IMPORT). The job runs on a thread of its own that only takes the GIL for BACKGROUND_KEYS_PER_LOCK keys at a time,
+// so everything else keeps being served in between, and the calling client stays blocked until it's done.
+
+void background_lock(RedisModuleCtx *ctx, const int chunked) {
+    if (chunked) {
+        RedisModule_ThreadSafeContextLock(ctx);
+    }
+}
+
+void background_unlock(RedisModuleCtx *ctx, const int chunked) {
+    if (chunked) {
+        RedisModule_ThreadSafeContextUnlock(ctx);
+        // Give the main thread a chance to pick the lock back up before we ask for it again.
+        sched_yield();
+    }
+}
+
+void background_scan_callback(RedisModuleCtx *ctx, RedisModuleString *key_name, RedisModuleKey *key, void *privdata) {
+    BackgroundJob *job = privdata;
+
+    job->visited++;
+
+    if (job->scan_filter != NULL) {
+        size_t name_len;
+        const char *name = RedisModule_StringPtrLen(key_name, &name_len);
+
+        if (!job->scan_filter(job, name, name_len)) {
+            return;
+        }
+    }
+
+    // The key is only handed to us when Redis could open it cheaply, otherwise we open it ourselves.
+    RedisModuleKey *opened = key == NULL ? RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ) : NULL;
+    const DegradingCounterData *counter = degrading_counter_from_key(key == NULL ? opened : key);
+
+    if (counter != NULL) {
+        job->scan_counter(ctx, job, key_name, counter);
+    }
+
+    if (opened != NULL) {
+        RedisModule_CloseKey(opened);
+    }
+}
+
+// Without `chunked` the caller is expected to be holding the GIL (or be on the main thread) the whole time.
+void background_scan(RedisModuleCtx *ctx, BackgroundJob *job, const int chunked) {
+    RedisModuleScanCursor *cursor = RedisModule_ScanCursorCreate();
+    int more = 1;
+
+    while (more) {
+        background_lock(ctx, chunked);
+
+        job->visited = 0;
+        job->chunk_full = 0;
+        job->now = degrading_counter_clock();
+
+        while (more && (!chunked || job->visited < BACKGROUND_KEYS_PER_LOCK) && !job->chunk_full) {
+            more = RedisModule_Scan(ctx, cursor, background_scan_callback, job);
+        }
+
+        background_unlock(ctx, chunked);
+
+        if (job->scan_chunk_end != NULL && job->scan_chunk_end(ctx, job, more) != 0) {
+            break;
+        }
+    }
+
+    RedisModule_ScanCursorDestroy(cursor);
+}
+
+void *background_thread_main(void *arg) {
+    BackgroundJob *job = arg;
+    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(job->blocked_client);
+
+    job->run(ctx, job, 1);
+
+    RedisModule_FreeThreadSafeContext(ctx);
+    RedisModule_UnblockClient(job->blocked_client, job);
+
+    return NULL;
+}
+
+int background_reply_callback(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    const BackgroundJob *job = RedisModule_GetBlockedClientPrivateData(ctx);
+
+    job->reply(ctx, job);
+    return REDISMODULE_OK;
+}
+
+void background_free_callback(RedisModuleCtx *ctx, void *privdata) {
+    BackgroundJob *job = privdata;
+
+    job->free(job);
+}
+
+int background_start(RedisModuleCtx *ctx, BackgroundJob *job) {
+    // MULTI and scripts can't block, so there the job runs right away on the main thread.
+    if (RedisModule_GetContextFlags(ctx) & (REDISMODULE_CTX_FLAGS_MULTI|REDISMODULE_CTX_FLAGS_LUA|REDISMODULE_CTX_FLAGS_DENY_BLOCKING)) {
+        job->run(ctx, job, 0);
+        job->reply(ctx, job);
+        job->free(job);
+        return REDISMODULE_OK;
+    }
+
+    job->blocked_client = RedisModule_BlockClient(ctx, background_reply_callback, NULL, background_free_callback, 0);
+
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    const int created = pthread_create(&thread, &attributes, background_thread_main, job);
+    pthread_attr_destroy(&attributes);
+
+    if (created != 0) {
+        RedisModule_AbortBlock(job->blocked_client);
+        job->free(job);
+        return RedisModule_ReplyWithError(ctx, "ERR couldn't start the background thread.");
+    }
+
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,319 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Drives a running redis-server that has the module loaded and reports throughput and latency percentiles for DC.INCR
+// (both the full and the short form), DC.ALLOW, DC.DECR and DC.PEEK at a range of key counts and pipeline depths. It
+// speaks RESP over a plain socket so it doesn't need anything beyond libc. Every result is printed as one JSON object
+// per line.
+//
+// Latency is measured per pipeline: from writing a batch of commands until the last reply has been read, which is the
+// latency each command in that batch observed (the same thing redis-benchmark reports with -P).
+//
+// Usage: driver [port] [requests]
+
+#define DRIVER_DEFAULT_PORT 6399
+#define DRIVER_DEFAULT_REQUESTS 200000
+#define DRIVER_BUFFER_SIZE (1 << 20)
+
+static const long DriverKeyCounts[] = { 1, 1000, 100000 };
+static const int DriverPipelineDepths[] = { 1, 16, 128 };
+
+typedef struct Connection {
+    int fd;
+    char *buffer;
+    size_t start, end; // Unread reply bytes are buffer[start, end).
+} Connection;
+
+static double driver_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static void driver_fail(const char *message) {
+    fprintf(stderr, "driver: %s\n", message);
+    exit(1);
+}
+
+static void driver_connect(Connection *connection, const int port) {
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    const int no_delay = 1;
+
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    connection->fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (connection->fd < 0 || connect(connection->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        driver_fail("couldn't connect to redis-server");
+    }
+
+    setsockopt(connection->fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    connection->buffer = malloc(DRIVER_BUFFER_SIZE);
+    connection->start = connection->end = 0;
+}
+
+static void driver_write_all(const Connection *connection, const char *data, size_t len) {
+    while (len > 0) {
+        const ssize_t written = write(connection->fd, data, len);
+
+        if (written <= 0) {
+            driver_fail("write failed");
+        }
+
+        data += written;
+        len -= (size_t)written;
+    }
+}
+
+// Make sure at least one more byte is buffered.
+static void driver_fill(Connection *connection) {
+    if (connection->start == connection->end) {
+        connection->start = connection->end = 0;
+    } else if (connection->end == DRIVER_BUFFER_SIZE) {
+        memmove(connection->buffer, connection->buffer + connection->start, connection->end - connection->start);
+        connection->end -= connection->start;
+        connection->start = 0;
+    }
+
+    const ssize_t received = read(connection->fd, connection->buffer + connection->end, DRIVER_BUFFER_SIZE - connection->end);
+
+    if (received <= 0) {
+        driver_fail("connection closed");
+    }
+
+    connection->end += (size_t)received;
+}
+
+// Read one line, without the CRLF, into `line`.
+static void driver_read_line(Connection *connection, char *line, const size_t line_size) {
+    size_t len = 0;
+
+    for (;;) {
+        while (connection->start < connection->end) {
+            const char c = connection->buffer[connection->start++];
+
+            if (c == '\n') {
+                line[len > 0 && line[len - 1] == '\r' ? len - 1 : len] = '\0';
+                return;
+            }
+
+            if (len + 1 < line_size) {
+                line[len++] = c;
+            }
+        }
+
+        driver_fill(connection);
+    }
+}
+
+static void driver_skip(Connection *connection, size_t len) {
+    while (len > 0) {
+        if (connection->start == connection->end) {
+            driver_fill(connection);
+        }
+
+        const size_t available = connection->end - connection->start;
+        const size_t skipped = available < len ? available : len;
+
+        connection->start += skipped;
+        len -= skipped;
+    }
+}
+
+// Read and discard one reply. Errors are fatal, a benchmark that's measuring error replies isn't measuring anything.
+static void driver_read_reply(Connection *connection) {
+    char line[512];
+    driver_read_line(connection, line, sizeof(line));
+
+    switch (line[0]) {
+        case '-':
+            fprintf(stderr, "driver: %s\n", line);
+            exit(1);
+
+        case '$': {
+            const long len = atol(line + 1);
+
+            if (len >= 0) {
+                driver_skip(connection, (size_t)len + 2);
+            }
+
+            return;
+        }
+
+        case '*': {
+            const long count = atol(line + 1);
+
+            for (long i = 0; i < count; i++) {
+                driver_read_reply(connection);
+            }
+
+            return;
+        }
+
+        default: // Simple strings, integers, doubles and nulls are a single line.
+            return;
+    }
+}
+
+static size_t driver_append_command(char *out, const int argc, const char **argv) {
+    size_t len = (size_t)sprintf(out, "*%d\r\n", argc);
+
+    for (int i = 0; i < argc; i++) {
+        len += (size_t)sprintf(out + len, "$%zu\r\n%s\r\n", strlen(argv[i]), argv[i]);
+    }
+
+    return len;
+}
+
+static size_t driver_append_counter_command(char *out, const char *command, const long key) {
+    char key_name[32];
+    snprintf(key_name, sizeof(key_name), "bench:%ld", key);
+
+    if (strcmp(command, "DC.INCR") == 0) {
+        // The counter degrades slowly enough that nothing expires while the benchmark runs.
+        const char *argv[] = { "DC.INCR", key_name, "AMOUNT", "1", "DEGRADE_RATE", "1", "INTERVAL", "60min" };
+        return driver_append_command(out, 8, argv);
+    }
+
+    // The keys all exist by now, so the short form just adds to them.
+    if (strcmp(command, "DC.INCR/short") == 0) {
+        const char *argv[] = { "DC.INCR", key_name, "1" };
+        return driver_append_command(out, 3, argv);
+    }
+
+    // The limit is well above anything the populated keys reach, so every call is allowed and writes.
+    if (strcmp(command, "DC.ALLOW") == 0) {
+        const char *argv[] = { "DC.ALLOW", key_name, "COST", "1", "LIMIT", "1000000000" };
+        return driver_append_command(out, 6, argv);
+    }
+
+    if (strcmp(command, "DC.DECR") == 0) {
+        const char *argv[] = { "DC.DECR", key_name, "0.001" };
+        return driver_append_command(out, 3, argv);
+    }
+
+    const char *argv[] = { command, key_name };
+    return driver_append_command(out, 2, argv);
+}
+
+static int driver_compare_doubles(const void *a, const void *b) {
+    const double left = *(const double *)a, right = *(const double *)b;
+
+    return (left > right) - (left < right);
+}
+
+static double driver_percentile(const double *sorted, const long count, const double percentile) {
+    long index = (long)(percentile * (double)count);
+
+    return sorted[index >= count ? count - 1 : index];
+}
+
+// xorshift, so every run picks the same sequence of keys.
+static long driver_next_key(uint64_t *state, const long key_count) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return (long)(*state % (uint64_t)key_count);
+}
+
+static void driver_populate(Connection *connection, char *out, const long key_count) {
+    const char *flush[] = { "FLUSHALL" };
+    driver_write_all(connection, out, driver_append_command(out, 1, flush));
+    driver_read_reply(connection);
+
+    // Give every key plenty of headroom so DC.DECR never takes one down to zero.
+    for (long key = 0; key < key_count; key += 1000) {
+        size_t len = 0;
+        const long batch_end = key + 1000 < key_count ? key + 1000 : key_count;
+
+        for (long k = key; k < batch_end; k++) {
+            char key_name[32];
+            snprintf(key_name, sizeof(key_name), "bench:%ld", k);
+            const char *argv[] = { "DC.INCR", key_name, "AMOUNT", "1000000", "DEGRADE_RATE", "1", "INTERVAL", "60min" };
+            len += driver_append_command(out + len, 8, argv);
+        }
+
+        driver_write_all(connection, out, len);
+
+        for (long k = key; k < batch_end; k++) {
+            driver_read_reply(connection);
+        }
+    }
+}
+
+static void driver_run(Connection *connection, char *out, double *latencies, const char *command, const long key_count,
+                       const int depth, const long requests) {
+    const long batches = requests / depth;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    const double started = driver_now_ns();
+
+    for (long batch = 0; batch < batches; batch++) {
+        size_t len = 0;
+
+        for (int i = 0; i < depth; i++) {
+            len += driver_append_counter_command(out + len, command, driver_next_key(&state, key_count));
+        }
+
+        const double batch_started = driver_now_ns();
+        driver_write_all(connection, out, len);
+
+        for (int i = 0; i < depth; i++) {
+            driver_read_reply(connection);
+        }
+
+        latencies[batch] = (driver_now_ns() - batch_started) / 1000.0;
+    }
+
+    const double elapsed_ns = driver_now_ns() - started;
+
+    qsort(latencies, (size_t)batches, sizeof(double), driver_compare_doubles);
+
+    printf("{\"suite\":\"server\",\"command\":\"%s\",\"keys\":%ld,\"pipeline\":%d,\"requests\":%ld,"
+           "\"ops_per_sec\":%.0f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f}\n",
+           command, key_count, depth, batches * depth,
+           (double)(batches * depth) / (elapsed_ns / 1e9),
+           driver_percentile(latencies, batches, 0.5),
+           driver_percentile(latencies, batches, 0.99),
+           driver_percentile(latencies, batches, 0.999));
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const int port = argc > 1 ? atoi(argv[1]) : DRIVER_DEFAULT_PORT;
+    const long requests = argc > 2 ? atol(argv[2]) : DRIVER_DEFAULT_REQUESTS;
+    const char *commands[] = { "DC.INCR", "DC.INCR/short", "DC.ALLOW", "DC.DECR", "DC.PEEK" };
+
+    Connection connection;
+    driver_connect(&connection, port);
+
+    char *out = malloc(DRIVER_BUFFER_SIZE);
+    double *latencies = malloc(sizeof(double) * (size_t)requests);
+
+    for (size_t k = 0; k < sizeof(DriverKeyCounts) / sizeof(DriverKeyCounts[0]); k++) {
+        driver_populate(&connection, out, DriverKeyCounts[k]);
+
+        for (size_t c = 0; c < sizeof(commands) / sizeof(commands[0]); c++) {
+            for (size_t d = 0; d < sizeof(DriverPipelineDepths) / sizeof(DriverPipelineDepths[0]); d++) {
+                driver_run(&connection, out, latencies, commands[c], DriverKeyCounts[k], DriverPipelineDepths[d], requests);
+            }
+        }
+    }
+
+    free(latencies);
+    free(out);
+    close(connection.fd);
+
+    return 0;
+}
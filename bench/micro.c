@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "redismodule.h"
+#include "../module.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Microbenchmarks for the hot paths of the counter code, run against the stub in stub.c rather than a real server. Each
+// result is printed as one JSON object per line so runs can be diffed or loaded into whatever tracks regressions.
+
+#define BENCH_DEFAULT_ITERATIONS 5000000
+
+RedisModuleString *bench_stub_string(const char *value);
+void bench_stub_init(void);
+
+// Keeps the compiler from optimizing away work whose result we never look at.
+static volatile double BenchSink;
+
+static double bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static void bench_report(const char *name, const long iterations, const double elapsed_ns) {
+    printf("{\"suite\":\"micro\",\"benchmark\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f}\n",
+           name, iterations, elapsed_ns / (double)iterations, (double)iterations / (elapsed_ns / 1e9));
+}
+
+static DegradingCounterData *bench_create_counter(const char **pairs, const int pair_count) {
+    RedisModuleString *argv[12];
+
+    argv[0] = bench_stub_string("DC.INCR");
+    argv[1] = bench_stub_string("bench");
+
+    for (int i = 0; i < pair_count; i++) {
+        argv[2 + i] = bench_stub_string(pairs[i]);
+    }
+
+    DegradingCounterData *counter = get_degrading_counter_data_from_redis_arguments(NULL, argv, 2 + pair_count);
+
+    // The parser leaves the creation time to the command, pretend it was created just now.
+    counter->created_offset = (uint64_t)(RedisModule_Milliseconds() - DEGRADING_COUNTER_EPOCH_MS);
+
+    return counter;
+}
+
+static void bench_compute_value(const char *name, DegradingCounterData *counter, const long iterations) {
+    const ustime_t now = degrading_counter_clock();
+    const double started = bench_now_ns();
+
+    for (long i = 0; i < iterations; i++) {
+        BenchSink += degrading_counter_compute_value(NULL, counter, now);
+    }
+
+    bench_report(name, iterations, bench_now_ns() - started);
+}
+
+// Packing for the RDB, the result also records how many bytes the record took (before the string header RDB adds).
+static void bench_rdb_pack(const char *name, const DegradingCounterData *counter, const long iterations) {
+    unsigned char packed[DEGRADING_COUNTER_MAX_PACKED_SIZE];
+    const mstime_t epoch = RedisModule_Milliseconds();
+    size_t packed_len = 0;
+    const double started = bench_now_ns();
+
+    for (long i = 0; i < iterations; i++) {
+        packed_len = degrading_counter_pack(counter, &epoch, epoch * MICROSECONDS_PER_MILLISECOND, packed);
+        BenchSink += packed[0];
+    }
+
+    const double elapsed_ns = bench_now_ns() - started;
+
+    printf("{\"suite\":\"micro\",\"benchmark\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f,\"packed_bytes\":%zu}\n",
+           name, iterations, elapsed_ns / (double)iterations, (double)iterations / (elapsed_ns / 1e9), packed_len);
+}
+
+static void bench_rdb_unpack(const char *name, const DegradingCounterData *counter, const long iterations) {
+    unsigned char packed[DEGRADING_COUNTER_MAX_PACKED_SIZE];
+    const mstime_t epoch = RedisModule_Milliseconds();
+    const size_t packed_len = degrading_counter_pack(counter, &epoch, epoch * MICROSECONDS_PER_MILLISECOND, packed);
+    DegradingCounterData unpacked;
+    const double started = bench_now_ns();
+
+    for (long i = 0; i < iterations; i++) {
+        degrading_counter_unpack(packed, packed_len, &epoch, &unpacked);
+        BenchSink += unpacked.value;
+    }
+
+    bench_report(name, iterations, bench_now_ns() - started);
+}
+
+static void bench_parse_interval_string(const long iterations) {
+    const char *intervals[] = { "250ms", "5sec", "60min", "1000000ms" };
+    int number_of_increments;
+    CounterIncrements unit;
+    const double started = bench_now_ns();
+
+    for (long i = 0; i < iterations; i++) {
+        degrading_counter_parse_interval_string(intervals[i & 3], &number_of_increments, &unit);
+        BenchSink += number_of_increments;
+    }
+
+    bench_report("parse_interval_string", iterations, bench_now_ns() - started);
+}
+
+static void bench_parse_arguments(const char *name, const char **pairs, const int pair_count, const long iterations) {
+    RedisModuleString *argv[12];
+
+    argv[0] = bench_stub_string("DC.INCR");
+    argv[1] = bench_stub_string("bench");
+
+    for (int i = 0; i < pair_count; i++) {
+        argv[2 + i] = bench_stub_string(pairs[i]);
+    }
+
+    const double started = bench_now_ns();
+
+    for (long i = 0; i < iterations; i++) {
+        DegradingCounterData *counter = get_degrading_counter_data_from_redis_arguments(NULL, argv, 2 + pair_count);
+
+        BenchSink += counter->value;
+        degrading_counter_free(counter);
+    }
+
+    bench_report(name, iterations, bench_now_ns() - started);
+}
+
+int main(int argc, char **argv) {
+    const long iterations = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+
+    bench_stub_init();
+    degrading_counter_init();
+
+    const char *linear[] = { "AMOUNT", "1000", "DEGRADE_RATE", "1.5", "INTERVAL", "5sec" };
+    const char *exponential[] = { "AMOUNT", "1000", "DECAY", "EXP", "HALFLIFE", "60min" };
+
+    const char *counting[] = { "AMOUNT", "42", "DEGRADE_RATE", "1", "INTERVAL", "60min" };
+    DegradingCounterData *linear_counter = bench_create_counter(linear, 6);
+    DegradingCounterData *exponential_counter = bench_create_counter(exponential, 6);
+    DegradingCounterData *counting_counter = bench_create_counter(counting, 6);
+
+    bench_compute_value("compute_value_linear", linear_counter, iterations);
+    bench_compute_value("compute_value_exponential", exponential_counter, iterations);
+    bench_rdb_pack("rdb_pack_linear", linear_counter, iterations);
+    bench_rdb_pack("rdb_pack_exponential", exponential_counter, iterations);
+    bench_rdb_pack("rdb_pack_whole_numbers", counting_counter, iterations);
+    bench_rdb_unpack("rdb_unpack_linear", linear_counter, iterations);
+    bench_rdb_unpack("rdb_unpack_exponential", exponential_counter, iterations);
+    bench_parse_interval_string(iterations);
+    bench_parse_arguments("parse_arguments_linear", linear, 6, iterations);
+    bench_parse_arguments("parse_arguments_exponential", exponential, 6, iterations);
+
+    return 0;
+}
@@ -0,0 +1,26 @@
+#!/usr/bin/bash
+# Runs the whole benchmark suite: the microbenchmarks against the stubbed module API, then the server benchmarks against
+# a throwaway redis-server with the module loaded. Every result is a JSON object on its own line on stdout.
+#
+# Usage: bench/run.sh <module.so> [micro iterations] [server requests]
+set -euo pipefail
+
+MODULE=$(realpath "$1")
+ITERATIONS=${2:-5000000}
+REQUESTS=${3:-200000}
+REDIS_SERVER=${REDIS_SERVER:-redis-server}
+PORT=${BENCH_PORT:-6399}
+BENCH_DIR=$(dirname "$0")
+
+"$BENCH_DIR/micro" "$ITERATIONS"
+
+# Persistence is off so disk speed doesn't end up in the numbers.
+"$REDIS_SERVER" --port "$PORT" --save "" --appendonly no --loadmodule "$MODULE" > /dev/null &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2> /dev/null' EXIT
+
+until (exec 3<> "/dev/tcp/127.0.0.1/$PORT") 2> /dev/null; do
+    sleep 0.1
+done
+
+"$BENCH_DIR/driver" "$PORT" "$REQUESTS"
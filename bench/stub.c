@@ -0,0 +1,87 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "redismodule.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Just enough of the module API to run the counter code outside of Redis. Redis fills in the `RedisModule_*` function
+// pointers when the module is loaded, here `bench_stub_init` points the ones the benchmarks reach at these instead.
+// Everything else stays NULL, so a benchmark that wanders into an API we haven't stubbed crashes loudly.
+
+struct RedisModuleString {
+    const char *ptr;
+    size_t len;
+};
+
+RedisModuleString *bench_stub_string(const char *value) {
+    RedisModuleString *string = malloc(sizeof(RedisModuleString));
+
+    string->ptr = value;
+    string->len = strlen(value);
+
+    return string;
+}
+
+static void *bench_stub_alloc(size_t bytes) {
+    return malloc(bytes);
+}
+
+static void *bench_stub_realloc(void *ptr, size_t bytes) {
+    return realloc(ptr, bytes);
+}
+
+static void *bench_stub_calloc(size_t count, size_t bytes) {
+    return calloc(count, bytes);
+}
+
+static void bench_stub_free(void *ptr) {
+    free(ptr);
+}
+
+static long long bench_stub_milliseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static const char *bench_stub_string_ptr_len(const RedisModuleString *string, size_t *len) {
+    if (len != NULL) {
+        *len = string->len;
+    }
+
+    return string->ptr;
+}
+
+static int bench_stub_string_to_double(const RedisModuleString *string, double *value) {
+    char *end;
+    *value = strtod(string->ptr, &end);
+
+    return end == string->ptr + string->len && string->len > 0 ? REDISMODULE_OK : REDISMODULE_ERR;
+}
+
+static int bench_stub_reply_with_error(RedisModuleCtx *ctx, const char *error) {
+    return REDISMODULE_OK;
+}
+
+static int bench_stub_reply_with_error_format(RedisModuleCtx *ctx, const char *format, ...) {
+    return REDISMODULE_OK;
+}
+
+static void bench_stub_log(RedisModuleCtx *ctx, const char *level, const char *format, ...) {
+}
+
+void bench_stub_init(void) {
+    RedisModule_Alloc = bench_stub_alloc;
+    RedisModule_Calloc = bench_stub_calloc;
+    RedisModule_Realloc = bench_stub_realloc;
+    RedisModule_Free = bench_stub_free;
+    RedisModule_Milliseconds = bench_stub_milliseconds;
+    RedisModule_StringPtrLen = bench_stub_string_ptr_len;
+    RedisModule_StringToDouble = bench_stub_string_to_double;
+    RedisModule_ReplyWithError = bench_stub_reply_with_error;
+    RedisModule_ReplyWithErrorFormat = bench_stub_reply_with_error_format;
+    RedisModule_Log = bench_stub_log;
+}
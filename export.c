@@ -0,0 +1,519 @@
+#define _POSIX_C_SOURCE 200809L // For `fstat`, `fileno` and `ftello`.
+#include "redismodule.h"
+#include "module.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Moving every counter off a node one key at a time (MIGRATE, or DUMP and RESTORE) goes through the generic per-key
+// serialization for each of them. DC.EXPORT instead writes the raw fields of every counter in the database to a local
+// file, and DC.IMPORT loads a file like that on another node, both as a background job (background.c) that only holds
+// the GIL for BACKGROUND_KEYS_PER_LOCK keys at a time. The calling client stays blocked until the file is done.
+//
+// The file is a header followed by blocks of up to EXPORT_COUNTERS_PER_BLOCK counters, ending with an empty block. Each
+// block is columnar, every field of every counter in it stored together, and every column starts on an 8 byte boundary
+// so a block can be used straight out of a read buffer (or an mmap) without copying it apart:
+//
+//     ExportBlockHeader
+//     uint64_t key_offsets[count + 1]    Key `i` is `keys[key_offsets[i]]` up to `keys[key_offsets[i + 1]]`.
+//     double value[count]
+//     double degrades_at[count]
+//     int64_t created[count]             Absolute Unix microseconds.
+//     uint32_t number_of_increments[count]
+//     uint8_t increment[count]
+//     uint8_t decay[count]
+//     char keys[keys_bytes]
+//
+// Everything is in the byte order of the node that wrote it, which the header records. Only the degrading counters
+// themselves (DC.INCR keys) are exported, counters that have already reached zero are left out.
+
+#define EXPORT_FILE_MAGIC "DCEXPORT"
+#define EXPORT_FILE_VERSION 1
+#define EXPORT_BYTE_ORDER_MARK 0x01020304u
+
+#define EXPORT_COUNTERS_PER_BLOCK 65536
+
+// A single scan step can take a block a little past EXPORT_COUNTERS_PER_BLOCK. The import turns away a header with more
+// than this, or one bigger than what's left of the file, before allocating for it.
+#define EXPORT_MAX_COUNTERS_PER_BLOCK (1 << 24)
+
+// Files are written through a buffer this big, and read a whole block at a time.
+#define EXPORT_IO_BUFFER_SIZE (1 << 20)
+
+typedef struct ExportFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+} ExportFileHeader;
+
+typedef struct ExportBlockHeader {
+    uint32_t count; // 0 marks the end of the file.
+    uint32_t reserved;
+    uint64_t keys_bytes;
+} ExportBlockHeader;
+
+// Where each column starts, relative to the end of the block header, and how big the block is in total.
+typedef struct ExportBlockLayout {
+    size_t key_offsets;
+    size_t value;
+    size_t degrades_at;
+    size_t created;
+    size_t number_of_increments;
+    size_t increment;
+    size_t decay;
+    size_t keys;
+    size_t size;
+} ExportBlockLayout;
+
+// A block being filled in by the export (one array per column, grown as needed) or read back by the import (every
+// column pointing into `buffer`).
+typedef struct ExportBlock {
+    uint32_t count;
+    uint32_t capacity;
+    size_t keys_bytes;
+    size_t keys_capacity;
+    uint64_t *key_offsets;
+    double *value;
+    double *degrades_at;
+    int64_t *created;
+    uint32_t *number_of_increments;
+    uint8_t *increment;
+    uint8_t *decay;
+    char *keys;
+    char *buffer; // Only used by the import.
+} ExportBlock;
+
+typedef struct ExportJob {
+    BackgroundJob background; // Has to come first.
+    FILE *file;
+    char *path; // Where the file ends up. The export writes to `temporary_path` and renames it once it's complete.
+    char *temporary_path; // Only used by the export.
+    ExportBlock block;
+    long long counters; // Exported or imported.
+    const char *error; // Set if the job failed, replied to the client instead of the count.
+} ExportJob;
+
+static inline size_t export_align(const size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+static ExportBlockLayout export_block_layout(const size_t count, const size_t keys_bytes) {
+    ExportBlockLayout layout;
+    size_t position = 0;
+
+    layout.key_offsets = position;
+    position += export_align((count + 1) * sizeof(uint64_t));
+    layout.value = position;
+    position += export_align(count * sizeof(double));
+    layout.degrades_at = position;
+    position += export_align(count * sizeof(double));
+    layout.created = position;
+    position += export_align(count * sizeof(int64_t));
+    layout.number_of_increments = position;
+    position += export_align(count * sizeof(uint32_t));
+    layout.increment = position;
+    position += export_align(count);
+    layout.decay = position;
+    position += export_align(count);
+    layout.keys = position;
+    position += export_align(keys_bytes);
+    layout.size = position;
+
+    return layout;
+}
+
+static void export_block_free(ExportBlock *block) {
+    // A block that was read back owns a single buffer, the columns only point into it.
+    if (block->buffer != NULL) {
+        RedisModule_Free(block->buffer);
+    } else {
+        RedisModule_Free(block->key_offsets);
+        RedisModule_Free(block->value);
+        RedisModule_Free(block->degrades_at);
+        RedisModule_Free(block->created);
+        RedisModule_Free(block->number_of_increments);
+        RedisModule_Free(block->increment);
+        RedisModule_Free(block->decay);
+        RedisModule_Free(block->keys);
+    }
+
+    memset(block, 0, sizeof(ExportBlock));
+}
+
+// ------- Export
+
+// Make room for one more counter, and `key_len` more bytes of key names.
+static void export_block_reserve(ExportBlock *block, const size_t key_len) {
+    if (block->count == block->capacity) {
+        const uint32_t capacity = block->capacity == 0 ? 1024 : block->capacity * 2;
+
+        block->key_offsets = RedisModule_Realloc(block->key_offsets, (capacity + 1) * sizeof(uint64_t));
+        block->value = RedisModule_Realloc(block->value, capacity * sizeof(double));
+        block->degrades_at = RedisModule_Realloc(block->degrades_at, capacity * sizeof(double));
+        block->created = RedisModule_Realloc(block->created, capacity * sizeof(int64_t));
+        block->number_of_increments = RedisModule_Realloc(block->number_of_increments, capacity * sizeof(uint32_t));
+        block->increment = RedisModule_Realloc(block->increment, capacity);
+        block->decay = RedisModule_Realloc(block->decay, capacity);
+        block->capacity = capacity;
+    }
+
+    if (block->keys_bytes + key_len > block->keys_capacity) {
+        size_t keys_capacity = block->keys_capacity == 0 ? 65536 : block->keys_capacity;
+
+        while (block->keys_bytes + key_len > keys_capacity) {
+            keys_capacity *= 2;
+        }
+
+        block->keys = RedisModule_Realloc(block->keys, keys_capacity);
+        block->keys_capacity = keys_capacity;
+    }
+}
+
+static int export_write_column(FILE *file, const void *column, const size_t size) {
+    static const char padding[8] = {0};
+    const size_t padding_len = export_align(size) - size;
+
+    return (size == 0 || fwrite(column, size, 1, file) == 1) &&
+           (padding_len == 0 || fwrite(padding, padding_len, 1, file) == 1) ? 0 : -1;
+}
+
+// Write out whatever is in the block and start it over. Returns 0 on success, -1 if the write failed.
+static int export_write_block(FILE *file, ExportBlock *block) {
+    const ExportBlockHeader header = { .count = block->count, .reserved = 0, .keys_bytes = block->keys_bytes };
+    const size_t count = block->count;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    block->key_offsets[count] = block->keys_bytes;
+
+    const int failed = fwrite(&header, sizeof(header), 1, file) != 1 ||
+        export_write_column(file, block->key_offsets, (count + 1) * sizeof(uint64_t)) != 0 ||
+        export_write_column(file, block->value, count * sizeof(double)) != 0 ||
+        export_write_column(file, block->degrades_at, count * sizeof(double)) != 0 ||
+        export_write_column(file, block->created, count * sizeof(int64_t)) != 0 ||
+        export_write_column(file, block->number_of_increments, count * sizeof(uint32_t)) != 0 ||
+        export_write_column(file, block->increment, count) != 0 ||
+        export_write_column(file, block->decay, count) != 0 ||
+        export_write_column(file, block->keys, block->keys_bytes) != 0;
+
+    block->count = 0;
+    block->keys_bytes = 0;
+
+    return failed ? -1 : 0;
+}
+
+void export_scan_counter(RedisModuleCtx *ctx, BackgroundJob *background, RedisModuleString *key_name,
+                         const DegradingCounterData *counter) {
+    ExportJob *job = (ExportJob *)background;
+
+    if (is_approximately_zero(degrading_counter_compute_value(ctx, counter, background->now), CLOSE_ENOUGH_TO_ZERO)) {
+        return;
+    }
+
+    ExportBlock *block = &job->block;
+    DegradingCounterFields fields;
+    size_t name_len;
+    const char *name = RedisModule_StringPtrLen(key_name, &name_len);
+
+    degrading_counter_get_fields(counter, &fields);
+    export_block_reserve(block, name_len);
+
+    const uint32_t i = block->count++;
+
+    block->key_offsets[i] = block->keys_bytes;
+    block->value[i] = fields.value;
+    block->degrades_at[i] = fields.degrades_at;
+    block->created[i] = fields.created;
+    block->number_of_increments[i] = fields.number_of_increments;
+    block->increment[i] = fields.increment;
+    block->decay[i] = fields.decay;
+    memcpy(block->keys + block->keys_bytes, name, name_len);
+    block->keys_bytes += name_len;
+
+    // A full block ends the chunk so it gets written out.
+    background->chunk_full = block->count >= EXPORT_COUNTERS_PER_BLOCK;
+}
+
+// Called with the GIL released, so that's when the file is written to.
+int export_scan_chunk_end(RedisModuleCtx *ctx, BackgroundJob *background, const int more) {
+    ExportJob *job = (ExportJob *)background;
+
+    if (job->block.count >= EXPORT_COUNTERS_PER_BLOCK || !more) {
+        const long long written = job->block.count;
+
+        if (export_write_block(job->file, &job->block) != 0) {
+            job->error = "ERR couldn't write the export file.";
+        }
+
+        job->counters += written;
+    }
+
+    return job->error != NULL;
+}
+
+// Walk the whole database, writing every block as it fills up.
+void export_run_write(RedisModuleCtx *ctx, BackgroundJob *background, const int chunked) {
+    ExportJob *job = (ExportJob *)background;
+
+    background_scan(ctx, background, chunked);
+
+    const ExportBlockHeader end = {0};
+
+    if (job->error == NULL && (fwrite(&end, sizeof(end), 1, job->file) != 1 || fflush(job->file) != 0)) {
+        job->error = "ERR couldn't write the export file.";
+    }
+
+    // Only a complete file ever shows up under the name that was asked for.
+    const int closed = fclose(job->file);
+    job->file = NULL;
+
+    if (job->error == NULL && (closed != 0 || rename(job->temporary_path, job->path) != 0)) {
+        job->error = "ERR couldn't write the export file.";
+    }
+
+    if (job->error != NULL) {
+        remove(job->temporary_path);
+    }
+}
+
+// ------- Import
+
+// Read the next block into `job->block`. Returns 1 if there was one, 0 at the end of the file and -1 if the file is
+// truncated or doesn't make sense.
+static int export_read_block(ExportJob *job) {
+    ExportBlock *block = &job->block;
+    ExportBlockHeader header;
+
+    if (fread(&header, sizeof(header), 1, job->file) != 1) {
+        return -1;
+    }
+
+    if (header.count == 0) {
+        return 0;
+    }
+
+    if (header.count > EXPORT_MAX_COUNTERS_PER_BLOCK || header.keys_bytes > UINT32_MAX) {
+        return -1;
+    }
+
+    const ExportBlockLayout layout = export_block_layout(header.count, header.keys_bytes);
+    struct stat file_stat;
+    const off_t position = ftello(job->file);
+
+    // A corrupt or truncated file could otherwise have us allocating gigabytes, and a failed allocation takes the server
+    // down with it. No block is bigger than the rest of the file.
+    if (position < 0 || fstat(fileno(job->file), &file_stat) != 0 || position > file_stat.st_size ||
+        layout.size > (uint64_t)(file_stat.st_size - position)) {
+        return -1;
+    }
+
+    RedisModule_Free(block->buffer);
+    block->buffer = RedisModule_Alloc(layout.size);
+
+    if (fread(block->buffer, layout.size, 1, job->file) != 1) {
+        return -1;
+    }
+
+    block->count = header.count;
+    block->keys_bytes = header.keys_bytes;
+    block->key_offsets = (uint64_t *)(block->buffer + layout.key_offsets);
+    block->value = (double *)(block->buffer + layout.value);
+    block->degrades_at = (double *)(block->buffer + layout.degrades_at);
+    block->created = (int64_t *)(block->buffer + layout.created);
+    block->number_of_increments = (uint32_t *)(block->buffer + layout.number_of_increments);
+    block->increment = (uint8_t *)(block->buffer + layout.increment);
+    block->decay = (uint8_t *)(block->buffer + layout.decay);
+    block->keys = block->buffer + layout.keys;
+
+    // Every key has to fit inside the block, in order.
+    for (uint32_t i = 0; i < block->count; i++) {
+        if (block->key_offsets[i] > block->key_offsets[i + 1]) {
+            return -1;
+        }
+    }
+
+    return block->key_offsets[0] == 0 && block->key_offsets[block->count] == block->keys_bytes ? 1 : -1;
+}
+
+// Load the file a block at a time, storing the counters in it BACKGROUND_KEYS_PER_LOCK at a time. Reading happens with
+// the GIL released.
+void export_run_read(RedisModuleCtx *ctx, BackgroundJob *background, const int chunked) {
+    ExportJob *job = (ExportJob *)background;
+    int read;
+
+    while ((read = export_read_block(job)) == 1) {
+        ExportBlock *block = &job->block;
+
+        for (uint32_t start = 0; start < block->count; start += BACKGROUND_KEYS_PER_LOCK) {
+            const uint32_t end = block->count - start < BACKGROUND_KEYS_PER_LOCK ? block->count : start + BACKGROUND_KEYS_PER_LOCK;
+
+            background_lock(ctx, chunked);
+
+            const ustime_t now = degrading_counter_clock();
+
+            for (uint32_t i = start; i < end; i++) {
+                const DegradingCounterFields fields = {
+                    .value = block->value[i],
+                    .degrades_at = block->degrades_at[i],
+                    .created = block->created[i],
+                    .number_of_increments = block->number_of_increments[i],
+                    .increment = block->increment[i],
+                    .decay = block->decay[i]
+                };
+                RedisModuleString *key_name = RedisModule_CreateString(ctx, block->keys + block->key_offsets[i],
+                                                                       block->key_offsets[i + 1] - block->key_offsets[i]);
+
+                job->counters += degrading_counter_import(ctx, key_name, &fields, now) == 1;
+                RedisModule_FreeString(ctx, key_name);
+            }
+
+            background_unlock(ctx, chunked);
+        }
+    }
+
+    if (read != 0) {
+        job->error = "ERR the import file is truncated or corrupt.";
+    }
+}
+
+// ------- Commands
+
+void export_reply(RedisModuleCtx *ctx, const BackgroundJob *background) {
+    const ExportJob *job = (const ExportJob *)background;
+
+    if (job->error != NULL) {
+        RedisModule_ReplyWithError(ctx, job->error);
+    } else {
+        RedisModule_ReplyWithLongLong(ctx, job->counters);
+    }
+}
+
+void export_free_job(BackgroundJob *background) {
+    ExportJob *job = (ExportJob *)background;
+
+    if (job->file != NULL) {
+        fclose(job->file);
+
+        // An export that never got to run leaves nothing half written behind.
+        if (job->temporary_path != NULL) {
+            remove(job->temporary_path);
+        }
+    }
+
+    export_block_free(&job->block);
+    RedisModule_Free(job->path);
+    RedisModule_Free(job->temporary_path);
+    RedisModule_Free(job);
+}
+
+// A NUL terminated copy of `string`, with `suffix` on the end.
+static char *export_copy_path(RedisModuleString *string, const char *suffix) {
+    size_t len;
+    const char *path = RedisModule_StringPtrLen(string, &len);
+    const size_t suffix_len = strlen(suffix);
+    char *copy = RedisModule_Alloc(len + suffix_len + 1);
+
+    memcpy(copy, path, len);
+    memcpy(copy + len, suffix, suffix_len + 1);
+
+    return copy;
+}
+
+// Shared by both commands before they open the file.
+static ExportJob *export_create_job(void (*run)(RedisModuleCtx *, BackgroundJob *, int), RedisModuleString *path) {
+    ExportJob *job = RedisModule_Calloc(1, sizeof(ExportJob));
+
+    job->background.run = run;
+    job->background.reply = export_reply;
+    job->background.free = export_free_job;
+    job->background.scan_counter = export_scan_counter;
+    job->background.scan_chunk_end = export_scan_chunk_end;
+    job->path = export_copy_path(path, "");
+
+    return job;
+}
+
+// DC.EXPORT path
+int export_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    ExportJob *job = export_create_job(export_run_write, argv[1]);
+
+    job->temporary_path = export_copy_path(argv[1], ".tmp");
+
+    // The file is opened here so a bad path is reported right away instead of after a walk of the keyspace.
+    const ExportFileHeader header = { .magic = EXPORT_FILE_MAGIC, .version = EXPORT_FILE_VERSION, .byte_order = EXPORT_BYTE_ORDER_MARK };
+
+    if ((job->file = fopen(job->temporary_path, "wb")) == NULL) {
+        export_free_job(&job->background);
+        return RedisModule_ReplyWithError(ctx, "ERR couldn't create the export file.");
+    }
+
+    setvbuf(job->file, NULL, _IOFBF, EXPORT_IO_BUFFER_SIZE);
+
+    if (fwrite(&header, sizeof(header), 1, job->file) != 1) {
+        export_free_job(&job->background);
+        return RedisModule_ReplyWithError(ctx, "ERR couldn't write the export file.");
+    }
+
+    return background_start(ctx, &job->background);
+}
+
+// DC.IMPORT path
+int import_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    ExportJob *job = export_create_job(export_run_read, argv[1]);
+    ExportFileHeader header;
+
+    if ((job->file = fopen(job->path, "rb")) == NULL) {
+        export_free_job(&job->background);
+        return RedisModule_ReplyWithError(ctx, "ERR couldn't open the import file.");
+    }
+
+    if (fread(&header, sizeof(header), 1, job->file) != 1 ||
+        memcmp(header.magic, EXPORT_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        export_free_job(&job->background);
+        return RedisModule_ReplyWithError(ctx, "ERR not a DC.EXPORT file.");
+    }
+
+    // The columns are read as they are, there's no converting them.
+    if (header.byte_order != EXPORT_BYTE_ORDER_MARK) {
+        export_free_job(&job->background);
+        return RedisModule_ReplyWithError(ctx, "ERR the import file was written with a different byte order.");
+    }
+
+    if (header.version != EXPORT_FILE_VERSION) {
+        export_free_job(&job->background);
+        return RedisModule_ReplyWithErrorFormat(ctx, "ERR unsupported export file version: %u.", header.version);
+    }
+
+    return background_start(ctx, &job->background);
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(export_RedisCommand, StatsExport)
+DEGRADING_COUNTER_TIMED_COMMAND(import_RedisCommand, StatsImport)
+
+// Called from `RedisModule_OnLoad` to create the commands.
+int export_register(RedisModuleCtx *ctx) {
+    // Both read or write whatever file they're given on the server, so they're admin commands like SAVE is. Neither
+    // takes key names, they cover the whole database.
+    if (RedisModule_CreateCommand(ctx, "dc.export",
+        export_RedisCommand_Timed, "readonly admin", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // The counters are replicated one by one as they're stored, never the command itself (the file is local).
+    if (RedisModule_CreateCommand(ctx, "dc.import",
+        import_RedisCommand_Timed, "write deny-oom admin", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,774 @@
+#include "redismodule.h"
+#include "module.h"
+#include <string.h>
+#include <math.h>
+
+// A hash counter keeps many named counters in a single key, which saves the per-key overhead Redis pays for every
+// top-level counter (often more than the counter itself). The decay is shared by every field in the key, so each field
+// only needs its value and the moment it was last anchored.
+//
+// Fields live in an open addressing table with linear probing. The table is laid out as a struct of arrays, one array
+// per column, all carved out of a single allocation, so reading the whole key is a straight pass over contiguous
+// `values` and `anchors`. Deletes shift the following entries back instead of leaving tombstones behind.
+
+#define HASH_COUNTER_TYPE_NAME "DeGrad-HS"
+#define HASH_COUNTER_ENCODING_VERSION 0
+
+#define HASH_COUNTER_INITIAL_CAPACITY 8 // Must be a power of two.
+
+static RedisModuleType *HashCounter;
+
+typedef struct HashCounterField {
+    uint32_t len;
+    char name[];
+} HashCounterField;
+
+typedef struct HashCounterData {
+    double rate; // Linear decay: subtracted every interval. Exponential decay: half-lives per millisecond.
+    mstime_t interval; // Linear decay: milliseconds per interval. Exponential decay: the half-life.
+    int decay; // CounterDecay
+    uint32_t capacity; // Number of slots, always a power of two.
+    uint32_t count; // Number of occupied slots.
+    size_t field_bytes; // Memory used by the field names, for `MEMORY USAGE`.
+    // One entry per slot. A slot is empty when its field is NULL.
+    uint32_t *hashes;
+    HashCounterField **fields;
+    double *values; // The raw, un-degraded value as of `anchors`.
+    mstime_t *anchors; // When the value was last reset (linear) or re-anchored (exponential).
+} HashCounterData;
+
+static inline size_t hash_counter_slot_size(void) {
+    return sizeof(uint32_t) + sizeof(HashCounterField *) + sizeof(double) + sizeof(mstime_t);
+}
+
+// FNV-1a, plenty for short field names.
+static uint32_t hash_counter_hash(const char *field, const size_t len) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)field[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Point the column arrays into one freshly zeroed block. The 8 byte columns go first so everything stays aligned.
+static void hash_counter_allocate_slots(HashCounterData *hash_counter, const uint32_t capacity) {
+    char *block = RedisModule_Calloc(capacity, hash_counter_slot_size());
+
+    hash_counter->capacity = capacity;
+    hash_counter->values = (double *)block;
+    hash_counter->anchors = (mstime_t *)(block + (size_t)capacity * sizeof(double));
+    hash_counter->fields = (HashCounterField **)(block + (size_t)capacity * (sizeof(double) + sizeof(mstime_t)));
+    hash_counter->hashes = (uint32_t *)(block + (size_t)capacity * (sizeof(double) + sizeof(mstime_t) + sizeof(HashCounterField *)));
+}
+
+HashCounterData *hash_counter_create(const int decay, const double rate, const mstime_t interval) {
+    HashCounterData *hash_counter = RedisModule_Calloc(1, sizeof(HashCounterData));
+
+    hash_counter->decay = decay;
+    hash_counter->rate = rate;
+    hash_counter->interval = interval;
+    hash_counter_allocate_slots(hash_counter, HASH_COUNTER_INITIAL_CAPACITY);
+
+    return hash_counter;
+}
+
+// The slot holding `field`, or the empty slot where it would go.
+static uint32_t hash_counter_find_slot(const HashCounterData *hash_counter, const char *field, const size_t len, const uint32_t hash) {
+    const uint32_t mask = hash_counter->capacity - 1;
+    uint32_t slot = hash & mask;
+
+    while (hash_counter->fields[slot] != NULL) {
+        const HashCounterField *existing = hash_counter->fields[slot];
+
+        if (hash_counter->hashes[slot] == hash && existing->len == len && memcmp(existing->name, field, len) == 0) {
+            break;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+// Grow the table once it's three quarters full, probe sequences get long quickly after that.
+static void hash_counter_grow_if_needed(HashCounterData *hash_counter) {
+    if ((hash_counter->count + 1) * 4 <= hash_counter->capacity * 3) {
+        return;
+    }
+
+    HashCounterData old = *hash_counter;
+    hash_counter_allocate_slots(hash_counter, old.capacity * 2);
+
+    for (uint32_t i = 0; i < old.capacity; i++) {
+        if (old.fields[i] == NULL) {
+            continue;
+        }
+
+        const uint32_t slot = hash_counter_find_slot(hash_counter, old.fields[i]->name, old.fields[i]->len, old.hashes[i]);
+
+        hash_counter->hashes[slot] = old.hashes[i];
+        hash_counter->fields[slot] = old.fields[i];
+        hash_counter->values[slot] = old.values[i];
+        hash_counter->anchors[slot] = old.anchors[i];
+    }
+
+    RedisModule_Free(old.values); // The start of the old block.
+}
+
+// Put a new field into the empty slot `slot`. Only valid right after `hash_counter_find_slot`, with no growth in between.
+static void hash_counter_insert_at(HashCounterData *hash_counter, const uint32_t slot, const char *field, const size_t len,
+                                   const uint32_t hash, const double value, const mstime_t anchor) {
+    HashCounterField *name = RedisModule_Alloc(sizeof(HashCounterField) + len);
+
+    name->len = (uint32_t)len;
+    memcpy(name->name, field, len);
+
+    hash_counter->hashes[slot] = hash;
+    hash_counter->fields[slot] = name;
+    hash_counter->values[slot] = value;
+    hash_counter->anchors[slot] = anchor;
+    hash_counter->count++;
+    hash_counter->field_bytes += sizeof(HashCounterField) + len;
+}
+
+// Remove the field in `slot`, shifting back whatever follows it in the probe sequence so lookups never hit a gap.
+static void hash_counter_delete_at(HashCounterData *hash_counter, uint32_t slot) {
+    const uint32_t mask = hash_counter->capacity - 1;
+
+    hash_counter->field_bytes -= sizeof(HashCounterField) + hash_counter->fields[slot]->len;
+    RedisModule_Free(hash_counter->fields[slot]);
+    hash_counter->count--;
+
+    uint32_t next = (slot + 1) & mask;
+
+    while (hash_counter->fields[next] != NULL) {
+        const uint32_t home = hash_counter->hashes[next] & mask;
+
+        // Can the entry at `next` move back into the hole? Only if the hole is between its home slot and where it is now.
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            hash_counter->hashes[slot] = hash_counter->hashes[next];
+            hash_counter->fields[slot] = hash_counter->fields[next];
+            hash_counter->values[slot] = hash_counter->values[next];
+            hash_counter->anchors[slot] = hash_counter->anchors[next];
+            slot = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+
+    hash_counter->fields[slot] = NULL;
+    hash_counter->values[slot] = 0;
+    hash_counter->anchors[slot] = 0;
+}
+
+// ------- Decay
+
+// The current value of the field in `slot`.
+static double hash_counter_evaluate(const HashCounterData *hash_counter, const uint32_t slot, const mstime_t now) {
+    const double elapsed = (double)(now - hash_counter->anchors[slot]);
+
+    if (hash_counter->decay == DecayExponential) {
+        return hash_counter->values[slot] * exp2(-elapsed * hash_counter->rate);
+    }
+
+    return fmax(0, hash_counter->values[slot] - hash_counter->rate * floor(elapsed / (double)hash_counter->interval));
+}
+
+// The current value of every slot, written to `out`. Empty slots come out as zero. The decay mode is checked once rather
+// than per slot, and each loop is a straight pass over the value and anchor columns.
+static void hash_counter_evaluate_all(const HashCounterData *hash_counter, const mstime_t now, double *out) {
+    const double *values = hash_counter->values;
+    const mstime_t *anchors = hash_counter->anchors;
+    const double rate = hash_counter->rate;
+    const uint32_t capacity = hash_counter->capacity;
+
+    if (hash_counter->decay == DecayExponential) {
+        for (uint32_t i = 0; i < capacity; i++) {
+            out[i] = values[i] * exp2(-(double)(now - anchors[i]) * rate);
+        }
+    } else {
+        const double interval = (double)hash_counter->interval;
+
+        for (uint32_t i = 0; i < capacity; i++) {
+            out[i] = fmax(0, values[i] - rate * floor((double)(now - anchors[i]) / interval));
+        }
+    }
+}
+
+// When will the field in `slot` reach zero? REDISMODULE_NO_EXPIRE if it's too far off to bother.
+static mstime_t hash_counter_zero_time(const HashCounterData *hash_counter, const uint32_t slot) {
+    const double value = hash_counter->values[slot];
+
+    if (hash_counter->rate <= 0) {
+        return REDISMODULE_NO_EXPIRE;
+    }
+
+    const double milliseconds_until_zero = hash_counter->decay == DecayExponential ?
+        ceil(log2(fmax(value, CLOSE_ENOUGH_TO_ZERO) / CLOSE_ENOUGH_TO_ZERO) / hash_counter->rate) :
+        fmax(0, ceil((value - CLOSE_ENOUGH_TO_ZERO) / hash_counter->rate)) * (double)hash_counter->interval;
+
+    if (milliseconds_until_zero > DEGRADING_COUNTER_MAX_EXPIRE_MS) {
+        return REDISMODULE_NO_EXPIRE;
+    }
+
+    return hash_counter->anchors[slot] + (mstime_t)milliseconds_until_zero;
+}
+
+// The key can go once its last field reaches zero. Fields only ever move their zero time out, so pushing the expire
+// back when a field outlives it is enough. `now` is the command's clock.
+static void hash_counter_extend_expire(RedisModuleKey *key, const HashCounterData *hash_counter, const uint32_t slot, const mstime_t now) {
+    const mstime_t zero_time = hash_counter_zero_time(hash_counter, slot);
+    const mstime_t ttl = RedisModule_GetExpire(key);
+
+    if (zero_time == REDISMODULE_NO_EXPIRE) {
+        if (ttl != REDISMODULE_NO_EXPIRE) {
+            RedisModule_SetExpire(key, REDISMODULE_NO_EXPIRE);
+        }
+    } else if (hash_counter->count == 1 || (ttl != REDISMODULE_NO_EXPIRE && zero_time > now + ttl)) {
+        RedisModule_SetAbsExpire(key, zero_time);
+    }
+}
+
+// Add `amount` to `field`, with the same semantics as DC.INCR. Returns the new value, fields that drop to zero are
+// removed.
+double hash_counter_increment(HashCounterData *hash_counter, const char *field, const size_t len, const double amount,
+                              const mstime_t now, uint32_t *slot_out) {
+    hash_counter_grow_if_needed(hash_counter);
+
+    const uint32_t hash = hash_counter_hash(field, len);
+    const uint32_t slot = hash_counter_find_slot(hash_counter, field, len, hash);
+
+    *slot_out = slot;
+
+    if (hash_counter->fields[slot] == NULL) {
+        if (amount <= CLOSE_ENOUGH_TO_ZERO) {
+            return 0;
+        }
+
+        hash_counter_insert_at(hash_counter, slot, field, len, hash, amount, now);
+        return amount;
+    }
+
+    const double current = hash_counter_evaluate(hash_counter, slot, now);
+
+    if (is_approximately_zero(current, CLOSE_ENOUGH_TO_ZERO) || hash_counter->decay == DecayExponential) {
+        // A finished counter starts over, and exponential decay re-anchors to now on every increment.
+        hash_counter->values[slot] = current + amount;
+        hash_counter->anchors[slot] = now;
+    } else {
+        hash_counter->values[slot] += amount;
+    }
+
+    const double value = hash_counter_evaluate(hash_counter, slot, now);
+
+    if (value <= CLOSE_ENOUGH_TO_ZERO) {
+        hash_counter_delete_at(hash_counter, slot);
+        return 0;
+    }
+
+    return value;
+}
+
+// Replicate a field as the value and anchor it was left with, the same DC.HRESTORE the AOF rewrite emits. A replica
+// replaying DC.HINCR would anchor the field to its own clock instead of ours.
+static void hash_counter_replicate_field(RedisModuleCtx *ctx, RedisModuleString *key_name, const HashCounterData *hash_counter,
+                                         const uint32_t slot) {
+    char rate[32], field_value[32];
+
+    // Doubles are written out with enough digits to come back bit for bit.
+    snprintf(rate, sizeof(rate), "%.17g", hash_counter->rate);
+    snprintf(field_value, sizeof(field_value), "%.17g", hash_counter->values[slot]);
+
+    RedisModule_Replicate(ctx, "DC.HRESTORE", "slclbcl",
+                          key_name,
+                          (long long)hash_counter->decay,
+                          rate,
+                          (long long)hash_counter->interval,
+                          hash_counter->fields[slot]->name, (size_t)hash_counter->fields[slot]->len,
+                          field_value,
+                          (long long)hash_counter->anchors[slot]);
+}
+
+// Open `key_name` and make sure it's either empty or a hash counter. Replies with WRONGTYPE and returns NULL otherwise.
+static RedisModuleKey *hash_counter_open_key(RedisModuleCtx *ctx, RedisModuleString *key_name) {
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+
+    if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != HashCounter) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        return NULL;
+    }
+
+    return key;
+}
+
+// ------- Commands
+
+// DC.HINCR key field AMOUNT <amount> (DEGRADE_RATE <rate> INTERVAL <interval> | DECAY EXP HALFLIFE <interval>)
+int hash_counter_increment_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.HINCR) hash_counter_increment_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    // Same pairs as DC.INCR, with the field name in front of them.
+    if (argc != 9 && argc != 11) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = hash_counter_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    // Shifting `argv` by one lines the pairs up where the DC.INCR parser expects them.
+    DegradingCounterData *counter = get_degrading_counter_data_from_redis_arguments(ctx, argv + 1, argc - 1);
+
+    if (counter == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    // Fields keep their time in milliseconds.
+    if (counter->increment == Microseconds) {
+        degrading_counter_free(counter);
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR hash counters don't support intervals in microseconds.");
+    }
+
+    HashCounterData *hash_counter;
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        hash_counter = hash_counter_create(counter->decay, counter->degrades_at, degrading_counter_interval_in_milliseconds(counter));
+        RedisModule_ModuleTypeSetValue(key, HashCounter, hash_counter);
+    } else {
+        // Every field shares the decay the key was created with.
+        hash_counter = RedisModule_ModuleTypeGetValue(key);
+    }
+
+    size_t len;
+    const char *field = RedisModule_StringPtrLen(argv[2], &len);
+    const mstime_t now = degrading_counter_now() / MICROSECONDS_PER_MILLISECOND;
+    uint32_t slot;
+    const double value = hash_counter_increment(hash_counter, field, len, counter->value, now, &slot);
+
+    degrading_counter_free(counter);
+
+    // Replicas get the field's new value and anchor rather than the increment.
+    if (hash_counter->count == 0) {
+        RedisModule_DeleteKey(key);
+        RedisModule_Replicate(ctx, "DEL", "s", argv[1]);
+    } else if (value > 0) {
+        hash_counter_extend_expire(key, hash_counter, slot, now);
+        hash_counter_replicate_field(ctx, argv[1], hash_counter, slot);
+    } else {
+        RedisModule_Replicate(ctx, "DC.HDEL", "ss", argv[1], argv[2]);
+    }
+
+    RedisModule_ReplyWithDouble(ctx, value);
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.HINCR) hash_counter_increment_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// DC.HPEEK key field
+int hash_counter_peek_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = hash_counter_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    HashCounterData *hash_counter = RedisModule_ModuleTypeGetValue(key);
+    size_t len;
+    const char *field = RedisModule_StringPtrLen(argv[2], &len);
+    const uint32_t slot = hash_counter_find_slot(hash_counter, field, len, hash_counter_hash(field, len));
+
+    if (hash_counter->fields[slot] == NULL) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    const double value = hash_counter_evaluate(hash_counter, slot, degrading_counter_now() / MICROSECONDS_PER_MILLISECOND);
+
+    // Whatever we drop has to be dropped on the replicas too, they'd otherwise hold on to it until the key expires.
+    if (is_approximately_zero(value, CLOSE_ENOUGH_TO_ZERO)) {
+        hash_counter_delete_at(hash_counter, slot);
+        stats_record_lazy_deletion();
+
+        if (hash_counter->count == 0) {
+            RedisModule_DeleteKey(key);
+            RedisModule_Replicate(ctx, "DEL", "s", argv[1]);
+        } else {
+            RedisModule_Replicate(ctx, "DC.HDEL", "ss", argv[1], argv[2]);
+        }
+    }
+
+    return RedisModule_ReplyWithDouble(ctx, value);
+}
+
+// DC.HGETALL key
+int hash_counter_get_all_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = hash_counter_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+    HashCounterData *hash_counter = RedisModule_ModuleTypeGetValue(key);
+    double *current = RedisModule_PoolAlloc(ctx, (size_t)hash_counter->capacity * sizeof(double));
+    const mstime_t now = degrading_counter_now() / MICROSECONDS_PER_MILLISECOND;
+
+    hash_counter_evaluate_all(hash_counter, now, current);
+
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    long replied = 0;
+
+    for (uint32_t i = 0; i < hash_counter->capacity; i++) {
+        if (hash_counter->fields[i] == NULL || is_approximately_zero(current[i], CLOSE_ENOUGH_TO_ZERO)) {
+            continue;
+        }
+
+        RedisModule_ReplyWithStringBuffer(ctx, hash_counter->fields[i]->name, hash_counter->fields[i]->len);
+        RedisModule_ReplyWithDouble(ctx, current[i]);
+        replied += 2;
+    }
+
+    RedisModule_ReplySetArrayLength(ctx, replied);
+
+    // Clear out whatever has reached zero now that the reply is done. Deleting shifts entries back into the slot we're
+    // looking at, so only move on once it holds something that's still counting.
+    RedisModuleString **deleted = NULL;
+    size_t deleted_count = 0, deleted_capacity = 0;
+
+    for (uint32_t i = 0; i < hash_counter->capacity;) {
+        if (hash_counter->fields[i] != NULL && is_approximately_zero(hash_counter_evaluate(hash_counter, i, now), CLOSE_ENOUGH_TO_ZERO)) {
+            if (deleted_count == deleted_capacity) {
+                deleted_capacity = deleted_capacity == 0 ? 8 : deleted_capacity * 2;
+                deleted = RedisModule_Realloc(deleted, deleted_capacity * sizeof(RedisModuleString *));
+            }
+
+            deleted[deleted_count++] = RedisModule_CreateString(ctx, hash_counter->fields[i]->name, hash_counter->fields[i]->len);
+            hash_counter_delete_at(hash_counter, i);
+            stats_record_lazy_deletion();
+        } else {
+            i++;
+        }
+    }
+
+    // The replicas drop the same fields, or the whole key once there's nothing left.
+    if (hash_counter->count == 0) {
+        RedisModule_DeleteKey(key);
+        RedisModule_Replicate(ctx, "DEL", "s", argv[1]);
+    } else if (deleted_count > 0) {
+        RedisModule_Replicate(ctx, "DC.HDEL", "sv", argv[1], deleted, deleted_count);
+    }
+
+    if (deleted != NULL) {
+        RedisModule_Free(deleted);
+    }
+
+    return REDISMODULE_OK;
+}
+
+// DC.HRESTORE key <decay> <rate> <interval> field <value> <anchor>
+//
+// Emitted by the AOF rewrite, and replicated in place of DC.HINCR. Recreates one field exactly as it was, creating the
+// key with the given decay if it doesn't exist yet.
+int hash_counter_restore_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 8) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long decay, interval, anchor;
+    double rate, value;
+
+    if (RedisModule_StringToLongLong(argv[2], &decay) != REDISMODULE_OK || (decay != DecayLinear && decay != DecayExponential) ||
+        RedisModule_StringToDouble(argv[3], &rate) != REDISMODULE_OK || !isfinite(rate) ||
+        RedisModule_StringToLongLong(argv[4], &interval) != REDISMODULE_OK || interval < 1 ||
+        RedisModule_StringToDouble(argv[6], &value) != REDISMODULE_OK || !isfinite(value) ||
+        RedisModule_StringToLongLong(argv[7], &anchor) != REDISMODULE_OK) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid hash counter payload.");
+    }
+
+    RedisModuleKey *key = hash_counter_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    HashCounterData *hash_counter;
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        hash_counter = hash_counter_create((int)decay, rate, interval);
+        RedisModule_ModuleTypeSetValue(key, HashCounter, hash_counter);
+    } else {
+        hash_counter = RedisModule_ModuleTypeGetValue(key);
+    }
+
+    hash_counter_grow_if_needed(hash_counter);
+
+    size_t len;
+    const char *field = RedisModule_StringPtrLen(argv[5], &len);
+    const uint32_t hash = hash_counter_hash(field, len);
+    const uint32_t slot = hash_counter_find_slot(hash_counter, field, len, hash);
+
+    if (hash_counter->fields[slot] == NULL) {
+        hash_counter_insert_at(hash_counter, slot, field, len, hash, value, anchor);
+    } else {
+        hash_counter->values[slot] = value;
+        hash_counter->anchors[slot] = anchor;
+    }
+
+    hash_counter_extend_expire(key, hash_counter, slot, degrading_counter_now() / MICROSECONDS_PER_MILLISECOND);
+
+    RedisModule_ReplicateVerbatim(ctx);
+
+    return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+// DC.HDEL key field [field ...]
+//
+// Replicated for fields the primary dropped, either because they decayed to zero or because an increment took them
+// there. Deletes the key once no field is left and replies with how many fields were removed.
+int hash_counter_delete_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = hash_counter_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithLongLong(ctx, 0);
+    }
+
+    HashCounterData *hash_counter = RedisModule_ModuleTypeGetValue(key);
+    long long removed = 0;
+
+    for (int i = 2; i < argc; i++) {
+        size_t len;
+        const char *field = RedisModule_StringPtrLen(argv[i], &len);
+        const uint32_t slot = hash_counter_find_slot(hash_counter, field, len, hash_counter_hash(field, len));
+
+        if (hash_counter->fields[slot] != NULL) {
+            hash_counter_delete_at(hash_counter, slot);
+            removed++;
+        }
+    }
+
+    // The expire belongs to a field that's still there or to one that reached zero, either way it can stay.
+    if (hash_counter->count == 0) {
+        RedisModule_DeleteKey(key);
+    }
+
+    RedisModule_ReplicateVerbatim(ctx);
+
+    return RedisModule_ReplyWithLongLong(ctx, removed);
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(hash_counter_increment_RedisCommand, StatsHashIncrement)
+DEGRADING_COUNTER_TIMED_COMMAND(hash_counter_peek_RedisCommand, StatsHashPeek)
+DEGRADING_COUNTER_TIMED_COMMAND(hash_counter_get_all_RedisCommand, StatsHashGetAll)
+
+// ------- Native Type Callbacks.
+
+void hash_counter_free(void *value) {
+    HashCounterData *hash_counter = value;
+
+    for (uint32_t i = 0; i < hash_counter->capacity; i++) {
+        if (hash_counter->fields[i] != NULL) {
+            RedisModule_Free(hash_counter->fields[i]);
+        }
+    }
+
+    RedisModule_Free(hash_counter->values);
+    RedisModule_Free(hash_counter);
+}
+
+void *hash_counter_rdb_load(RedisModuleIO *io, int encoding_version) {
+    if (encoding_version != HASH_COUNTER_ENCODING_VERSION) {
+        return NULL;
+    }
+
+    const int decay = (int)RedisModule_LoadUnsigned(io);
+    const double rate = RedisModule_LoadDouble(io);
+    const mstime_t interval = RedisModule_LoadSigned(io);
+    const uint64_t count = RedisModule_LoadUnsigned(io);
+
+    // A RESTORE payload gets no other check, so it's held to what DC.HRESTORE accepts.
+    if ((decay != DecayLinear && decay != DecayExponential) || !isfinite(rate) || interval < 1) {
+        return NULL;
+    }
+
+    HashCounterData *hash_counter = hash_counter_create(decay, rate, interval);
+
+    for (uint64_t i = 0; i < count; i++) {
+        size_t len;
+        char *field = RedisModule_LoadStringBuffer(io, &len);
+        const double value = RedisModule_LoadDouble(io);
+        const mstime_t anchor = RedisModule_LoadSigned(io);
+
+        if (field == NULL || !isfinite(value)) {
+            if (field != NULL) {
+                RedisModule_Free(field);
+            }
+
+            hash_counter_free(hash_counter);
+            return NULL;
+        }
+
+        hash_counter_grow_if_needed(hash_counter);
+
+        const uint32_t hash = hash_counter_hash(field, len);
+        const uint32_t slot = hash_counter_find_slot(hash_counter, field, len, hash);
+
+        // The same field twice would overwrite the first one's slot and lose track of its name.
+        if (hash_counter->fields[slot] != NULL) {
+            RedisModule_Free(field);
+            hash_counter_free(hash_counter);
+            return NULL;
+        }
+
+        hash_counter_insert_at(hash_counter, slot, field, len, hash, value, anchor);
+        RedisModule_Free(field);
+    }
+
+    return hash_counter;
+}
+
+void hash_counter_rdb_save(RedisModuleIO *io, void *value) {
+    const HashCounterData *hash_counter = value;
+
+    RedisModule_SaveUnsigned(io, hash_counter->decay);
+    RedisModule_SaveDouble(io, hash_counter->rate);
+    RedisModule_SaveSigned(io, hash_counter->interval);
+    RedisModule_SaveUnsigned(io, hash_counter->count);
+
+    for (uint32_t i = 0; i < hash_counter->capacity; i++) {
+        if (hash_counter->fields[i] == NULL) {
+            continue;
+        }
+
+        RedisModule_SaveStringBuffer(io, hash_counter->fields[i]->name, hash_counter->fields[i]->len);
+        RedisModule_SaveDouble(io, hash_counter->values[i]);
+        RedisModule_SaveSigned(io, hash_counter->anchors[i]);
+    }
+}
+
+void hash_counter_aof_rewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
+    const HashCounterData *hash_counter = value;
+    char rate[32];
+
+    // Doubles are written out with enough digits to come back bit for bit.
+    snprintf(rate, sizeof(rate), "%.17g", hash_counter->rate);
+
+    for (uint32_t i = 0; i < hash_counter->capacity; i++) {
+        if (hash_counter->fields[i] == NULL) {
+            continue;
+        }
+
+        char field_value[32];
+        snprintf(field_value, sizeof(field_value), "%.17g", hash_counter->values[i]);
+
+        RedisModule_EmitAOF(aof, "DC.HRESTORE", "slclbcl",
+                            key,
+                            (long long)hash_counter->decay,
+                            rate,
+                            (long long)hash_counter->interval,
+                            hash_counter->fields[i]->name, (size_t)hash_counter->fields[i]->len,
+                            field_value,
+                            (long long)hash_counter->anchors[i]);
+    }
+}
+
+size_t hash_counter_mem_usage(const void *value) {
+    const HashCounterData *hash_counter = value;
+
+    return sizeof(HashCounterData) + (size_t)hash_counter->capacity * hash_counter_slot_size() + hash_counter->field_bytes;
+}
+
+size_t hash_counter_free_effort(RedisModuleString *key, const void *value) {
+    const HashCounterData *hash_counter = value;
+
+    // One allocation per field name, on top of the table itself.
+    return hash_counter->count + 1;
+}
+
+// Called from `RedisModule_OnLoad` to create the type and its commands.
+int hash_counter_register(RedisModuleCtx *ctx) {
+    RedisModuleTypeMethods tm = {
+        .version = REDISMODULE_TYPE_METHOD_VERSION,
+        .rdb_load = hash_counter_rdb_load,
+        .rdb_save = hash_counter_rdb_save,
+        .aof_rewrite = hash_counter_aof_rewrite,
+        .mem_usage = hash_counter_mem_usage,
+        .free = hash_counter_free,
+        .free_effort = hash_counter_free_effort
+    };
+
+    HashCounter = RedisModule_CreateDataType(ctx,
+        HASH_COUNTER_TYPE_NAME,
+        HASH_COUNTER_ENCODING_VERSION,
+        &tm);
+
+    if (HashCounter == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.hincr",
+        hash_counter_increment_RedisCommand_Timed, "fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // Reads drop fields that have decayed to zero (and replicate that), so these write too.
+    if (RedisModule_CreateCommand(ctx, "dc.hpeek",
+        hash_counter_peek_RedisCommand_Timed, "fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.hgetall",
+        hash_counter_get_all_RedisCommand_Timed, "write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.hrestore",
+        hash_counter_restore_RedisCommand, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.hdel",
+        hash_counter_delete_RedisCommand, "write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
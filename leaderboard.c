@@ -0,0 +1,942 @@
+#include "redismodule.h"
+#include "module.h"
+#include <string.h>
+#include <math.h>
+
+// A leaderboard holds many decaying members in one key, ranked by their current value. Members are kept in a skiplist
+// with spans (the same structure Redis uses for sorted sets), so increments, ranks, top-N and score ranges are all
+// O(log n), and a dictionary maps member names to their skiplist node.
+//
+// Every member of a leaderboard shares the key's decay, which is what keeps the ranking stable as time passes. Instead
+// of the member's value we store a score that's normalized to the key's epoch, and decay is applied to everyone at once
+// through the key's clock:
+//
+//   linear:       value = score - rate * whole intervals since the epoch
+//   exponential:  value = 2^(score - half-lives since the epoch)
+//
+// Either way the value is a strictly increasing function of the score, so the order never changes without an increment
+// and nothing ever needs to be re-sorted. It also means members that have decayed to zero are always at the bottom.
+
+#define LEADERBOARD_TYPE_NAME "DeGrad-LB"
+#define LEADERBOARD_ENCODING_VERSION 0
+
+#define LEADERBOARD_MAX_LEVEL 32
+#define LEADERBOARD_LEVEL_PROBABILITY_BITS 2 // Each level is 1/4 as likely as the one below it.
+
+static RedisModuleType *Leaderboard;
+
+typedef struct LeaderboardLevel {
+    struct LeaderboardNode *forward;
+    unsigned long span; // How many nodes `forward` skips over, that's what makes ranks O(log n).
+} LeaderboardLevel;
+
+typedef struct LeaderboardNode {
+    double score; // Normalized to the leaderboard's epoch, see above.
+    struct LeaderboardNode *backward;
+    char *member; // Points just past the levels, the member shares the node's allocation.
+    size_t member_len;
+    LeaderboardLevel level[];
+} LeaderboardNode;
+
+typedef struct LeaderboardData {
+    mstime_t epoch; // When the leaderboard was created, its clock starts here.
+    double rate; // Linear decay: subtracted every interval. Exponential decay: half-lives per millisecond.
+    mstime_t interval; // Linear decay: milliseconds per interval. Exponential decay: the half-life.
+    int decay; // CounterDecay
+    int level;
+    unsigned long length;
+    size_t node_bytes; // What `MEMORY USAGE` reports, on top of the key itself.
+    LeaderboardNode *header;
+    LeaderboardNode *tail; // The highest ranked member.
+    RedisModuleDict *members; // Member name -> LeaderboardNode.
+} LeaderboardData;
+
+// Skiplist levels only need to be unpredictable enough to stay balanced, a xorshift generator is plenty.
+static uint64_t LeaderboardRandomState = 0x9E3779B97F4A7C15ULL;
+
+static int leaderboard_random_level(void) {
+    int level = 1;
+
+    LeaderboardRandomState ^= LeaderboardRandomState << 13;
+    LeaderboardRandomState ^= LeaderboardRandomState >> 7;
+    LeaderboardRandomState ^= LeaderboardRandomState << 17;
+
+    uint64_t bits = LeaderboardRandomState;
+
+    while (level < LEADERBOARD_MAX_LEVEL && (bits & ((1 << LEADERBOARD_LEVEL_PROBABILITY_BITS) - 1)) == 0) {
+        level++;
+        bits >>= LEADERBOARD_LEVEL_PROBABILITY_BITS;
+    }
+
+    return level;
+}
+
+static size_t leaderboard_node_size(const int level, const size_t member_len) {
+    return sizeof(LeaderboardNode) + (size_t)level * sizeof(LeaderboardLevel) + member_len;
+}
+
+static LeaderboardNode *leaderboard_node_create(const int level, const double score, const char *member, const size_t member_len) {
+    LeaderboardNode *node = RedisModule_Calloc(1, leaderboard_node_size(level, member_len));
+
+    node->score = score;
+    node->member = (char *)&node->level[level];
+    node->member_len = member_len;
+
+    if (member_len > 0) {
+        memcpy(node->member, member, member_len);
+    }
+
+    return node;
+}
+
+// Order by score, then by member name so that ties are stable.
+static int leaderboard_node_less_than(const LeaderboardNode *node, const double score, const char *member, const size_t member_len) {
+    if (node->score != score) {
+        return node->score < score;
+    }
+
+    const size_t shortest = node->member_len < member_len ? node->member_len : member_len;
+    const int compared = memcmp(node->member, member, shortest);
+
+    return compared < 0 || (compared == 0 && node->member_len < member_len);
+}
+
+LeaderboardData *leaderboard_create(const mstime_t epoch, const int decay, const double rate, const mstime_t interval) {
+    LeaderboardData *leaderboard = RedisModule_Calloc(1, sizeof(LeaderboardData));
+
+    leaderboard->epoch = epoch;
+    leaderboard->decay = decay;
+    leaderboard->rate = rate;
+    leaderboard->interval = interval;
+    leaderboard->level = 1;
+    leaderboard->header = leaderboard_node_create(LEADERBOARD_MAX_LEVEL, 0, NULL, 0);
+    leaderboard->members = RedisModule_CreateDict(NULL);
+
+    return leaderboard;
+}
+
+static LeaderboardNode *leaderboard_insert(LeaderboardData *leaderboard, const double score, const char *member, const size_t member_len) {
+    LeaderboardNode *update[LEADERBOARD_MAX_LEVEL];
+    unsigned long rank[LEADERBOARD_MAX_LEVEL];
+    LeaderboardNode *x = leaderboard->header;
+
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        rank[i] = i == leaderboard->level - 1 ? 0 : rank[i + 1];
+
+        while (x->level[i].forward && leaderboard_node_less_than(x->level[i].forward, score, member, member_len)) {
+            rank[i] += x->level[i].span;
+            x = x->level[i].forward;
+        }
+
+        update[i] = x;
+    }
+
+    const int level = leaderboard_random_level();
+
+    if (level > leaderboard->level) {
+        for (int i = leaderboard->level; i < level; i++) {
+            rank[i] = 0;
+            update[i] = leaderboard->header;
+            update[i]->level[i].span = leaderboard->length;
+        }
+
+        leaderboard->level = level;
+    }
+
+    x = leaderboard_node_create(level, score, member, member_len);
+
+    for (int i = 0; i < level; i++) {
+        x->level[i].forward = update[i]->level[i].forward;
+        update[i]->level[i].forward = x;
+
+        x->level[i].span = update[i]->level[i].span - (rank[0] - rank[i]);
+        update[i]->level[i].span = (rank[0] - rank[i]) + 1;
+    }
+
+    for (int i = level; i < leaderboard->level; i++) {
+        update[i]->level[i].span++;
+    }
+
+    x->backward = update[0] == leaderboard->header ? NULL : update[0];
+
+    if (x->level[0].forward) {
+        x->level[0].forward->backward = x;
+    } else {
+        leaderboard->tail = x;
+    }
+
+    leaderboard->length++;
+    leaderboard->node_bytes += leaderboard_node_size(level, member_len);
+    RedisModule_DictSetC(leaderboard->members, x->member, x->member_len, x);
+
+    return x;
+}
+
+// Unlink and free `node`, which must be in the leaderboard.
+static void leaderboard_delete(LeaderboardData *leaderboard, LeaderboardNode *node) {
+    LeaderboardNode *update[LEADERBOARD_MAX_LEVEL];
+    LeaderboardNode *x = leaderboard->header;
+
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        while (x->level[i].forward && x->level[i].forward != node &&
+               leaderboard_node_less_than(x->level[i].forward, node->score, node->member, node->member_len)) {
+            x = x->level[i].forward;
+        }
+
+        update[i] = x;
+    }
+
+    int level = 0;
+
+    for (int i = 0; i < leaderboard->level; i++) {
+        if (update[i]->level[i].forward == node) {
+            update[i]->level[i].span += node->level[i].span - 1;
+            update[i]->level[i].forward = node->level[i].forward;
+            level = i + 1;
+        } else {
+            update[i]->level[i].span--;
+        }
+    }
+
+    if (node->level[0].forward) {
+        node->level[0].forward->backward = node->backward;
+    } else {
+        leaderboard->tail = node->backward;
+    }
+
+    while (leaderboard->level > 1 && leaderboard->header->level[leaderboard->level - 1].forward == NULL) {
+        leaderboard->level--;
+    }
+
+    leaderboard->length--;
+    leaderboard->node_bytes -= leaderboard_node_size(level, node->member_len);
+    RedisModule_DictDelC(leaderboard->members, node->member, node->member_len, NULL);
+    RedisModule_Free(node);
+}
+
+// 1 based position of `node` counting up from the lowest score.
+static unsigned long leaderboard_ascending_rank(const LeaderboardData *leaderboard, const LeaderboardNode *node) {
+    unsigned long rank = 0;
+    const LeaderboardNode *x = leaderboard->header;
+
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        while (x->level[i].forward &&
+               (x->level[i].forward == node ||
+                leaderboard_node_less_than(x->level[i].forward, node->score, node->member, node->member_len))) {
+            rank += x->level[i].span;
+            x = x->level[i].forward;
+
+            if (x == node) {
+                return rank;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// The node at 1 based position `rank` counting up from the lowest score.
+static LeaderboardNode *leaderboard_node_by_ascending_rank(const LeaderboardData *leaderboard, const unsigned long rank) {
+    unsigned long traversed = 0;
+    LeaderboardNode *x = leaderboard->header;
+
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        while (x->level[i].forward && traversed + x->level[i].span <= rank) {
+            traversed += x->level[i].span;
+            x = x->level[i].forward;
+        }
+
+        if (traversed == rank) {
+            return x;
+        }
+    }
+
+    return NULL;
+}
+
+// The highest scoring node with a score of at most `score`.
+static LeaderboardNode *leaderboard_last_at_most(const LeaderboardData *leaderboard, const double score) {
+    LeaderboardNode *x = leaderboard->header;
+
+    for (int i = leaderboard->level - 1; i >= 0; i--) {
+        while (x->level[i].forward && x->level[i].forward->score <= score) {
+            x = x->level[i].forward;
+        }
+    }
+
+    return x == leaderboard->header ? NULL : x;
+}
+
+// ------- Decay
+
+// How far the leaderboard has decayed at `now`, in the same units as the scores.
+double leaderboard_clock(const LeaderboardData *leaderboard, const mstime_t now) {
+    const mstime_t elapsed = now > leaderboard->epoch ? now - leaderboard->epoch : 0;
+
+    if (leaderboard->decay == DecayExponential) {
+        return (double)elapsed * leaderboard->rate;
+    }
+
+    return leaderboard->rate * (double)(elapsed / leaderboard->interval);
+}
+
+double leaderboard_value_from_score(const LeaderboardData *leaderboard, const double score, const double clock) {
+    return leaderboard->decay == DecayExponential ? exp2(score - clock) : score - clock;
+}
+
+double leaderboard_score_from_value(const LeaderboardData *leaderboard, const double value, const double clock) {
+    if (leaderboard->decay == DecayExponential) {
+        return value > 0 ? log2(value) + clock : -INFINITY;
+    }
+
+    return value + clock;
+}
+
+// Members that have decayed to zero sit at the bottom of the skiplist, so clearing them out only looks at the front.
+// Whoever went is replicated as a DC.ZREM, a replica going by its own clock wouldn't agree on who that is.
+void leaderboard_prune(RedisModuleCtx *ctx, RedisModuleString *key_name, LeaderboardData *leaderboard, const double clock) {
+    const double zero_score = leaderboard_score_from_value(leaderboard, CLOSE_ENOUGH_TO_ZERO, clock);
+    RedisModuleString **pruned = NULL;
+    size_t pruned_count = 0, pruned_capacity = 0;
+    LeaderboardNode *lowest;
+
+    while ((lowest = leaderboard->header->level[0].forward) != NULL && lowest->score <= zero_score) {
+        if (pruned_count == pruned_capacity) {
+            pruned_capacity = pruned_capacity == 0 ? 8 : pruned_capacity * 2;
+            pruned = RedisModule_Realloc(pruned, pruned_capacity * sizeof(RedisModuleString *));
+        }
+
+        pruned[pruned_count++] = RedisModule_CreateString(ctx, lowest->member, lowest->member_len);
+        leaderboard_delete(leaderboard, lowest);
+        stats_record_lazy_deletion();
+    }
+
+    if (pruned_count > 0) {
+        RedisModule_Replicate(ctx, "DC.ZREM", "sv", key_name, pruned, pruned_count);
+        RedisModule_Free(pruned);
+    }
+}
+
+// Replicate a member as the normalized score it was left with, the same DC.ZRESTORE the AOF rewrite emits. That keeps
+// the replica's copy in step with ours no matter when it gets there.
+static void leaderboard_replicate_member(RedisModuleCtx *ctx, RedisModuleString *key_name, const LeaderboardData *leaderboard,
+                                         const LeaderboardNode *node) {
+    char rate[32], score[32];
+
+    // Doubles are written out with enough digits to come back bit for bit.
+    snprintf(rate, sizeof(rate), "%.17g", leaderboard->rate);
+    snprintf(score, sizeof(score), "%.17g", node->score);
+
+    RedisModule_Replicate(ctx, "DC.ZRESTORE", "sllblbc",
+                          key_name,
+                          (long long)leaderboard->epoch,
+                          (long long)leaderboard->decay,
+                          rate, strlen(rate),
+                          (long long)leaderboard->interval,
+                          node->member, node->member_len,
+                          score);
+}
+
+// The whole key can go once the highest ranked member reaches zero.
+void leaderboard_update_expire(RedisModuleKey *key, const LeaderboardData *leaderboard) {
+    double milliseconds_until_zero = INFINITY;
+
+    if (leaderboard->tail && leaderboard->rate > 0) {
+        if (leaderboard->decay == DecayExponential) {
+            milliseconds_until_zero = ceil((leaderboard->tail->score - log2(CLOSE_ENOUGH_TO_ZERO)) / leaderboard->rate);
+        } else {
+            milliseconds_until_zero = ceil((leaderboard->tail->score - CLOSE_ENOUGH_TO_ZERO) / leaderboard->rate) * (double)leaderboard->interval;
+        }
+    }
+
+    if (milliseconds_until_zero > DEGRADING_COUNTER_MAX_EXPIRE_MS) {
+        if (RedisModule_GetExpire(key) != REDISMODULE_NO_EXPIRE) {
+            RedisModule_SetExpire(key, REDISMODULE_NO_EXPIRE);
+        }
+    } else {
+        RedisModule_SetAbsExpire(key, leaderboard->epoch + (mstime_t)fmax(0, milliseconds_until_zero));
+    }
+}
+
+// Add `amount` to `member`'s current value, creating it if needed. Returns the new value, members that drop to zero are
+// removed.
+double leaderboard_increment(LeaderboardData *leaderboard, const char *member, const size_t member_len, const double amount,
+                             const double clock) {
+    int missing;
+    LeaderboardNode *node = RedisModule_DictGetC(leaderboard->members, (void *)member, member_len, &missing);
+    double value = amount;
+
+    if (!missing) {
+        value += leaderboard_value_from_score(leaderboard, node->score, clock);
+        leaderboard_delete(leaderboard, node);
+    }
+
+    if (value <= CLOSE_ENOUGH_TO_ZERO) {
+        return 0;
+    }
+
+    leaderboard_insert(leaderboard, leaderboard_score_from_value(leaderboard, value, clock), member, member_len);
+
+    return value;
+}
+
+// Open `key_name` and make sure it's either empty or a leaderboard. Replies with WRONGTYPE and returns NULL otherwise.
+static RedisModuleKey *leaderboard_open_key(RedisModuleCtx *ctx, RedisModuleString *key_name) {
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+
+    if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != Leaderboard) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        return NULL;
+    }
+
+    return key;
+}
+
+// Gets the leaderboard stored at `key` ready to be read: drops whatever has decayed to zero and deletes the key if that
+// was everyone, replicating both. Returns NULL if there's nothing left.
+static LeaderboardData *leaderboard_prepare(RedisModuleCtx *ctx, RedisModuleString *key_name, RedisModuleKey *key, double *clock) {
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        return NULL;
+    }
+
+    LeaderboardData *leaderboard = RedisModule_ModuleTypeGetValue(key);
+    *clock = leaderboard_clock(leaderboard, degrading_counter_now() / MICROSECONDS_PER_MILLISECOND);
+    leaderboard_prune(ctx, key_name, leaderboard, *clock);
+
+    if (leaderboard->length == 0) {
+        RedisModule_DeleteKey(key);
+        RedisModule_Replicate(ctx, "DEL", "s", key_name);
+        return NULL;
+    }
+
+    return leaderboard;
+}
+
+static void leaderboard_reply_with_node(RedisModuleCtx *ctx, const LeaderboardData *leaderboard, const LeaderboardNode *node,
+                                        const double clock, const int with_scores) {
+    RedisModule_ReplyWithStringBuffer(ctx, node->member, node->member_len);
+
+    if (with_scores) {
+        RedisModule_ReplyWithDouble(ctx, leaderboard_value_from_score(leaderboard, node->score, clock));
+    }
+}
+
+// ------- Commands
+
+// DC.ZINCR key member AMOUNT <amount> (DEGRADE_RATE <rate> INTERVAL <interval> | DECAY EXP HALFLIFE <interval>)
+int leaderboard_increment_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.ZINCR) leaderboard_increment_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    // Same pairs as DC.INCR, with the member name in front of them.
+    if (argc != 9 && argc != 11) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = leaderboard_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    // Shifting `argv` by one lines the pairs up where the DC.INCR parser expects them.
+    DegradingCounterData *counter = get_degrading_counter_data_from_redis_arguments(ctx, argv + 1, argc - 1);
+
+    if (counter == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    // The leaderboard clock ticks in milliseconds.
+    if (counter->increment == Microseconds) {
+        degrading_counter_free(counter);
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR leaderboards don't support intervals in microseconds.");
+    }
+
+    const mstime_t now = degrading_counter_now() / MICROSECONDS_PER_MILLISECOND;
+    LeaderboardData *leaderboard;
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        leaderboard = leaderboard_create(now, counter->decay, counter->degrades_at, degrading_counter_interval_in_milliseconds(counter));
+        RedisModule_ModuleTypeSetValue(key, Leaderboard, leaderboard);
+    } else {
+        // Every member shares the decay the leaderboard was created with.
+        leaderboard = RedisModule_ModuleTypeGetValue(key);
+    }
+
+    const double clock = leaderboard_clock(leaderboard, now);
+    leaderboard_prune(ctx, argv[1], leaderboard, clock);
+
+    size_t member_len;
+    const char *member = RedisModule_StringPtrLen(argv[2], &member_len);
+    const double value = leaderboard_increment(leaderboard, member, member_len, counter->value, clock);
+
+    degrading_counter_free(counter);
+
+    // Replicas get the member's new score rather than the increment, which they'd apply against their own clock.
+    if (leaderboard->length == 0) {
+        RedisModule_DeleteKey(key);
+        RedisModule_Replicate(ctx, "DEL", "s", argv[1]);
+    } else {
+        int missing;
+        const LeaderboardNode *node = RedisModule_DictGetC(leaderboard->members, (void *)member, member_len, &missing);
+
+        if (missing) {
+            RedisModule_Replicate(ctx, "DC.ZREM", "ss", argv[1], argv[2]);
+        } else {
+            leaderboard_replicate_member(ctx, argv[1], leaderboard, node);
+        }
+
+        leaderboard_update_expire(key, leaderboard);
+    }
+
+    RedisModule_ReplyWithDouble(ctx, value);
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.ZINCR) leaderboard_increment_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// DC.ZSCORE key member
+int leaderboard_score_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = leaderboard_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    double clock;
+    LeaderboardData *leaderboard = leaderboard_prepare(ctx, argv[1], key, &clock);
+
+    if (leaderboard == NULL) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    size_t member_len;
+    const char *member = RedisModule_StringPtrLen(argv[2], &member_len);
+    int missing;
+    const LeaderboardNode *node = RedisModule_DictGetC(leaderboard->members, (void *)member, member_len, &missing);
+
+    if (missing) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    return RedisModule_ReplyWithDouble(ctx, leaderboard_value_from_score(leaderboard, node->score, clock));
+}
+
+// DC.ZRANK key member
+int leaderboard_rank_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = leaderboard_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    double clock;
+    LeaderboardData *leaderboard = leaderboard_prepare(ctx, argv[1], key, &clock);
+
+    if (leaderboard == NULL) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    size_t member_len;
+    const char *member = RedisModule_StringPtrLen(argv[2], &member_len);
+    int missing;
+    const LeaderboardNode *node = RedisModule_DictGetC(leaderboard->members, (void *)member, member_len, &missing);
+
+    if (missing) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    // Ranks count down from the top, the highest value is rank 0.
+    return RedisModule_ReplyWithLongLong(ctx, (long long)(leaderboard->length - leaderboard_ascending_rank(leaderboard, node)));
+}
+
+// DC.ZRANGE key start stop [BYSCORE] [WITHSCORES]
+//
+// Always highest value first. By default `start` and `stop` are ranks (negative ones count up from the bottom), with
+// BYSCORE they're the lowest and highest value to include.
+int leaderboard_range_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 4 || argc > 6) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    int by_score = 0;
+    int with_scores = 0;
+
+    for (int i = 4; i < argc; i++) {
+        const char *option = RedisModule_StringPtrLen(argv[i], NULL);
+
+        if (strcmp(option, "BYSCORE") == 0) {
+            by_score = 1;
+        } else if (strcmp(option, "WITHSCORES") == 0) {
+            with_scores = 1;
+        } else {
+            stats_record_parse_error();
+            return RedisModule_ReplyWithErrorFormat(ctx, "ERR unexpected argument: %s. (Remember argument names are case sensitive.)", option);
+        }
+    }
+
+    double min_value = 0, max_value = 0;
+    long long start = 0, stop = 0;
+
+    if (by_score) {
+        if (RedisModule_StringToDouble(argv[2], &min_value) != REDISMODULE_OK ||
+            RedisModule_StringToDouble(argv[3], &max_value) != REDISMODULE_OK) {
+            stats_record_parse_error();
+            return RedisModule_ReplyWithError(ctx, "ERR min and max must be numbers.");
+        }
+    } else if (RedisModule_StringToLongLong(argv[2], &start) != REDISMODULE_OK ||
+               RedisModule_StringToLongLong(argv[3], &stop) != REDISMODULE_OK) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR start and stop must be integers.");
+    }
+
+    RedisModuleKey *key = leaderboard_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    double clock;
+    const LeaderboardData *leaderboard = leaderboard_prepare(ctx, argv[1], key, &clock);
+
+    if (leaderboard == NULL) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+    const LeaderboardNode *node;
+    long count = 0;
+
+    if (by_score) {
+        const double min_score = leaderboard_score_from_value(leaderboard, min_value, clock);
+
+        node = leaderboard_last_at_most(leaderboard, leaderboard_score_from_value(leaderboard, max_value, clock));
+        RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+
+        for (; node && node->score >= min_score; node = node->backward, count++) {
+            leaderboard_reply_with_node(ctx, leaderboard, node, clock, with_scores);
+        }
+
+        RedisModule_ReplySetArrayLength(ctx, with_scores ? count * 2 : count);
+
+        return REDISMODULE_OK;
+    }
+
+    const long long length = (long long)leaderboard->length;
+
+    if (start < 0) {
+        start += length;
+    }
+
+    if (stop < 0) {
+        stop += length;
+    }
+
+    if (start < 0) {
+        start = 0;
+    }
+
+    if (stop >= length) {
+        stop = length - 1;
+    }
+
+    if (start > stop || start >= length) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+    }
+
+    count = (long)(stop - start + 1);
+    RedisModule_ReplyWithArray(ctx, with_scores ? count * 2 : count);
+
+    // Rank 0 is the last node of the skiplist, so we find where to start and then walk backwards.
+    node = leaderboard_node_by_ascending_rank(leaderboard, (unsigned long)(length - start));
+
+    for (long i = 0; i < count; i++, node = node->backward) {
+        leaderboard_reply_with_node(ctx, leaderboard, node, clock, with_scores);
+    }
+
+    return REDISMODULE_OK;
+}
+
+// DC.ZRESTORE key <epoch> <decay> <rate> <interval> member <score>
+//
+// Emitted by the AOF rewrite, and replicated in place of DC.ZINCR. Recreates one member with its normalized score,
+// creating the leaderboard with the given decay if it doesn't exist yet.
+int leaderboard_restore_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 8) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long epoch, decay, interval;
+    double rate, score;
+
+    if (RedisModule_StringToLongLong(argv[2], &epoch) != REDISMODULE_OK ||
+        RedisModule_StringToLongLong(argv[3], &decay) != REDISMODULE_OK || (decay != DecayLinear && decay != DecayExponential) ||
+        RedisModule_StringToDouble(argv[4], &rate) != REDISMODULE_OK || !isfinite(rate) ||
+        RedisModule_StringToLongLong(argv[5], &interval) != REDISMODULE_OK || interval < 1 ||
+        RedisModule_StringToDouble(argv[7], &score) != REDISMODULE_OK || !isfinite(score)) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid leaderboard payload.");
+    }
+
+    RedisModuleKey *key = leaderboard_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    LeaderboardData *leaderboard;
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        leaderboard = leaderboard_create(epoch, (int)decay, rate, interval);
+        RedisModule_ModuleTypeSetValue(key, Leaderboard, leaderboard);
+    } else {
+        leaderboard = RedisModule_ModuleTypeGetValue(key);
+    }
+
+    size_t member_len;
+    const char *member = RedisModule_StringPtrLen(argv[6], &member_len);
+    int missing;
+    LeaderboardNode *node = RedisModule_DictGetC(leaderboard->members, (void *)member, member_len, &missing);
+
+    if (!missing) {
+        leaderboard_delete(leaderboard, node);
+    }
+
+    leaderboard_insert(leaderboard, score, member, member_len);
+    leaderboard_update_expire(key, leaderboard);
+
+    RedisModule_ReplicateVerbatim(ctx);
+
+    return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+// DC.ZREM key member [member ...]
+//
+// Replicated for members the primary dropped, either because they decayed to zero or because an increment took them
+// there. Deletes the key once no one is left and replies with how many members were removed.
+int leaderboard_remove_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = leaderboard_open_key(ctx, argv[1]);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithLongLong(ctx, 0);
+    }
+
+    LeaderboardData *leaderboard = RedisModule_ModuleTypeGetValue(key);
+    long long removed = 0;
+
+    for (int i = 2; i < argc; i++) {
+        size_t member_len;
+        const char *member = RedisModule_StringPtrLen(argv[i], &member_len);
+        int missing;
+        LeaderboardNode *node = RedisModule_DictGetC(leaderboard->members, (void *)member, member_len, &missing);
+
+        if (!missing) {
+            leaderboard_delete(leaderboard, node);
+            removed++;
+        }
+    }
+
+    if (leaderboard->length == 0) {
+        RedisModule_DeleteKey(key);
+    } else if (removed > 0) {
+        leaderboard_update_expire(key, leaderboard);
+    }
+
+    RedisModule_ReplicateVerbatim(ctx);
+
+    return RedisModule_ReplyWithLongLong(ctx, removed);
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(leaderboard_increment_RedisCommand, StatsLeaderboardIncrement)
+DEGRADING_COUNTER_TIMED_COMMAND(leaderboard_score_RedisCommand, StatsLeaderboardScore)
+DEGRADING_COUNTER_TIMED_COMMAND(leaderboard_rank_RedisCommand, StatsLeaderboardRank)
+DEGRADING_COUNTER_TIMED_COMMAND(leaderboard_range_RedisCommand, StatsLeaderboardRange)
+
+// ------- Native Type Callbacks.
+
+void leaderboard_free(void *value) {
+    LeaderboardData *leaderboard = value;
+    LeaderboardNode *node = leaderboard->header->level[0].forward;
+
+    while (node) {
+        LeaderboardNode *next = node->level[0].forward;
+        RedisModule_Free(node);
+        node = next;
+    }
+
+    RedisModule_Free(leaderboard->header);
+    RedisModule_FreeDict(NULL, leaderboard->members);
+    RedisModule_Free(leaderboard);
+}
+
+void *leaderboard_rdb_load(RedisModuleIO *io, int encoding_version) {
+    if (encoding_version != LEADERBOARD_ENCODING_VERSION) {
+        return NULL;
+    }
+
+    const mstime_t epoch = RedisModule_LoadSigned(io);
+    const int decay = (int)RedisModule_LoadUnsigned(io);
+    const double rate = RedisModule_LoadDouble(io);
+    const mstime_t interval = RedisModule_LoadSigned(io);
+    const uint64_t length = RedisModule_LoadUnsigned(io);
+
+    // A RESTORE payload gets no other check, and the reads divide by the interval.
+    if ((decay != DecayLinear && decay != DecayExponential) || !isfinite(rate) || interval < 1) {
+        return NULL;
+    }
+
+    LeaderboardData *leaderboard = leaderboard_create(epoch, decay, rate, interval);
+
+    for (uint64_t i = 0; i < length; i++) {
+        size_t member_len;
+        char *member = RedisModule_LoadStringBuffer(io, &member_len);
+        const double score = RedisModule_LoadDouble(io);
+
+        if (member == NULL || !isfinite(score)) {
+            if (member != NULL) {
+                RedisModule_Free(member);
+            }
+
+            leaderboard_free(leaderboard);
+            return NULL;
+        }
+
+        leaderboard_insert(leaderboard, score, member, member_len);
+        RedisModule_Free(member);
+    }
+
+    return leaderboard;
+}
+
+void leaderboard_rdb_save(RedisModuleIO *io, void *value) {
+    const LeaderboardData *leaderboard = value;
+
+    RedisModule_SaveSigned(io, leaderboard->epoch);
+    RedisModule_SaveUnsigned(io, leaderboard->decay);
+    RedisModule_SaveDouble(io, leaderboard->rate);
+    RedisModule_SaveSigned(io, leaderboard->interval);
+    RedisModule_SaveUnsigned(io, leaderboard->length);
+
+    for (const LeaderboardNode *node = leaderboard->header->level[0].forward; node; node = node->level[0].forward) {
+        RedisModule_SaveStringBuffer(io, node->member, node->member_len);
+        RedisModule_SaveDouble(io, node->score);
+    }
+}
+
+void leaderboard_aof_rewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
+    const LeaderboardData *leaderboard = value;
+    char rate[32];
+
+    // Doubles are written out with enough digits to come back bit for bit.
+    snprintf(rate, sizeof(rate), "%.17g", leaderboard->rate);
+
+    for (const LeaderboardNode *node = leaderboard->header->level[0].forward; node; node = node->level[0].forward) {
+        char score[32];
+        snprintf(score, sizeof(score), "%.17g", node->score);
+
+        RedisModule_EmitAOF(aof, "DC.ZRESTORE", "sllblbc",
+                            key,
+                            (long long)leaderboard->epoch,
+                            (long long)leaderboard->decay,
+                            rate, strlen(rate),
+                            (long long)leaderboard->interval,
+                            node->member, node->member_len,
+                            score);
+    }
+}
+
+size_t leaderboard_mem_usage(const void *value) {
+    const LeaderboardData *leaderboard = value;
+
+    // The member dictionary is Redis' own and doesn't report its size, so this only counts what we allocated.
+    return sizeof(LeaderboardData) + leaderboard_node_size(LEADERBOARD_MAX_LEVEL, 0) + leaderboard->node_bytes;
+}
+
+size_t leaderboard_free_effort(RedisModuleString *key, const void *value) {
+    const LeaderboardData *leaderboard = value;
+
+    // One allocation per member, big leaderboards are worth freeing on the lazy free thread.
+    return leaderboard->length;
+}
+
+// Called from `RedisModule_OnLoad` to create the type and its commands.
+int leaderboard_register(RedisModuleCtx *ctx) {
+    RedisModuleTypeMethods tm = {
+        .version = REDISMODULE_TYPE_METHOD_VERSION,
+        .rdb_load = leaderboard_rdb_load,
+        .rdb_save = leaderboard_rdb_save,
+        .aof_rewrite = leaderboard_aof_rewrite,
+        .mem_usage = leaderboard_mem_usage,
+        .free = leaderboard_free,
+        .free_effort = leaderboard_free_effort
+    };
+
+    Leaderboard = RedisModule_CreateDataType(ctx,
+        LEADERBOARD_TYPE_NAME,
+        LEADERBOARD_ENCODING_VERSION,
+        &tm);
+
+    if (Leaderboard == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.zincr",
+        leaderboard_increment_RedisCommand_Timed, "fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // Reads drop members that have decayed to zero (and replicate that), so these write too.
+    if (RedisModule_CreateCommand(ctx, "dc.zscore",
+        leaderboard_score_RedisCommand_Timed, "fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.zrank",
+        leaderboard_rank_RedisCommand_Timed, "fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.zrange",
+        leaderboard_range_RedisCommand_Timed, "write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.zrestore",
+        leaderboard_restore_RedisCommand, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.zrem",
+        leaderboard_remove_RedisCommand, "write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
@@ -1,168 +1,570 @@
+#define _POSIX_C_SOURCE 200809L // For `clock_gettime`.
+
 #include "redismodule.h"
+#include "module.h"
+#include "pool.h"
+#include "stats.h"
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #define DEGRADING_COUNTER_TYPE_NAME "DeGrad-TB"
-#define DEGRADING_COUNTER_ENCODING_VERSION 0
+// Version 1 added exponential decay, version 2 added profiles (written through `aux_save`), version 3 packs each
+// counter into a single compact record, see `degrading_counter_pack`, and version 4 added the microsecond, hour and day
+// units (a version 3 record is a valid version 4 one, it's older modules that can't read the new units).
+#define DEGRADING_COUNTER_ENCODING_VERSION 4
 #define DEGRADING_COUNTER_MODULE_VERSION 1
 
-#define MILLISECONDS_PER_MILLISECOND 1 // Hehe.
-#define MILLISECONDS_PER_SECOND 1000
-#define MILLISECONDS_PER_MINUTE 60000
+#define LINEAR_DECAY_NAME "LINEAR"
+#define EXPONENTIAL_DECAY_NAME "EXP"
+
+// Exponential decay is evaluated as 2^-(whole + fraction) half-lives. The whole part is an exact `ldexp`, the fraction
+// comes from this many linearly interpolated table entries, which keeps the relative error under 1e-7.
+#define EXPONENTIAL_DECAY_TABLE_SIZE 1024
 
-#define MILLISECONDS_ABBREVIATION "ms"
-#define SECONDS_ABBREVIATION "sec"
-#define MINUTES_ABBREVIATION "min"
+// Defaults for the background sweeper, see `degrading_counter_sweep_timer_callback`.
+#define DEGRADING_COUNTER_DEFAULT_SWEEP_BATCH 1000
 
-#define CLOSE_ENOUGH_TO_ZERO 1e-9
+// How many counters found at zero by a read can be waiting for deletion, see `degrading_counter_queue_delete`.
+#define DEGRADING_COUNTER_MAX_PENDING_DELETES 1024
+
+// How many counters should be carved out of a single pool slab?
+#define DEGRADING_COUNTER_POOL_SLAB_SIZE 4096
 
 // This is a static global pointer to the custom type defined for the degrading counter.
 static RedisModuleType *DegradingCounter;
 
-typedef enum CounterIncrements {
-    Milliseconds = 0,
-    Seconds = 1,
-    Minutes = 2
-} CounterIncrements;
+// Counters are allocated out of three pools: one for counters that carry their own configuration, one for the smaller
+// counters created from a profile and one for the larger counters with a microsecond interval.
+static Pool *DegradingCounterPool;
+static Pool *ProfiledCounterPool;
+static Pool *MicrosecondCounterPool;
+
+// A named profile (DC.PROFILE SET) is just the configuration half of a counter, kept in a DegradingCounterData whose
+// `value` is unused. Ids are handed out in the order profiles are created and never reused, since counters refer to
+// their profile by id. For the same reason a profile can't be changed once it exists.
+typedef struct DegradingCounterProfile {
+    char *name;
+    size_t name_len;
+    DegradingCounterData config;
+} DegradingCounterProfile;
+
+static DegradingCounterProfile *Profiles;
+static size_t ProfileCount;
+static size_t ProfileCapacity;
+
+// Profile name to id + 1, so that a missing name can't be mistaken for the first profile.
+static RedisModuleDict *ProfilesByName;
+
+// The time an RDB save started, written through `aux_save` so every counter in the file can store its creation time as
+// a (usually small) delta from it. It's only set between the BEFORE and AFTER aux callbacks, a counter serialized
+// outside of a full save (DUMP, MIGRATE) stores its absolute creation time instead.
+typedef struct DegradingCounterRdbEpoch {
+    int is_set;
+    mstime_t epoch;
+} DegradingCounterRdbEpoch;
+
+static DegradingCounterRdbEpoch RdbSaveEpoch;
+static DegradingCounterRdbEpoch RdbLoadEpoch;
+
+// State for the optional background sweeper that walks the keyspace looking for counters without an expire.
+typedef struct DegradingCounterSweepState {
+    mstime_t interval; // Milliseconds between sweeps. Zero means the sweeper is disabled.
+    long long batch_size; // How many keys to look at on each sweep.
+    int db; // The database currently being swept.
+    RedisModuleScanCursor *cursor; // Where we left off in the current database.
+} DegradingCounterSweepState;
+
+static DegradingCounterSweepState SweepState = {
+    .interval = 0,
+    .batch_size = DEGRADING_COUNTER_DEFAULT_SWEEP_BATCH,
+    .db = 0,
+    .cursor = NULL
+};
+
+// Counters a read found at zero, waiting for a timer to delete them. See `degrading_counter_queue_delete`.
+typedef struct DegradingCounterPendingDelete {
+    int db;
+    RedisModuleString *key_name;
+} DegradingCounterPendingDelete;
+
+typedef struct DegradingCounterPendingDeletes {
+    DegradingCounterPendingDelete keys[DEGRADING_COUNTER_MAX_PENDING_DELETES];
+    size_t count;
+} DegradingCounterPendingDeletes;
+
+static DegradingCounterPendingDeletes PendingDeletes;
+
+// 2^-x for x in [0, 1], filled in when the module is loaded.
+static double ExponentialDecayTable[EXPONENTIAL_DECAY_TABLE_SIZE + 1];
+
+ustime_t degrading_counter_clock(void) {
+    if (RedisModule_Microseconds != NULL) {
+        return RedisModule_Microseconds();
+    }
+
+    // Redis before 7.2 only gives us milliseconds, so go to the OS for the rest.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
 
-typedef struct DegradingCounterData {
-    ustime_t created; // Time stamp in which the counter was created.
-    double degrades_at; // How much should the counter degrade after an increment has passed. e.g. 1 every millisecond, or .5 every minute.
-    int number_of_increments; // How many increments should elapse before degrading the counter? Defaults to 1.
-    CounterIncrements increment; // Which time increment should be used to degrade the counter?
-    double value; // What is accumulated value of the counter? This will be a raw "un-degraded" number. Only increments and decrements apply here.
-} DegradingCounterData;
+    return (ustime_t)now.tv_sec * MICROSECONDS_PER_SECOND + now.tv_nsec / 1000;
+}
 
-int is_approximately_zero(const double value, const double epsilon) {
-    return fabs(value) < epsilon;
+ustime_t degrading_counter_now(void) {
+    // Without the cached clock (Redis before 7.2) it's still only read once per command, just not for free.
+    return RedisModule_CachedMicroseconds != NULL ? RedisModule_CachedMicroseconds() : degrading_counter_clock();
 }
 
-// This method will compute the degraded value of the counter.
-double degrading_counter_compute_value(RedisModuleCtx *ctx, const DegradingCounterData *counter) {
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Starting] degrading_counter_compute_value");
+// Only counters with a microsecond interval keep their creation time to the microsecond, everything else runs on a
+// millisecond clock exactly as it always has.
+static inline int degrading_counter_has_microseconds(const DegradingCounterData *counter) {
+    return counter->increment == Microseconds;
+}
 
-    // Get current time stamp.
-    const ustime_t current_time_ms = RedisModule_Milliseconds();
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "current_time_ms: %lld", current_time_ms);
+// Bring a time down to the precision the counter keeps, so that a counter always sees the same clock it was stamped with.
+static inline ustime_t degrading_counter_truncate_time(const DegradingCounterData *counter, const ustime_t time) {
+    return degrading_counter_has_microseconds(counter) ? time : time - time % MICROSECONDS_PER_MILLISECOND;
+}
 
-    // Compute the difference. This will give us our age.
-    const ustime_t age_in_milliseconds = current_time_ms - counter->created;
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "age_in_milliseconds: %lld = %lld (current_time_ms) - %lld (counter->created)", age_in_milliseconds, current_time_ms, counter->created);
+// Get the time stamp (Unix microseconds) in which the counter was created.
+static inline ustime_t degrading_counter_get_created(const DegradingCounterData *counter) {
+    const ustime_t created = (DEGRADING_COUNTER_EPOCH_MS + (ustime_t)counter->created_offset) * MICROSECONDS_PER_MILLISECOND;
 
-    // Determine units per increment.
-    long long units_per_increment = 0;
+    return degrading_counter_has_microseconds(counter) ? created + counter->created_microseconds : created;
+}
+
+// Set the time stamp (Unix microseconds) in which the counter was created. Anything outside of what we can represent is
+// clamped, a counter created before the epoch just looks like it was created at the epoch. The unit has to be set first,
+// it decides whether the microseconds are kept.
+static inline void degrading_counter_set_created(DegradingCounterData *counter, const ustime_t created) {
+    ustime_t offset = created / MICROSECONDS_PER_MILLISECOND - DEGRADING_COUNTER_EPOCH_MS;
+    ustime_t microseconds = created % MICROSECONDS_PER_MILLISECOND;
+
+    if (offset < 0 || microseconds < 0) {
+        offset = 0;
+        microseconds = 0;
+    } else if (offset > DEGRADING_COUNTER_MAX_CREATED_OFFSET) {
+        offset = DEGRADING_COUNTER_MAX_CREATED_OFFSET;
+        microseconds = 0;
+    }
+
+    counter->created_offset = (uint64_t)offset;
 
+    if (degrading_counter_has_microseconds(counter)) {
+        counter->created_microseconds = (uint16_t)microseconds;
+    }
+}
+
+// Milliseconds, rounded up, for the times we hand to Redis (expires, timers) or report back. Rounding up means nothing
+// happens before the counter has actually got there.
+static inline mstime_t degrading_counter_to_milliseconds(const ustime_t time) {
+    return time / MICROSECONDS_PER_MILLISECOND + (time % MICROSECONDS_PER_MILLISECOND > 0);
+}
+
+// Where the rate, interval and unit of a counter live. That's the counter itself, unless it was created from a profile.
+static inline const DegradingCounterData *degrading_counter_config(const DegradingCounterData *counter) {
+    return counter->increment == DEGRADING_COUNTER_PROFILED ? &Profiles[counter->number_of_increments].config : counter;
+}
+
+// Fill in a full sized counter with the profile's configuration in place of the profile id. For records that leave the
+// node, where the id would point at whatever profile has it there (or at nothing).
+static void degrading_counter_resolve_profile(const DegradingCounterData *counter, DegradingCounterData *resolved) {
+    const DegradingCounterData *config = degrading_counter_config(counter);
+    const ustime_t created = degrading_counter_get_created(counter);
+
+    memset(resolved, 0, sizeof(DegradingCounterData));
+    resolved->value = counter->value;
+    resolved->degrades_at = config->degrades_at;
+    resolved->number_of_increments = config->number_of_increments;
+    resolved->increment = config->increment;
+    resolved->decay = counter->decay;
+    // After the unit, which decides whether the microseconds are kept.
+    degrading_counter_set_created(resolved, created);
+}
+
+// Which pool does the counter come out of?
+static inline Pool *degrading_counter_pool(const DegradingCounterData *counter) {
     switch (counter->increment) {
-        case Milliseconds:
-            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "units_per_increment: Milliseconds");
-            units_per_increment = MILLISECONDS_PER_MILLISECOND;
-            break;
+        case DEGRADING_COUNTER_PROFILED:
+            return ProfiledCounterPool;
+        case Microseconds:
+            return MicrosecondCounterPool;
+        default:
+            return DegradingCounterPool;
+    }
+}
 
-        case Seconds:
-            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "units_per_increment: Seconds");
-            units_per_increment = MILLISECONDS_PER_SECOND;
-            break;
+// Copy a counter (parsed or unpacked into a full sized struct) into a slot from the right pool, only as many bytes as
+// that kind of counter has.
+static DegradingCounterData *degrading_counter_copy(const DegradingCounterData *counter) {
+    Pool *pool = degrading_counter_pool(counter);
+    DegradingCounterData *copy = pool_alloc(pool);
 
-        case Minutes:
-            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "units_per_increment: Minutes");
-            units_per_increment = MILLISECONDS_PER_MINUTE;
-            break;
+    memcpy(copy, counter, pool_object_size(pool));
+
+    return copy;
+}
+
+int is_approximately_zero(const double value, const double epsilon) {
+    return fabs(value) < epsilon;
+}
 
+long long degrading_counter_unit_in_microseconds(const CounterIncrements unit) {
+    switch (unit) {
+        case Microseconds:
+            return MICROSECONDS_PER_MICROSECOND;
+        case Milliseconds:
+            return MICROSECONDS_PER_MILLISECOND;
+        case Seconds:
+            return MICROSECONDS_PER_SECOND;
+        case Minutes:
+            return MICROSECONDS_PER_MINUTE;
+        case Hours:
+            return MICROSECONDS_PER_HOUR;
+        case Days:
+            return MICROSECONDS_PER_DAY;
         default:
-            // Not sure how we got here, but we should just leave immediately.
             return 0;
     }
-    // TODO: Add in some checks to ensure that we're not overflowing anywhere.
+}
+
+long long degrading_counter_unit_in_milliseconds(const CounterIncrements unit) {
+    return degrading_counter_unit_in_microseconds(unit) / MICROSECONDS_PER_MILLISECOND;
+}
+
+void degrading_counter_init_exponential_decay_table(void) {
+    for (int i = 0; i <= EXPONENTIAL_DECAY_TABLE_SIZE; i++) {
+        ExponentialDecayTable[i] = exp2(-(double)i / EXPONENTIAL_DECAY_TABLE_SIZE);
+    }
+}
+
+// Compute `value * 2^-half_lives` without calling `pow`/`exp` on the hot path.
+double degrading_counter_exponential_decay(const double value, const double half_lives) {
+    if (half_lives <= 0) {
+        return value;
+    }
+
+    // Past this point the result is below the smallest double anyway.
+    if (half_lives >= 1100) {
+        return 0;
+    }
+
+    const double whole = floor(half_lives);
+    const double position = (half_lives - whole) * EXPONENTIAL_DECAY_TABLE_SIZE;
+    const int index = (int)position;
+    const double fraction = ExponentialDecayTable[index] + (ExponentialDecayTable[index + 1] - ExponentialDecayTable[index]) * (position - index);
+
+    return ldexp(value * fraction, -(int)whole);
+}
+
+// This method will compute the degraded value of the counter as of `now`, which the caller read once for the whole
+// command (see `degrading_counter_now`).
+double degrading_counter_compute_value(RedisModuleCtx *ctx, const DegradingCounterData *counter, const ustime_t now) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] degrading_counter_compute_value");
+
+    const DegradingCounterData *config = degrading_counter_config(counter);
+
+    // The clock, at the precision the counter keeps.
+    const ustime_t current_time_us = degrading_counter_truncate_time(counter, now);
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "current_time_us: %lld", current_time_us);
+
+    // Compute the difference. This will give us our age.
+    const ustime_t created = degrading_counter_get_created(counter);
+    const ustime_t age_in_microseconds = current_time_us - created;
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "age_in_microseconds: %lld = %lld (current_time_us) - %lld (counter->created)", age_in_microseconds, current_time_us, created);
+
+    // Exponential decay doesn't step, the half-lives per millisecond were worked out when the counter was created.
+    if (counter->decay == DecayExponential) {
+        const double exponential_value = degrading_counter_exponential_decay(counter->value,
+            (double)age_in_microseconds / MICROSECONDS_PER_MILLISECOND * config->degrades_at);
+
+        DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] degrading_counter_compute_value, Result: %f", exponential_value);
+
+        return exponential_value;
+    }
+
+    // Determine units per increment.
+    const long long units_per_increment = degrading_counter_unit_in_microseconds(config->increment);
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "units_per_increment: %lld", units_per_increment);
+
+    if (units_per_increment == 0) {
+        // Not sure how we got here, but we should just leave immediately.
+        return 0;
+    }
 
-    // Compute the number of increments by dividing the age.
-    const long long number_of_increments = (age_in_milliseconds / units_per_increment) / counter->number_of_increments;
+    // Compute the number of increments by dividing the age. The longest interval (2^20 days) is under 2^57 microseconds,
+    // so none of this overflows.
+    const long long number_of_increments = (age_in_microseconds / units_per_increment) / (long long)config->number_of_increments;
 
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "number_of_increments: %lld = (%lld (age_in_milliseconds) / %lld (units_per_increment)) / %d (counter->number_of_increments)", number_of_increments, age_in_milliseconds, units_per_increment, counter->number_of_increments);
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "number_of_increments: %lld = (%lld (age_in_microseconds) / %lld (units_per_increment)) / %d (counter->number_of_increments)", number_of_increments, age_in_microseconds, units_per_increment, (int)config->number_of_increments);
 
     // Multiply the number of increments by how fast the counter is degrading to figure out degradation.
-    const double degradation = (double)number_of_increments * counter->degrades_at;
+    const double degradation = (double)number_of_increments * config->degrades_at;
 
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "degradation: %f = %f ((double)number_of_increments & %f (counter->degrades_at)", degradation, (double)number_of_increments, counter->degrades_at);
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "degradation: %f = %f ((double)number_of_increments & %f (counter->degrades_at)", degradation, (double)number_of_increments, config->degrades_at);
 
     // Subtract the degradation from the value. Clamp the value at zero.
     const double degraded_value = fmax(0, counter->value - degradation);
 
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Finishing] degrading_counter_compute_value, Result: %f", degraded_value);
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] degrading_counter_compute_value, Result: %f", degraded_value);
 
     // Return the result.
     return degraded_value;
 }
 
-char* degrading_counter_create_interval_string(const DegradingCounterData *counter) {
-    char* buffer = RedisModule_Alloc(25);
-    const size_t buffer_len = sizeof(buffer);
+// The counter stored at `key`, or NULL if the key holds something else (or nothing at all).
+DegradingCounterData *degrading_counter_from_key(RedisModuleKey *key) {
+    if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_MODULE || RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+        return NULL;
+    }
+
+    return RedisModule_ModuleTypeGetValue(key);
+}
+
+// How many microseconds make up one full interval of the counter?
+long long degrading_counter_interval_in_microseconds(const DegradingCounterData *counter) {
+    const DegradingCounterData *config = degrading_counter_config(counter);
+
+    return degrading_counter_unit_in_microseconds(config->increment) * (long long)config->number_of_increments;
+}
+
+long long degrading_counter_interval_in_milliseconds(const DegradingCounterData *counter) {
+    return degrading_counter_interval_in_microseconds(counter) / MICROSECONDS_PER_MILLISECOND;
+}
+
+// How long after its creation time the counter first reads `threshold` or below (or, with `or_below` unset, strictly
+// below). Both decay modes have a closed form. Returns -1 if it never will. The counter has to be above the threshold.
+static double degrading_counter_microseconds_until(const DegradingCounterData *counter, const double threshold, const int or_below) {
+    const long long interval_in_microseconds = degrading_counter_interval_in_microseconds(counter);
+    const double degrades_at = degrading_counter_config(counter)->degrades_at;
+
+    if (degrades_at <= 0 || interval_in_microseconds <= 0) {
+        return -1;
+    }
+
+    double microseconds_until;
+
+    if (counter->decay == DecayExponential) {
+        // `degrades_at` is half-lives per millisecond.
+        const double half_lives = log2(counter->value / threshold);
+        microseconds_until = (or_below ? ceil(half_lives * MICROSECONDS_PER_MILLISECOND / degrades_at) :
+                                         floor(half_lives * MICROSECONDS_PER_MILLISECOND / degrades_at) + 1);
+    } else {
+        // The value drops once per interval, how many drops does it take to get to the threshold?
+        const double drops = or_below ? fmax(0, ceil((counter->value - threshold) / degrades_at)) :
+                                        floor((counter->value - threshold) / degrades_at) + 1;
+        microseconds_until = drops * (double)interval_in_microseconds;
+    }
+
+    return microseconds_until > DEGRADING_COUNTER_MAX_EXPIRE_MS * MICROSECONDS_PER_MILLISECOND ? -1 : microseconds_until;
+}
+
+// Decay is deterministic, so the moment the counter reaches zero can be computed exactly. For linear decay it's the end
+// of the first interval in which the accumulated degradation covers the value. Returns the absolute time in
+// milliseconds, or REDISMODULE_NO_EXPIRE if the counter never gets there.
+mstime_t degrading_counter_compute_zero_time(const DegradingCounterData *counter) {
+    // Exponential decay never actually gets to zero, but it does get close enough for us to treat it as zero.
+    if (counter->decay == DecayExponential && counter->value < CLOSE_ENOUGH_TO_ZERO) {
+        return degrading_counter_to_milliseconds(degrading_counter_get_created(counter));
+    }
+
+    const double microseconds_until_zero = degrading_counter_microseconds_until(counter, CLOSE_ENOUGH_TO_ZERO, 1);
+
+    if (microseconds_until_zero < 0) {
+        return REDISMODULE_NO_EXPIRE;
+    }
+
+    return degrading_counter_to_milliseconds(degrading_counter_get_created(counter) + (ustime_t)microseconds_until_zero);
+}
+
+// When will the counter first read below `threshold`? Like the zero time this has a closed form, it's the same
+// calculation with the threshold in place of zero.
+mstime_t degrading_counter_compute_crossing_time(const DegradingCounterData *counter, const double threshold) {
+    if (counter->value < threshold) {
+        return degrading_counter_to_milliseconds(degrading_counter_get_created(counter));
+    }
+
+    // Linear counters stop at zero and exponential ones never get there, neither goes below a threshold of zero.
+    if (threshold <= 0) {
+        return REDISMODULE_NO_EXPIRE;
+    }
+
+    const double microseconds_until_below = degrading_counter_microseconds_until(counter, threshold, 0);
+
+    if (microseconds_until_below < 0) {
+        return REDISMODULE_NO_EXPIRE;
+    }
+
+    return degrading_counter_to_milliseconds(degrading_counter_get_created(counter) + (ustime_t)microseconds_until_below);
+}
+
+// Set the key's expire to the moment its counter reaches zero, so that counters nobody reads again still get reclaimed.
+// This needs to be called whenever the value or created time of a counter changes.
+void degrading_counter_update_expire(RedisModuleKey *key, const DegradingCounterData *counter) {
+    const mstime_t zero_time = degrading_counter_compute_zero_time(counter);
+
+    if (zero_time == REDISMODULE_NO_EXPIRE) {
+        if (RedisModule_GetExpire(key) != REDISMODULE_NO_EXPIRE) {
+            RedisModule_SetExpire(key, REDISMODULE_NO_EXPIRE);
+        }
+    } else {
+        RedisModule_SetAbsExpire(key, zero_time);
+    }
+}
+
+// Write the counter's interval into `buffer` in the format `INTERVAL` takes, e.g. `5sec`.
+void degrading_counter_format_interval(const DegradingCounterData *counter, char *buffer, const size_t buffer_len) {
+    counter = degrading_counter_config(counter);
 
     switch (counter->increment) {
+        case Microseconds:
+            snprintf(buffer, buffer_len, "%d%s", (int)counter->number_of_increments, MICROSECONDS_ABBREVIATION);
+            break;
         case Milliseconds:
-            snprintf(buffer, buffer_len, "%d%s", counter->number_of_increments, MILLISECONDS_ABBREVIATION);
+            snprintf(buffer, buffer_len, "%d%s", (int)counter->number_of_increments, MILLISECONDS_ABBREVIATION);
             break;
         case Seconds:
-            snprintf(buffer, buffer_len, "%d%s", counter->number_of_increments, SECONDS_ABBREVIATION);
+            snprintf(buffer, buffer_len, "%d%s", (int)counter->number_of_increments, SECONDS_ABBREVIATION);
             break;
         case Minutes:
-            snprintf(buffer, buffer_len, "%d%s", counter->number_of_increments, MINUTES_ABBREVIATION);
+            snprintf(buffer, buffer_len, "%d%s", (int)counter->number_of_increments, MINUTES_ABBREVIATION);
+            break;
+        case Hours:
+            snprintf(buffer, buffer_len, "%d%s", (int)counter->number_of_increments, HOURS_ABBREVIATION);
+            break;
+        case Days:
+            snprintf(buffer, buffer_len, "%d%s", (int)counter->number_of_increments, DAYS_ABBREVIATION);
             break;
         default:
-            return NULL;
+            snprintf(buffer, buffer_len, "?");
+            break;
+    }
+}
+
+// The next bigger unit, -1 for days.
+static int degrading_counter_next_unit(const uint64_t unit) {
+    switch (unit) {
+        case Microseconds:
+            return Milliseconds;
+        case Milliseconds:
+            return Seconds;
+        case Seconds:
+            return Minutes;
+        case Minutes:
+            return Hours;
+        case Hours:
+            return Days;
+        default:
+            return -1;
+    }
+}
+
+// Interval lengths used to get a bit more room in the counter, so a record written back then can hold one that no longer
+// fits. Those move up to a bigger unit (90000000ms is 25hour), rounded to the nearest one when it isn't exact, which
+// is off by at most half a second on an interval of over seventeen minutes. Returns 0 once the interval fits, -1 if it
+// can't be made to.
+static int degrading_counter_fit_interval(uint64_t *number_of_increments, uint64_t *unit) {
+    while (*number_of_increments > DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS) {
+        // Records from back then never had microseconds.
+        const int next_unit = *unit == Microseconds ? -1 : degrading_counter_next_unit(*unit);
+
+        if (next_unit < 0) {
+            return -1;
+        }
+
+        const uint64_t factor = (uint64_t)(degrading_counter_unit_in_microseconds(next_unit) / degrading_counter_unit_in_microseconds(*unit));
+
+        *number_of_increments = (*number_of_increments + factor / 2) / factor;
+        *unit = next_unit;
     }
 
-    return buffer;
+    return 0;
 }
 
 int degrading_counter_parse_interval_string(const char *interval_str, int *number_of_increments, CounterIncrements *unit) {
-    char unit_str[4]; // This will hold the `min`, `sec`, `ms` component of the interval string.
+    char unit_str[5]; // This will hold the `us`, `ms`, `sec`, `min`, `hour` or `day` component of the interval string.
+    int parsed_len = 0;
 
-    if (sscanf(interval_str, "%d%4s", number_of_increments, unit_str) != 2) { // NOLINT(*-err34-c), At this point I don't care why parsing failed.
-        // TODO: Maybe start caring?
+    if (sscanf(interval_str, "%d%4s%n", number_of_increments, unit_str, &parsed_len) != 2 || // NOLINT(*-err34-c), At this point I don't care why parsing failed.
+        interval_str[parsed_len] != '\0') { // Anything after the unit (`5hours`) isn't one of ours either.
         return -1;
     }
 
-    if (strcmp(unit_str, "ms") == 0) {
+    if (strcmp(unit_str, MICROSECONDS_ABBREVIATION) == 0) {
+        *unit = Microseconds;
+    } else if (strcmp(unit_str, MILLISECONDS_ABBREVIATION) == 0) {
         *unit = Milliseconds;
-        return 0;
+    } else if (strcmp(unit_str, SECONDS_ABBREVIATION) == 0) {
+        *unit = Seconds;
+    } else if (strcmp(unit_str, MINUTES_ABBREVIATION) == 0) {
+        *unit = Minutes;
+    } else if (strcmp(unit_str, HOURS_ABBREVIATION) == 0) {
+        *unit = Hours;
+    } else if (strcmp(unit_str, DAYS_ABBREVIATION) == 0) {
+        *unit = Days;
+    } else {
+        // We made it here, the input must have been invalid. We'll leave it to the caller to say why and report the error.
+        return -1;
     }
 
-    if (strcmp(unit_str, "sec") == 0) {
-        *unit = Seconds;
-        return 0;
+    // Microsecond counters are bigger, don't make one unless the interval actually needs it.
+    if (*unit == Microseconds && *number_of_increments > 0 && *number_of_increments % MICROSECONDS_PER_MILLISECOND == 0) {
+        *number_of_increments /= MICROSECONDS_PER_MILLISECOND;
+        *unit = Milliseconds;
     }
 
-    if (strcmp(unit_str, "min") == 0) {
-        *unit = Minutes;
-        return 0;
+    // An interval too long for its own unit still fits when it's a whole number of a bigger one (5000000ms is 5000sec).
+    // Only the ones that aren't get turned away below.
+    while (*number_of_increments > DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS) {
+        const int next_unit = degrading_counter_next_unit(*unit);
+
+        if (next_unit < 0) {
+            break;
+        }
+
+        const long long factor = degrading_counter_unit_in_microseconds(next_unit) / degrading_counter_unit_in_microseconds(*unit);
+
+        if (*number_of_increments % factor != 0) {
+            break;
+        }
+
+        *number_of_increments /= factor;
+        *unit = next_unit;
+    }
+
+    // The interval length has to fit in the bits we've set aside for it in the counter, and a zero length interval
+    // would have us dividing by zero.
+    if (*number_of_increments <= 0 || *number_of_increments > DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS) {
+        return -1;
     }
 
-    // We made it here, the input must have been invalid. We'll leave it to the caller to say why and report the error.
-    return -1;
+    return 0;
 }
 
-// Create a struct of type DegradingCounterData and populate it from the arguments passed into the Redis command.
-DegradingCounterData* get_degrading_counter_data_from_redis_arguments(RedisModuleCtx* ctx, RedisModuleString **argv) {
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Starting] get_degrading_counter_data_from_redis_arguments");
+// Create a struct of type DegradingCounterData and populate it from the arguments passed into the Redis command. The
+// name/value pairs start at `argv[2]` and run up to `argc`. Counters need an `AMOUNT`, profiles (`expects_amount` unset)
+// must not have one.
+static DegradingCounterData* degrading_counter_parse_arguments(RedisModuleCtx* ctx, RedisModuleString **argv, const int argc, const int expects_amount) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] degrading_counter_parse_arguments");
     // This method is intended to be called from within a context that has already checked the number of arguments.
 
-    // Let's start by having Redis allocate enough memory for us to store would DegradingCounterData struct. Allocating
-    // the memory this way let's Redis correctly report how much memory it's using.
-    // TODO: Check to ensure that the memory was allocated successfully.
-    DegradingCounterData *degrading_counter_data = RedisModule_Alloc(sizeof(DegradingCounterData));
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "Allocated %ld bytes for an instance of DegradingCounterData.", sizeof(DegradingCounterData));
-
-    // Now that the memory for the degrading_counter_data struct instance is allocated we'll go and parse the arguments and
-    // hopefully return a pointer to the struct containing the data we want to work with.
+    // We parse into a struct on the stack first. Which pool the counter comes out of depends on its interval, so it's
+    // only allocated once we know that.
+    DegradingCounterData parsed = {0};
+    DegradingCounterData *degrading_counter_data = &parsed;
 
     // I don't think we should require the arguments to be in a specific order, as long as everything is provided it should
-    // be fine. So we'll loop over the arguments, which should have already been validated to ensure that exact six
-    // were provided.
-    // TODO: Should make sure AMOUNT, DEGRADE_RATE, and INTERVAL were each passed in.
-    // TODO: To support default arguments we're going to have to take in the arg count and use that as an upper bounds
-    //       instead of hard coding the 8 here.
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "Parsing command arguments.");
-    for (int i = 2; i < 8; i += 2) { // Adding two so that the next index will reference a name.
+    // be fine. So we'll loop over the arguments and check that we got what the decay mode needs once we're done.
+    int has_amount = 0;
+    int has_degrade_rate = 0;
+    int has_interval = 0;
+    int has_half_life = 0;
+
+    degrading_counter_data->decay = DecayLinear;
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "Parsing command arguments.");
+    for (int i = 2; i + 1 < argc; i += 2) { // Adding two so that the next index will reference a name.
         size_t arg_len;
         const char *arg_name = RedisModule_StringPtrLen(argv[i], &arg_len); // Doesn't need to be freed as it's handled by Redis.
 
@@ -170,341 +572,1807 @@ DegradingCounterData* get_degrading_counter_data_from_redis_arguments(RedisModul
         if (strcmp(arg_name, "AMOUNT") == 0) {
             if (RedisModule_StringToDouble(argv[i + 1], &degrading_counter_data->value) != REDISMODULE_OK) {
                 RedisModule_ReplyWithError(ctx, "ERR invalid value for AMOUNT: must be a signed double.");
-                RedisModule_Free(degrading_counter_data);
+                stats_record_parse_error();
                 return NULL;
             }
 
-            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "Handling `AMOUNT`, parsed: %f", degrading_counter_data->value);
+            has_amount = 1;
+
+            DEGRADING_COUNTER_LOG_DEBUG(ctx, "Handling `AMOUNT`, parsed: %f", degrading_counter_data->value);
         }
 
         // Check `DEGRADE_RATE`
         else if (strcmp(arg_name, "DEGRADE_RATE") == 0) {
             if (RedisModule_StringToDouble(argv[i + 1], &degrading_counter_data->degrades_at) != REDISMODULE_OK) {
                 RedisModule_ReplyWithError(ctx, "ERR invalid value for DEGRADE_RATE: must be a signed double.");
-                RedisModule_Free(degrading_counter_data);
+                stats_record_parse_error();
                 return NULL;
             }
 
-            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "Handling `DEGRADE_RATE`, parsed: %f", degrading_counter_data->degrades_at);
+            has_degrade_rate = 1;
+
+            DEGRADING_COUNTER_LOG_DEBUG(ctx, "Handling `DEGRADE_RATE`, parsed: %f", degrading_counter_data->degrades_at);
         }
 
-        // Check `INTERVAL`
-        else if (strcmp(arg_name, "INTERVAL") == 0) {
+        // Check `INTERVAL`, or `HALFLIFE` which is the interval for exponential decay.
+        else if (strcmp(arg_name, "INTERVAL") == 0 || strcmp(arg_name, "HALFLIFE") == 0) {
             size_t interval_len;
             // `interval_str` shouldn't need to be freed as we're creating it via `RedisModule_StringPtrLen` which is returning
             // a pointing to an internal buffer managed by Redis.
             const char *interval_str = RedisModule_StringPtrLen(argv[i + 1], &interval_len);
 
-            if (degrading_counter_parse_interval_string(interval_str,
-                                                     &degrading_counter_data->number_of_increments,
-                                                     &degrading_counter_data->increment) != 0) {
+            // The interval lives in bit-fields, so we have to parse it into locals first.
+            int number_of_increments;
+            CounterIncrements increment;
+
+            if (degrading_counter_parse_interval_string(interval_str, &number_of_increments, &increment) != 0) {
+
+                RedisModule_ReplyWithErrorFormat(ctx, "Err invalid value for %s: %s", arg_name, interval_str);
+                stats_record_parse_error();
+                return NULL;
+            }
+
+            degrading_counter_data->number_of_increments = number_of_increments;
+            degrading_counter_data->increment = increment;
+
+            if (strcmp(arg_name, "HALFLIFE") == 0) {
+                has_half_life = 1;
+            } else {
+                has_interval = 1;
+            }
+
+            DEGRADING_COUNTER_LOG_DEBUG(ctx, "Handling `INTERVAL` as occurring every %d '%s'", number_of_increments, interval_str);
+        }
 
-                RedisModule_ReplyWithErrorFormat(ctx, "Err invalid value for INTERVAL: %s", interval_str);
-                RedisModule_Free(degrading_counter_data);
+        // Check `DECAY`
+        else if (strcmp(arg_name, "DECAY") == 0) {
+            const char *decay_str = RedisModule_StringPtrLen(argv[i + 1], NULL);
+
+            if (strcmp(decay_str, LINEAR_DECAY_NAME) == 0) {
+                degrading_counter_data->decay = DecayLinear;
+            } else if (strcmp(decay_str, EXPONENTIAL_DECAY_NAME) == 0) {
+                degrading_counter_data->decay = DecayExponential;
+            } else {
+                RedisModule_ReplyWithErrorFormat(ctx, "ERR invalid value for DECAY: %s. Must be LINEAR or EXP.", decay_str);
+                stats_record_parse_error();
                 return NULL;
             }
 
-            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "Handling `INTERVAL` as occurring every %d '%s'", degrading_counter_data->number_of_increments, interval_str);
+            DEGRADING_COUNTER_LOG_DEBUG(ctx, "Handling `DECAY`, parsed: %s", decay_str);
         }
 
         // Got something else...
         else {
-            RedisModule_Free(degrading_counter_data); // This is in a bad state, and we don't need it.
             RedisModule_ReplyWithErrorFormat(ctx, "ERR unexpected argument: %s. (Remember argument names are case sensitive.)", arg_name);
+            stats_record_parse_error();
 
             return NULL; // There is nothing to return. This will be handled by the caller.
         }
     }
 
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Finishing] get_degrading_counter_data_from_redis_arguments");
+    // Linear decay needs a rate and an interval, exponential decay just needs its half-life.
+    const int is_exponential = degrading_counter_data->decay == DecayExponential;
+    const int has_required_arguments = has_amount == expects_amount && (is_exponential ?
+        has_half_life && !has_degrade_rate && !has_interval :
+        has_degrade_rate && has_interval && !has_half_life);
+
+    if (!has_required_arguments) {
+        if (expects_amount) {
+            RedisModule_ReplyWithError(ctx, is_exponential ?
+                "ERR exponential decay requires AMOUNT and HALFLIFE (and doesn't accept DEGRADE_RATE or INTERVAL)." :
+                "ERR linear decay requires AMOUNT, DEGRADE_RATE and INTERVAL (and doesn't accept HALFLIFE).");
+        } else if (has_amount) {
+            RedisModule_ReplyWithError(ctx, "ERR AMOUNT isn't accepted here (profiles get it from DC.INCR, DC.ALLOW from COST, DC.CMS.INCR from ITEMS).");
+        } else {
+            RedisModule_ReplyWithError(ctx, is_exponential ?
+                "ERR exponential decay requires HALFLIFE (and doesn't accept DEGRADE_RATE or INTERVAL)." :
+                "ERR linear decay requires DEGRADE_RATE and INTERVAL (and doesn't accept HALFLIFE).");
+        }
 
-    // We've made it this far... I'm assuming that there are no issues so we're going to return the pointer to the
-    // caller, where we expect the instance of the struct to be used and then freed.
-    return degrading_counter_data;
-}
+        stats_record_parse_error();
+        return NULL;
+    }
 
-// ------- Commands
+    // Evaluating exponential decay only needs the number of half-lives per millisecond, so work it out once up front.
+    if (is_exponential) {
+        degrading_counter_data->degrades_at = (double)MICROSECONDS_PER_MILLISECOND / (double)degrading_counter_interval_in_microseconds(degrading_counter_data);
+    }
 
-// Increment counter (DC.INCR): Create counter if it doesn't exist increment by specified amount of values if it does.
-//                    Gonna set the rest of the properties.
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] degrading_counter_parse_arguments");
 
-// DC.INCR test_counter AMOUNT 1 DEGRADE_RATE 1.0 INTERVAL 5sec
-int degrading_counter_increment_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Starting] (DC.INCR) degrading_counter_increment_RedisCommand");
-    RedisModule_AutoMemory(ctx); // Enable the use of automatic memory management.
+    // We've made it this far... I'm assuming that there are no issues so we're going to return a pooled copy to the
+    // caller, where we expect it to be used and then freed.
+    return degrading_counter_copy(degrading_counter_data);
+}
 
-    // For now all arguments are required, we'll pass back an error in the event that 6 arguments weren't
-    // passed in.
-    if (argc != 8) { // 6 user supplied arguments, plus two more for the command name and key name.
-        return RedisModule_WrongArity(ctx);
-    }
+DegradingCounterData* get_degrading_counter_data_from_redis_arguments(RedisModuleCtx* ctx, RedisModuleString **argv, const int argc) {
+    return degrading_counter_parse_arguments(ctx, argv, argc, 1);
+}
 
-    // Get the key from the argument list.
-    RedisModuleString *key_name = argv[1];
+DegradingCounterData *get_degrading_counter_config_from_redis_arguments(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    return degrading_counter_parse_arguments(ctx, argv, argc, 0);
+}
 
-    // Get a reference to the actual Redis key handle.
-    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+// ------- Profiles
 
-    // Get the key type, this will tell us if the key we are working with is already set or not.
-    const int key_type = RedisModule_KeyType(key);
+// Look up a profile by name. Returns 0 and sets `profile_id` if it exists, -1 otherwise.
+static int degrading_counter_find_profile(RedisModuleString *name, uint64_t *profile_id) {
+    size_t name_len;
+    const char *name_str = RedisModule_StringPtrLen(name, &name_len);
+    const uintptr_t found = (uintptr_t)RedisModule_DictGetC(ProfilesByName, (void *)name_str, name_len, NULL);
 
-    // Let's make sure we're dealing with the correct kind of key first.
-    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
-        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
-        // The wrong type of key was specified so we're bailing out with a wrong type error message.
-        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    if (found == 0) {
+        return -1;
     }
 
-    // Next, if possible, let's parse the args passed into the Redis command and see what we have.
-    DegradingCounterData *degrading_counter_data = get_degrading_counter_data_from_redis_arguments(ctx, argv);
+    *profile_id = found - 1;
 
-    // If `degrading_counter_data` is NULL here, there was an error parsing the values and we should just bail out.
-    if (degrading_counter_data == NULL) {
-        // All we have to do is return an error here, the error has already been sent to the caller.
-        return REDISMODULE_ERR;
+    return 0;
+}
+
+// Add a new profile, the name and configuration are copied. The caller makes sure the name isn't taken and that there's
+// room for another id.
+static void degrading_counter_add_profile(const char *name, const size_t name_len, const DegradingCounterData *config) {
+    if (ProfileCount == ProfileCapacity) {
+        ProfileCapacity = ProfileCapacity == 0 ? 8 : ProfileCapacity * 2;
+        Profiles = RedisModule_Realloc(Profiles, sizeof(DegradingCounterProfile) * ProfileCapacity);
     }
 
-    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
-        // We have a new key here, let's set the created field.
-        degrading_counter_data->created = RedisModule_Milliseconds();
+    DegradingCounterProfile *profile = &Profiles[ProfileCount];
+
+    profile->name = RedisModule_Alloc(name_len);
+    profile->name_len = name_len;
+    memcpy(profile->name, name, name_len);
+    // Only the configuration is copied, the caller's counter may come out of a pool whose slots stop short of the
+    // fields a counter with its own configuration never touches.
+    memset(&profile->config, 0, sizeof(DegradingCounterData));
+    profile->config.degrades_at = config->degrades_at;
+    profile->config.number_of_increments = config->number_of_increments;
+    profile->config.increment = config->increment;
+    profile->config.decay = config->decay;
+
+    RedisModule_DictSetC(ProfilesByName, profile->name, name_len, (void *)(uintptr_t)(ProfileCount + 1));
+    ProfileCount++;
+}
 
-        // Now let's persist and return the starting value.
-        RedisModule_ModuleTypeSetValue(key, DegradingCounter, degrading_counter_data);
+static int degrading_counter_is_same_config(const DegradingCounterData *a, const DegradingCounterData *b) {
+    return a->degrades_at == b->degrades_at &&
+           a->number_of_increments == b->number_of_increments &&
+           a->increment == b->increment &&
+           a->decay == b->decay;
+}
 
-        // We're just going to return the initial value on first save.
-        RedisModule_ReplyWithDouble(ctx, degrading_counter_data->value);
-    } else {
-        // We have an existing key, let's get access to it.
-        DegradingCounterData *stored_degrading_counter_data = RedisModule_ModuleTypeGetValue(key);
+// Find the profile called `name`, creating it from `config` if it doesn't exist yet. Replies with an error and returns
+// -1 if there's already a profile by that name with a different configuration, or no room for another one.
+static int degrading_counter_define_profile(RedisModuleCtx *ctx, RedisModuleString *name, const DegradingCounterData *config, uint64_t *profile_id) {
+    size_t name_len;
+    const char *name_str = RedisModule_StringPtrLen(name, &name_len);
 
-        // Next we'll check to see if the computed value of the existing key is zero.
-        const double current_decremented_value = degrading_counter_compute_value(ctx, stored_degrading_counter_data);
+    if (degrading_counter_find_profile(name, profile_id) == 0) {
+        if (!degrading_counter_is_same_config(&Profiles[*profile_id].config, config)) {
+            RedisModule_ReplyWithErrorFormat(ctx, "ERR profile %s already exists with a different configuration. Profiles can't be changed, create a new one instead.", name_str);
+            return -1;
+        }
 
-        if (is_approximately_zero(current_decremented_value, CLOSE_ENOUGH_TO_ZERO)) {
-            stored_degrading_counter_data->value = degrading_counter_data->value;
-            stored_degrading_counter_data->created = RedisModule_Milliseconds();
+        return 0;
+    }
 
-            RedisModule_ReplyWithDouble(ctx, stored_degrading_counter_data->value);
-        }
-        // The existing counter isn't done so we'll continue to work with it.
-        else {
-            // We pull a reference to the memory that is holding our existing key and increment the `value` property by the
-            // amount from the passed in argument.
-            stored_degrading_counter_data->value += degrading_counter_data->value;
+    if (ProfileCount == DEGRADING_COUNTER_MAX_PROFILES) {
+        RedisModule_ReplyWithError(ctx, "ERR too many profiles.");
+        return -1;
+    }
 
-            // TODO: If the result of the above operation results in a value that is less than or equal to zero then we
-            //       should go ahead and remove the key from the keyspace.
+    // Counters created from a profile don't have room for the microseconds of their creation time.
+    if (config->increment == Microseconds) {
+        RedisModule_ReplyWithError(ctx, "ERR profiles can't have an interval under a millisecond, or one that isn't a whole number of milliseconds.");
+        return -1;
+    }
 
-            // Next, let's compute how much of our counter has degraded.
-            const double degraded_counter_value = degrading_counter_compute_value(ctx, stored_degrading_counter_data);
+    *profile_id = ProfileCount;
+    degrading_counter_add_profile(name_str, name_len, config);
 
-            // Finally, return the degraded counter value.
-            RedisModule_ReplyWithDouble(ctx, degraded_counter_value);
-        }
+    return 0;
+}
 
-        RedisModule_Free(degrading_counter_data);
+// Forget every profile, used before loading the ones saved in an RDB file.
+static void degrading_counter_clear_profiles(void) {
+    for (size_t i = 0; i < ProfileCount; i++) {
+        RedisModule_DictDelC(ProfilesByName, Profiles[i].name, Profiles[i].name_len, NULL);
+        RedisModule_Free(Profiles[i].name);
     }
 
-    // Mark the key ready to replicate to secondaries or to an AOF file...
-    RedisModule_ReplicateVerbatim(ctx);
+    ProfileCount = 0;
+}
 
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Finishing] (DC.INCR) degrading_counter_increment_RedisCommand");
+// ------- Commands
 
-    return REDISMODULE_OK;
+// Replicate the state a write left the counter in instead of the command that got it there. A replica (or the AOF)
+// replaying DC.INCR would stamp the counter with its own clock and drift from us, the packed record carries our
+// absolute creation time so every copy of the counter decays in step. It's the same DC.RESTORE the AOF rewrite emits.
+static void degrading_counter_replicate_state(RedisModuleCtx *ctx, RedisModuleString *key_name, const DegradingCounterData *counter, const ustime_t now) {
+    unsigned char packed[DEGRADING_COUNTER_MAX_PACKED_SIZE];
+    const size_t packed_len = degrading_counter_pack(counter, NULL, now, packed);
+
+    if (counter->increment != DEGRADING_COUNTER_PROFILED) {
+        RedisModule_Replicate(ctx, "DC.RESTORE", "sb", key_name, (const char *)packed, packed_len);
+        return;
+    }
+
+    const DegradingCounterProfile *profile = &Profiles[counter->number_of_increments];
+    unsigned char packed_profile[DEGRADING_COUNTER_MAX_PACKED_SIZE];
+    const size_t packed_profile_len = degrading_counter_pack(&profile->config, NULL, now, packed_profile);
+
+    RedisModule_Replicate(ctx, "DC.RESTORE", "sbcbb",
+                          key_name,
+                          (const char *)packed, packed_len,
+                          "PROFILE",
+                          profile->name, profile->name_len,
+                          (const char *)packed_profile, packed_profile_len);
 }
 
-// Decrement counter (DC.DECR): Provide a way for a user to decrement a counter.
-// DC.DECR test_counter 1
-int degrading_counter_decrement_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Starting] (DC.DECR) degrading_counter_decrement_RedisCommand");
-    RedisModule_AutoMemory(ctx);
+// Fire a keyspace notification for a write to a counter and signal the key as modified, so clients caching counters
+// locally (RESP3 client-side caching, or anything subscribed to keyspace events) know to drop it.
+static void degrading_counter_notify(RedisModuleCtx *ctx, const int type, const char *event, RedisModuleString *key_name) {
+    RedisModule_NotifyKeyspaceEvent(ctx, type, event, key_name);
+    RedisModule_SignalModifiedKey(ctx, key_name);
+}
 
-    if (argc > 3) { // 1 optional user supplied argument, plus the command name and the key name.
-        return RedisModule_WrongArity(ctx);
-    }
+// Provided as the timer callback that deletes the counters queued by `degrading_counter_queue_delete`. Each one is
+// checked again, a write could have brought it back up (or replaced it) since it was queued.
+static void degrading_counter_pending_delete_timer_callback(RedisModuleCtx *ctx, void *data) {
+    // We could have been demoted in the meantime, the new primary will take care of them.
+    const int is_primary = RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_MASTER;
+    const ustime_t now = degrading_counter_clock();
+
+    for (size_t i = 0; i < PendingDeletes.count; i++) {
+        RedisModuleString *key_name = PendingDeletes.keys[i].key_name;
+
+        if (is_primary && RedisModule_SelectDb(ctx, PendingDeletes.keys[i].db) == REDISMODULE_OK) {
+            RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+
+            if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY &&
+                RedisModule_ModuleTypeGetType(key) == DegradingCounter &&
+                is_approximately_zero(degrading_counter_compute_value(ctx, RedisModule_ModuleTypeGetValue(key), now), CLOSE_ENOUGH_TO_ZERO)) {
+                // Writes made from a timer aren't propagated on their own.
+                RedisModule_DeleteKey(key);
+                RedisModule_Replicate(ctx, "DEL", "s", key_name);
+                degrading_counter_notify(ctx, REDISMODULE_NOTIFY_GENERIC, "del", key_name);
+                stats_record_lazy_deletion();
+            }
 
-    // Get the key from the argument list.
-    RedisModuleString *key_name = argv[1];
+            RedisModule_CloseKey(key);
+        }
 
-    // Get a reference to the actual Redis key handle.
-    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+        RedisModule_FreeString(NULL, key_name);
+    }
 
-    // Get the key type, this will tell us if the key we are working with is already set or not.
-    const int key_type = RedisModule_KeyType(key);
+    PendingDeletes.count = 0;
+}
 
-    // Make sure that we're dealing with the correct kind key here.
-    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
-        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
-        // The wrong type of key was specified so we're bailing out with a wrong type error message.
-        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+// DC.PEEK and DC.MPEEK are read-only so replicas can serve them, which means they can't delete a counter they find at
+// zero. On the primary they queue it here instead and a timer deletes it, and replicates the DEL, as soon as the
+// command returns. Counters with an expire are normally gone before anyone sees them at zero, so this mostly picks up
+// the ones without. If the queue is full the key is left for the next read (or the sweeper) to find.
+static void degrading_counter_queue_delete(RedisModuleCtx *ctx, RedisModuleKey *key) {
+    if (!(RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_MASTER) ||
+        PendingDeletes.count == DEGRADING_COUNTER_MAX_PENDING_DELETES) {
+        return;
     }
 
-    // Does the key even exist?
-    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
-        return RedisModule_ReplyWithNull(ctx);
+    if (PendingDeletes.count == 0) {
+        RedisModule_CreateTimer(ctx, 0, degrading_counter_pending_delete_timer_callback, NULL);
     }
 
-    double decrement_amount;
+    PendingDeletes.keys[PendingDeletes.count].db = RedisModule_GetSelectedDb(ctx);
+    PendingDeletes.keys[PendingDeletes.count].key_name =
+        RedisModule_CreateStringFromString(NULL, RedisModule_GetKeyNameFromModuleKey(key));
+    PendingDeletes.count++;
+}
+
+// Add `amount` to the counter stored at an existing key, using whatever configuration it was created with. Returns the
+// degraded value after the increment.
+static double degrading_counter_add(RedisModuleCtx *ctx, RedisModuleKey *key, DegradingCounterData *stored_degrading_counter_data, const double amount, const ustime_t now) {
+    // Next we'll check to see if the computed value of the existing key is zero.
+    const double current_decremented_value = degrading_counter_compute_value(ctx, stored_degrading_counter_data, now);
+
+    double result;
+
+    if (is_approximately_zero(current_decremented_value, CLOSE_ENOUGH_TO_ZERO)) {
+        stored_degrading_counter_data->value = amount;
+        degrading_counter_set_created(stored_degrading_counter_data, now);
+
+        result = stored_degrading_counter_data->value;
+    }
+    // An exponentially decaying counter can't just have the amount added to its raw value, so we re-anchor it to now.
+    else if (stored_degrading_counter_data->decay == DecayExponential) {
+        stored_degrading_counter_data->value = current_decremented_value + amount;
+        degrading_counter_set_created(stored_degrading_counter_data, now);
+
+        result = stored_degrading_counter_data->value;
+    }
+    // The existing counter isn't done so we'll continue to work with it.
+    else {
+        // We pull a reference to the memory that is holding our existing key and increment the `value` property by the
+        // amount from the passed in argument.
+        stored_degrading_counter_data->value += amount;
+
+        // TODO: If the result of the above operation results in a value that is less than or equal to zero then we
+        //       should go ahead and remove the key from the keyspace.
+
+        // Next, let's compute how much of our counter has degraded.
+        result = degrading_counter_compute_value(ctx, stored_degrading_counter_data, now);
+    }
+
+    // Either way the counter will now reach zero at a different time.
+    degrading_counter_update_expire(key, stored_degrading_counter_data);
+
+    return result;
+}
+
+// Apply a parsed increment to an already opened key, creating the counter if the key is empty. This takes ownership of
+// `degrading_counter_data`, it's either stored in the keyspace or freed. Returns the degraded value after the increment.
+double degrading_counter_apply_increment(RedisModuleCtx *ctx, RedisModuleKey *key, const int key_type, DegradingCounterData *degrading_counter_data, const ustime_t now) {
+    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
+        // We have a new key here, let's set the created field.
+        degrading_counter_set_created(degrading_counter_data, now);
+
+        // Now let's persist the starting value.
+        RedisModule_ModuleTypeSetValue(key, DegradingCounter, degrading_counter_data);
+        degrading_counter_update_expire(key, degrading_counter_data);
+
+        // We're just going to return the initial value on first save.
+        return degrading_counter_data->value;
+    }
+
+    // We have an existing key, only the amount matters from here on.
+    const double result = degrading_counter_add(ctx, key, RedisModule_ModuleTypeGetValue(key), degrading_counter_data->value, now);
+
+    degrading_counter_free(degrading_counter_data);
+
+    return result;
+}
+
+// A new counter created from profile `profile_id`, holding `amount` as of now.
+static DegradingCounterData *degrading_counter_create_from_profile(const uint64_t profile_id, const double amount, const ustime_t now) {
+    DegradingCounterData *degrading_counter_data = pool_alloc(ProfiledCounterPool);
+
+    degrading_counter_data->value = amount;
+    degrading_counter_data->number_of_increments = profile_id;
+    degrading_counter_data->increment = DEGRADING_COUNTER_PROFILED;
+    degrading_counter_data->decay = Profiles[profile_id].config.decay;
+    degrading_counter_set_created(degrading_counter_data, now);
+
+    return degrading_counter_data;
+}
+
+// The short form of DC.INCR: `DC.INCR key amount [PROFILE name]`. The amount is the only thing parsed. An existing
+// counter keeps its own configuration, a new one is created from the profile and only holds the profile's id.
+static int degrading_counter_increment_short_form(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc, RedisModuleKey *key, const int key_type, const ustime_t now) {
+    double amount;
+    uint64_t profile_id = 0;
+
+    if (RedisModule_StringToDouble(argv[2], &amount) != REDISMODULE_OK) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR invalid value for amount: must be a signed double.");
+    }
+
+    if (argc == 5) {
+        const char *arg_name = RedisModule_StringPtrLen(argv[3], NULL);
+
+        if (strcmp(arg_name, "PROFILE") != 0) {
+            stats_record_parse_error();
+            return RedisModule_ReplyWithErrorFormat(ctx, "ERR unexpected argument: %s. (Remember argument names are case sensitive.)", arg_name);
+        }
+
+        if (degrading_counter_find_profile(argv[4], &profile_id) != 0) {
+            return RedisModule_ReplyWithErrorFormat(ctx, "ERR no such profile: %s.", RedisModule_StringPtrLen(argv[4], NULL));
+        }
+    }
+
+    double result;
+
+    if (key_type != REDISMODULE_KEYTYPE_EMPTY) {
+        result = degrading_counter_add(ctx, key, RedisModule_ModuleTypeGetValue(key), amount, now);
+    } else if (argc == 5) {
+        DegradingCounterData *degrading_counter_data = degrading_counter_create_from_profile(profile_id, amount, now);
+
+        RedisModule_ModuleTypeSetValue(key, DegradingCounter, degrading_counter_data);
+        degrading_counter_update_expire(key, degrading_counter_data);
+
+        result = amount;
+    } else {
+        return RedisModule_ReplyWithError(ctx, "ERR the counter doesn't exist, pass a PROFILE (or use the full form) to create it.");
+    }
+
+    RedisModule_ReplyWithDouble(ctx, result);
+    degrading_counter_replicate_state(ctx, argv[1], RedisModule_ModuleTypeGetValue(key), now);
+    degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.incr", argv[1]);
+    watch_counter_changed(ctx, argv[1], RedisModule_ModuleTypeGetValue(key));
+
+    return REDISMODULE_OK;
+}
+
+// Compute the current value of an existing counter, queueing the key for deletion if the counter has degraded all the way
+// to zero.
+double degrading_counter_peek_value(RedisModuleCtx *ctx, RedisModuleKey *key, const ustime_t now) {
+    DegradingCounterData *stored_degraded_counter_data = RedisModule_ModuleTypeGetValue(key);
+
+    // Let's compute the current value of the counter.
+    const double current_decremented_value = degrading_counter_compute_value(ctx, stored_degraded_counter_data, now);
+
+    if (is_approximately_zero(current_decremented_value, CLOSE_ENOUGH_TO_ZERO)) { // The counter value is at zero so we're going to get rid of it
+        DEGRADING_COUNTER_LOG_DEBUG(ctx, "Key %s is approximately zero. Queueing it for deletion.", RedisModule_StringPtrLen(RedisModule_GetKeyNameFromModuleKey(key), NULL));
+        degrading_counter_queue_delete(ctx, key);
+    }
+
+    return current_decremented_value;
+}
+
+// Increment counter (DC.INCR): Create counter if it doesn't exist increment by specified amount of values if it does.
+//                    Gonna set the rest of the properties.
+
+// DC.INCR test_counter AMOUNT 1 DEGRADE_RATE 1.0 INTERVAL 5sec
+// DC.INCR test_counter 1 [PROFILE hot]
+int degrading_counter_increment_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.INCR) degrading_counter_increment_RedisCommand");
+    RedisModule_AutoMemory(ctx); // Enable the use of automatic memory management.
+
+    // Read the clock once, so everything this command does to its counters happens at the same instant.
+    const ustime_t now = degrading_counter_now();
+
+    // Three name/value pairs are required (`AMOUNT` plus either `DEGRADE_RATE` and `INTERVAL`, or `DECAY EXP` and
+    // `HALFLIFE`), `DECAY LINEAR` may be passed explicitly. Plus two more for the command name and key name. The short
+    // form is just the amount, optionally followed by `PROFILE name`.
+    if (argc != 3 && argc != 5 && argc != 8 && argc != 10) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    // Get the key from the argument list.
+    RedisModuleString *key_name = argv[1];
+
+    // Get a reference to the actual Redis key handle.
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+
+    // Get the key type, this will tell us if the key we are working with is already set or not.
+    const int key_type = RedisModule_KeyType(key);
+
+    // Let's make sure we're dealing with the correct kind of key first.
+    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+        // The wrong type of key was specified so we're bailing out with a wrong type error message.
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    if (argc <= 5) {
+        return degrading_counter_increment_short_form(ctx, argv, argc, key, key_type, now);
+    }
+
+    // Next, if possible, let's parse the args passed into the Redis command and see what we have.
+    DegradingCounterData *degrading_counter_data = get_degrading_counter_data_from_redis_arguments(ctx, argv, argc);
+
+    // If `degrading_counter_data` is NULL here, there was an error parsing the values and we should just bail out.
+    if (degrading_counter_data == NULL) {
+        // All we have to do is return an error here, the error has already been sent to the caller.
+        return REDISMODULE_ERR;
+    }
+
+    RedisModule_ReplyWithDouble(ctx, degrading_counter_apply_increment(ctx, key, key_type, degrading_counter_data, now));
+
+    // Send the counter's new state on to secondaries and the AOF file...
+    degrading_counter_replicate_state(ctx, key_name, RedisModule_ModuleTypeGetValue(key), now);
+    degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.incr", key_name);
+    watch_counter_changed(ctx, key_name, RedisModule_ModuleTypeGetValue(key));
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.INCR) degrading_counter_increment_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// Increment many counters (DC.MINCR): The same as DC.INCR but accepts any number of `key AMOUNT x DEGRADE_RATE y INTERVAL z`
+// groups and replies with an array containing the result for each key in the order they were provided.
+// DC.MINCR counter_a AMOUNT 1 DEGRADE_RATE 1.0 INTERVAL 5sec counter_b AMOUNT 2 DEGRADE_RATE 0.5 INTERVAL 1min
+int degrading_counter_multi_increment_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.MINCR) degrading_counter_multi_increment_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    const ustime_t now = degrading_counter_now();
+
+    // Every key takes up seven arguments, the key name plus three name/value pairs.
+    if (argc < 8 || (argc - 1) % 7 != 0) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    const int number_of_keys = (argc - 1) / 7;
+
+    // Parse everything up front so that a bad argument anywhere in the batch fails the whole command before any key is
+    // touched. The array itself is released by Redis when the command returns.
+    DegradingCounterData **parsed_counters = RedisModule_PoolAlloc(ctx, sizeof(DegradingCounterData*) * number_of_keys);
+
+    for (int i = 0; i < number_of_keys; i++) {
+        // Offsetting `argv` lets the single key parser see the group exactly as it would see a DC.INCR call.
+        parsed_counters[i] = get_degrading_counter_data_from_redis_arguments(ctx, argv + (i * 7), 8);
+
+        if (parsed_counters[i] == NULL) {
+            // The error has already been sent to the caller, we just need to clean up what we've parsed so far.
+            for (int j = 0; j < i; j++) {
+                degrading_counter_free(parsed_counters[j]);
+            }
+
+            return REDISMODULE_ERR;
+        }
+    }
+
+    RedisModule_ReplyWithArray(ctx, number_of_keys);
+
+    for (int i = 0; i < number_of_keys; i++) {
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1 + (i * 7)], REDISMODULE_READ|REDISMODULE_WRITE);
+        const int key_type = RedisModule_KeyType(key);
+
+        // A key of the wrong type only fails its own slot in the reply, the rest of the batch still gets applied.
+        if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
+            RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+            degrading_counter_free(parsed_counters[i]);
+            RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        } else {
+            RedisModule_ReplyWithDouble(ctx, degrading_counter_apply_increment(ctx, key, key_type, parsed_counters[i], now));
+            degrading_counter_replicate_state(ctx, argv[1 + (i * 7)], RedisModule_ModuleTypeGetValue(key), now);
+            degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.incr", argv[1 + (i * 7)]);
+            watch_counter_changed(ctx, argv[1 + (i * 7)], RedisModule_ModuleTypeGetValue(key));
+        }
+
+        // We can have thousands of keys in a batch, don't hold on to the handles until auto memory gets around to them.
+        RedisModule_CloseKey(key);
+    }
+
+    // Redis wraps everything a command replicates in a MULTI/EXEC, so replicas and the AOF still apply the batch atomically.
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.MINCR) degrading_counter_multi_increment_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// Milliseconds until the counter is at or below `limit - cost`, so that a DC.ALLOW with the same cost would go through.
+// 0 if it already is, -1 if it never will.
+static long long degrading_counter_allow_retry_after(const DegradingCounterData *counter, const double level, const double cost, const double limit, const ustime_t now) {
+    if (cost > limit) {
+        return -1;
+    }
+
+    const double target = limit - cost;
+
+    if (counter == NULL || level <= target) {
+        return 0;
+    }
+
+    // "At or below" is "below the next double up". Counters below CLOSE_ENOUGH_TO_ZERO read as gone, which matters for
+    // exponential decay, it would never actually get under a target of zero.
+    const mstime_t allowed_at = degrading_counter_compute_crossing_time(counter, fmax(nextafter(target, INFINITY), CLOSE_ENOUGH_TO_ZERO));
+
+    if (allowed_at == REDISMODULE_NO_EXPIRE) {
+        return -1;
+    }
+
+    const mstime_t now_ms = degrading_counter_to_milliseconds(now);
+
+    return allowed_at > now_ms ? allowed_at - now_ms : 0;
+}
+
+// Rate limit check (DC.ALLOW): adds COST to the counter only if that keeps it at or below LIMIT, all in one command so
+// there's no race between looking and incrementing. The counter's configuration is only needed (and only parsed) when
+// the key doesn't exist yet, an existing counter keeps its own. Replies with whether the cost was applied, the counter's
+// level afterwards and how many milliseconds until a call with the same cost would be allowed (0 if it would be now, -1
+// if never).
+// DC.ALLOW api:user:42 COST 1 LIMIT 100 DEGRADE_RATE 10 INTERVAL 1sec
+// DC.ALLOW api:user:42 COST 1 LIMIT 100 PROFILE api
+int degrading_counter_allow_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.ALLOW) degrading_counter_allow_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    const ustime_t now = degrading_counter_now();
+
+    // COST and LIMIT, then nothing, `PROFILE name` or the two or three pairs DC.PROFILE SET takes.
+    if (argc != 6 && argc != 8 && argc != 10 && argc != 12) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    double cost;
+    double limit;
+
+    if (strcmp(RedisModule_StringPtrLen(argv[2], NULL), "COST") != 0 ||
+        strcmp(RedisModule_StringPtrLen(argv[4], NULL), "LIMIT") != 0) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR syntax error, expected DC.ALLOW key COST <cost> LIMIT <limit> .... (Remember argument names are case sensitive.)");
+    }
+
+    if (RedisModule_StringToDouble(argv[3], &cost) != REDISMODULE_OK || cost < 0) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR invalid value for COST: must be a non-negative double.");
+    }
+
+    if (RedisModule_StringToDouble(argv[5], &limit) != REDISMODULE_OK) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR invalid value for LIMIT: must be a signed double.");
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ|REDISMODULE_WRITE);
+    const int key_type = RedisModule_KeyType(key);
+
+    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    DegradingCounterData *degrading_counter_data = key_type == REDISMODULE_KEYTYPE_EMPTY ? NULL : RedisModule_ModuleTypeGetValue(key);
+    double level = degrading_counter_data == NULL ? 0 : degrading_counter_compute_value(ctx, degrading_counter_data, now);
+    const int is_allowed = level + cost <= limit;
+
+    if (is_allowed) {
+        if (degrading_counter_data != NULL) {
+            level = degrading_counter_add(ctx, key, degrading_counter_data, cost, now);
+        } else {
+            if (argc == 6) {
+                return RedisModule_ReplyWithError(ctx, "ERR the counter doesn't exist, pass its configuration (or a PROFILE) to create it.");
+            }
+
+            if (argc == 8 && strcmp(RedisModule_StringPtrLen(argv[6], NULL), "PROFILE") == 0) {
+                uint64_t profile_id;
+
+                if (degrading_counter_find_profile(argv[7], &profile_id) != 0) {
+                    return RedisModule_ReplyWithErrorFormat(ctx, "ERR no such profile: %s.", RedisModule_StringPtrLen(argv[7], NULL));
+                }
+
+                degrading_counter_data = degrading_counter_create_from_profile(profile_id, cost, now);
+            } else {
+                // Offsetting `argv` lines the pairs up with where the parser expects them, the same as DC.PROFILE SET.
+                degrading_counter_data = degrading_counter_parse_arguments(ctx, argv + 4, argc - 4, 0);
+
+                if (degrading_counter_data == NULL) {
+                    return REDISMODULE_ERR;
+                }
+
+                degrading_counter_data->value = cost;
+                degrading_counter_set_created(degrading_counter_data, now);
+            }
+
+            RedisModule_ModuleTypeSetValue(key, DegradingCounter, degrading_counter_data);
+            degrading_counter_update_expire(key, degrading_counter_data);
+
+            level = cost;
+        }
+
+        degrading_counter_replicate_state(ctx, argv[1], degrading_counter_data, now);
+        degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.allow", argv[1]);
+        watch_counter_changed(ctx, argv[1], degrading_counter_data);
+    }
+
+    RedisModule_ReplyWithArray(ctx, 3);
+    RedisModule_ReplyWithLongLong(ctx, is_allowed);
+    RedisModule_ReplyWithDouble(ctx, level);
+    RedisModule_ReplyWithLongLong(ctx, degrading_counter_allow_retry_after(degrading_counter_data, level, cost, limit, now));
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.ALLOW) degrading_counter_allow_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// Decrement counter (DC.DECR): Provide a way for a user to decrement a counter.
+// DC.DECR test_counter 1
+int degrading_counter_decrement_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.DECR) degrading_counter_decrement_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    const ustime_t now = degrading_counter_now();
+
+    if (argc > 3) { // 1 optional user supplied argument, plus the command name and the key name.
+        return RedisModule_WrongArity(ctx);
+    }
+
+    // Get the key from the argument list.
+    RedisModuleString *key_name = argv[1];
+
+    // Get a reference to the actual Redis key handle.
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+
+    // Get the key type, this will tell us if the key we are working with is already set or not.
+    const int key_type = RedisModule_KeyType(key);
+
+    // Make sure that we're dealing with the correct kind key here.
+    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+        // The wrong type of key was specified so we're bailing out with a wrong type error message.
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    // Does the key even exist?
+    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    double decrement_amount;
 
     // If we have three arguments we're assuming that the user isn't using the default value.
     if (argc == 3) {
         if (RedisModule_StringToDouble(argv[2], &decrement_amount) != REDISMODULE_OK) {
             // We were passed a bad value, bail!
             RedisModule_ReplyWithError(ctx, "ERR invalid value for decrement: must be a number.");
+            stats_record_parse_error();
+            return REDISMODULE_ERR;
+        }
+    }
+    // We didn't get a third argument, so we're assuming that the user is using the default value.
+    else {
+        decrement_amount = 1;
+    }
+
+    // Let's go ahead and get the counter from memory.
+    DegradingCounterData *stored_degrading_counter_data = RedisModule_ModuleTypeGetValue(key);
+
+    const int is_exponential = stored_degrading_counter_data->decay == DecayExponential;
+
+    // Decrement the value, clamping at zero. Exponential counters are re-anchored at their current value first.
+    double decremented_final_value = is_exponential ?
+        fmax(0, degrading_counter_compute_value(ctx, stored_degrading_counter_data, now) - decrement_amount) :
+        fmax(0, stored_degrading_counter_data->value - decrement_amount);
+
+    // If decremented_final_value is 0, we're deleting the key.
+    if (is_approximately_zero(decremented_final_value, CLOSE_ENOUGH_TO_ZERO)) {
+        RedisModule_UnlinkKey(key); // The value can't degrade anymore so we'll remove it.
+        RedisModule_Replicate(ctx, "UNLINK", "s", key_name);
+        // The watches hear about it first, the "del" that follows would otherwise drop them without publishing.
+        watch_counter_changed(ctx, key_name, NULL);
+        degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.decr", key_name);
+        RedisModule_NotifyKeyspaceEvent(ctx, REDISMODULE_NOTIFY_GENERIC, "del", key_name);
+    }
+    // Otherwise we update the value in memory.
+    else {
+        // Update the stored value, which also moves the time at which the counter will hit zero.
+        stored_degrading_counter_data->value = decremented_final_value;
+
+        if (is_exponential) {
+            degrading_counter_set_created(stored_degrading_counter_data, now);
+        }
+
+        degrading_counter_update_expire(key, stored_degrading_counter_data);
+
+        // We've decremented the value, now we have to compute.
+        decremented_final_value = degrading_counter_compute_value(ctx, stored_degrading_counter_data, now);
+
+        // Send the counter's new state on to secondaries and the AOF file...
+        degrading_counter_replicate_state(ctx, key_name, stored_degrading_counter_data, now);
+        degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.decr", key_name);
+        watch_counter_changed(ctx, key_name, stored_degrading_counter_data);
+    }
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.DECR) degrading_counter_decrement_RedisCommand");
+
+    return RedisModule_ReplyWithDouble(ctx, decremented_final_value);
+}
+
+// Peek counter (DC.PEEK): look at the current value of the counter without incrementing it.
+int degrading_counter_peek_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.PEEK) degrading_counter_peek_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    const ustime_t now = degrading_counter_now();
+
+    if (argc != 2) { // We need a command name, obviously, but we also need a key name.
+        return RedisModule_WrongArity(ctx);
+    }
+
+    // Get the key from the argument list.
+    RedisModuleString *key_name = argv[1];
+
+    // Get a reference to the actual Redis key handle. We only ever read it, so replicas can serve DC.PEEK too.
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ);
+
+    // Get the key type, this will let us know if we're dealing with an empty or invalid key.
+    const int key_type = RedisModule_KeyType(key);
+
+    // Make sure the key is valid...
+    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+        // Wrong kind of key, let's bail and tell the user about it.
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    // Does the key even exist?
+    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    // We've made it this far, I guess we can assume that the key is valid and that we can proceed.
+    const double current_decremented_value = degrading_counter_peek_value(ctx, key, now);
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.PEEK) degrading_counter_peek_RedisCommand");
+
+    return RedisModule_ReplyWithDouble(ctx, current_decremented_value);
+}
+
+// Peek many counters (DC.MPEEK): look at the current value of several counters at once. Replies with an array holding
+// the value of each key, null for keys that don't exist or an error for keys of the wrong type.
+int degrading_counter_multi_peek_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.MPEEK) degrading_counter_multi_peek_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    const ustime_t now = degrading_counter_now();
+
+    if (argc < 2) { // The command name plus at least one key name.
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModule_ReplyWithArray(ctx, argc - 1);
+
+    for (int i = 1; i < argc; i++) {
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[i], REDISMODULE_READ);
+        const int key_type = RedisModule_KeyType(key);
+
+        if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
+            RedisModule_ReplyWithNull(ctx);
+        } else if (RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+            RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        } else {
+            RedisModule_ReplyWithDouble(ctx, degrading_counter_peek_value(ctx, key, now));
+        }
+
+        RedisModule_CloseKey(key);
+    }
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.MPEEK) degrading_counter_multi_peek_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// Reply with the raw parameters of a counter, everything a client needs to compute its value itself.
+static void degrading_counter_reply_with_description(RedisModuleCtx *ctx, const DegradingCounterData *counter) {
+    const DegradingCounterData *config = degrading_counter_config(counter);
+    const int is_exponential = counter->decay == DecayExponential;
+
+    // Microsecond counters are described in microseconds (`CREATED_US`, `INTERVAL_US`, `HALFLIFE_US`), anything else
+    // keeps the millisecond fields, a sub-millisecond interval wouldn't survive being rounded to one.
+    const int is_microseconds = degrading_counter_has_microseconds(counter);
+    const long long created = degrading_counter_get_created(counter);
+    const long long interval = degrading_counter_interval_in_microseconds(counter);
+
+    RedisModule_ReplyWithArray(ctx, is_exponential ? 8 : 10);
+    RedisModule_ReplyWithSimpleString(ctx, "VALUE");
+    RedisModule_ReplyWithDouble(ctx, counter->value);
+    RedisModule_ReplyWithSimpleString(ctx, is_microseconds ? "CREATED_US" : "CREATED");
+    RedisModule_ReplyWithLongLong(ctx, is_microseconds ? created : created / MICROSECONDS_PER_MILLISECOND);
+    RedisModule_ReplyWithSimpleString(ctx, "DECAY");
+
+    if (is_exponential) {
+        RedisModule_ReplyWithSimpleString(ctx, EXPONENTIAL_DECAY_NAME);
+        RedisModule_ReplyWithSimpleString(ctx, is_microseconds ? "HALFLIFE_US" : "HALFLIFE_MS");
+    } else {
+        RedisModule_ReplyWithSimpleString(ctx, LINEAR_DECAY_NAME);
+        RedisModule_ReplyWithSimpleString(ctx, "DEGRADE_RATE");
+        RedisModule_ReplyWithDouble(ctx, config->degrades_at);
+        RedisModule_ReplyWithSimpleString(ctx, is_microseconds ? "INTERVAL_US" : "INTERVAL_MS");
+    }
+
+    RedisModule_ReplyWithLongLong(ctx, is_microseconds ? interval : interval / MICROSECONDS_PER_MILLISECOND);
+}
+
+// Describe counters (DC.DESCRIBE): reply with the stored value, creation time and decay parameters of each key, so a
+// client can cache the counter and work out its value locally until the key is modified. Keys that don't exist get a
+// null, keys of the wrong type a `WRONGTYPE` error.
+// DC.DESCRIBE counter_a counter_b
+int degrading_counter_describe_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 2) { // The command name plus at least one key name.
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModule_ReplyWithArray(ctx, argc - 1);
+
+    for (int i = 1; i < argc; i++) {
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[i], REDISMODULE_READ);
+        const int key_type = RedisModule_KeyType(key);
+
+        if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
+            RedisModule_ReplyWithNull(ctx);
+        } else if (RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+            RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        } else {
+            degrading_counter_reply_with_description(ctx, RedisModule_ModuleTypeGetValue(key));
+        }
+
+        RedisModule_CloseKey(key);
+    }
+
+    return REDISMODULE_OK;
+}
+
+// Define a profile (DC.PROFILE SET): takes the same pairs as DC.INCR, minus `AMOUNT`. Setting a profile that already
+// exists is fine as long as the configuration is the same, which keeps setup scripts (and AOF replays) idempotent.
+// DC.PROFILE SET hot DEGRADE_RATE 1 INTERVAL 5sec
+int degrading_counter_profile_set_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    // Two or three name/value pairs, plus the command, subcommand and profile name.
+    if (argc != 7 && argc != 9) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    // Offsetting `argv` lines the pairs up with where the parser expects them, right after the profile name.
+    DegradingCounterData *config = degrading_counter_parse_arguments(ctx, argv + 1, argc - 1, 0);
+
+    if (config == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    uint64_t profile_id;
+    const int result = degrading_counter_define_profile(ctx, argv[2], config, &profile_id);
+
+    degrading_counter_free(config);
+
+    if (result != 0) {
+        return REDISMODULE_ERR;
+    }
+
+    RedisModule_ReplicateVerbatim(ctx);
+
+    return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+// Look at a profile (DC.PROFILE GET): replies with the pairs it was defined with, or null if there's no such profile.
+// DC.PROFILE GET hot
+int degrading_counter_profile_get_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc != 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    uint64_t profile_id;
+
+    if (degrading_counter_find_profile(argv[2], &profile_id) != 0) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    const DegradingCounterData *config = &Profiles[profile_id].config;
+    char interval_string[32];
+
+    degrading_counter_format_interval(config, interval_string, sizeof(interval_string));
+
+    if (config->decay == DecayExponential) {
+        RedisModule_ReplyWithArray(ctx, 4);
+        RedisModule_ReplyWithSimpleString(ctx, "DECAY");
+        RedisModule_ReplyWithSimpleString(ctx, EXPONENTIAL_DECAY_NAME);
+        RedisModule_ReplyWithSimpleString(ctx, "HALFLIFE");
+        RedisModule_ReplyWithSimpleString(ctx, interval_string);
+    } else {
+        RedisModule_ReplyWithArray(ctx, 6);
+        RedisModule_ReplyWithSimpleString(ctx, "DECAY");
+        RedisModule_ReplyWithSimpleString(ctx, LINEAR_DECAY_NAME);
+        RedisModule_ReplyWithSimpleString(ctx, "DEGRADE_RATE");
+        RedisModule_ReplyWithDouble(ctx, config->degrades_at);
+        RedisModule_ReplyWithSimpleString(ctx, "INTERVAL");
+        RedisModule_ReplyWithSimpleString(ctx, interval_string);
+    }
+
+    return REDISMODULE_OK;
+}
+
+// DC.RESTORE key <record> [PROFILE name <profile record>]
+//
+// Emitted by the AOF rewrite, and replicated in place of every command that changes a counter (see
+// `degrading_counter_replicate_state`). It recreates a counter exactly as it was, creation time included, from the
+// same packed record the RDB file uses (see `degrading_counter_pack`). Profile ids depend on the order profiles were
+// created in, so a counter created from a profile names it instead and brings the profile's own packed configuration
+// along in case it doesn't exist yet.
+int degrading_counter_restore_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 3 && argc != 6) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    size_t packed_len;
+    const char *packed = RedisModule_StringPtrLen(argv[2], &packed_len);
+    DegradingCounterData unpacked;
+
+    if (degrading_counter_unpack((const unsigned char *)packed, packed_len, NULL, &unpacked) != 0 ||
+        (unpacked.increment == DEGRADING_COUNTER_PROFILED) != (argc == 6)) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid counter payload.");
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ|REDISMODULE_WRITE);
+
+    if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    if (argc == 6) {
+        size_t packed_profile_len;
+        const char *packed_profile = RedisModule_StringPtrLen(argv[5], &packed_profile_len);
+        DegradingCounterData config;
+        uint64_t profile_id;
+
+        if (strcmp(RedisModule_StringPtrLen(argv[3], NULL), "PROFILE") != 0 ||
+            degrading_counter_unpack((const unsigned char *)packed_profile, packed_profile_len, NULL, &config) != 0 ||
+            config.increment == DEGRADING_COUNTER_PROFILED) {
+            return RedisModule_ReplyWithError(ctx, "ERR invalid counter payload.");
+        }
+
+        if (degrading_counter_define_profile(ctx, argv[4], &config, &profile_id) != 0) {
+            return REDISMODULE_ERR;
+        }
+
+        unpacked.number_of_increments = profile_id;
+    }
+
+    DegradingCounterData *degrading_counter_data = degrading_counter_copy(&unpacked);
+
+    RedisModule_ModuleTypeSetValue(key, DegradingCounter, degrading_counter_data);
+    degrading_counter_update_expire(key, degrading_counter_data);
+
+    RedisModule_ReplicateVerbatim(ctx);
+    degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.restore", argv[1]);
+    watch_counter_changed(ctx, argv[1], degrading_counter_data);
+
+    return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_increment_RedisCommand, StatsIncrement)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_decrement_RedisCommand, StatsDecrement)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_peek_RedisCommand, StatsPeek)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_multi_increment_RedisCommand, StatsMultiIncrement)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_multi_peek_RedisCommand, StatsMultiPeek)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_describe_RedisCommand, StatsDescribe)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_allow_RedisCommand, StatsAllow)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_profile_set_RedisCommand, StatsProfile)
+DEGRADING_COUNTER_TIMED_COMMAND(degrading_counter_profile_get_RedisCommand, StatsProfile)
+
+// ------- Export / Import
+
+void degrading_counter_get_fields(const DegradingCounterData *counter, DegradingCounterFields *fields) {
+    const DegradingCounterData *config = degrading_counter_config(counter);
+
+    fields->value = counter->value;
+    fields->degrades_at = config->degrades_at;
+    fields->created = degrading_counter_get_created(counter);
+    fields->number_of_increments = (uint32_t)config->number_of_increments;
+    fields->increment = (uint8_t)config->increment;
+    fields->decay = (uint8_t)counter->decay;
+}
+
+int degrading_counter_import(RedisModuleCtx *ctx, RedisModuleString *key_name, const DegradingCounterFields *fields, const ustime_t now) {
+    // The fields come from a file, so they get the same checks as an unpacked record before they become a counter.
+    if (fields->increment > Days || fields->increment == DEGRADING_COUNTER_PROFILED ||
+        fields->number_of_increments == 0 || fields->number_of_increments > DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS ||
+        (fields->decay != DecayLinear && fields->decay != DecayExponential) ||
+        !isfinite(fields->value) || !isfinite(fields->degrades_at)) {
+        return -1;
+    }
+
+    DegradingCounterData imported = {0};
+
+    imported.value = fields->value;
+    imported.degrades_at = fields->degrades_at;
+    imported.number_of_increments = fields->number_of_increments;
+    imported.increment = fields->increment;
+    imported.decay = fields->decay;
+    degrading_counter_set_created(&imported, fields->created);
+
+    if (is_approximately_zero(degrading_counter_compute_value(ctx, &imported, now), CLOSE_ENOUGH_TO_ZERO)) {
+        return 0;
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+
+    // Whatever is already there is newer than the file, so it's left alone.
+    if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
+        return 0;
+    }
+
+    DegradingCounterData *degrading_counter_data = degrading_counter_copy(&imported);
+
+    RedisModule_ModuleTypeSetValue(key, DegradingCounter, degrading_counter_data);
+    degrading_counter_update_expire(key, degrading_counter_data);
+    RedisModule_CloseKey(key);
+
+    // The file only exists on this node, replicas and the AOF get the counter itself.
+    degrading_counter_replicate_state(ctx, key_name, degrading_counter_data, now);
+    degrading_counter_notify(ctx, REDISMODULE_NOTIFY_MODULE, "dc.restore", key_name);
+    watch_counter_changed(ctx, key_name, degrading_counter_data);
+
+    return 1;
+}
+
+// ------- Background Sweeper
+
+// Counters created before we started setting expires (including ones loaded from an older RDB file) would otherwise
+// live forever if nobody peeks them. When enabled, the sweeper walks the keyspace a batch at a time and gives every
+// counter it finds without an expire one, deleting those that have already reached zero. Once it has made it through
+// every database it stops, new counters always get an expire.
+
+typedef struct DegradingCounterSweepBatch {
+    RedisModuleString **key_names;
+    size_t count;
+    size_t capacity;
+    long long visited;
+} DegradingCounterSweepBatch;
+
+// Provided as the `RedisModule_Scan` callback. Keys can't be modified from within the scan, so we just collect names.
+void degrading_counter_sweep_scan_callback(RedisModuleCtx *ctx, RedisModuleString *key_name, RedisModuleKey *key, void *privdata) {
+    DegradingCounterSweepBatch *batch = privdata;
+    batch->visited++;
+
+    if (key == NULL ||
+        RedisModule_ModuleTypeGetType(key) != DegradingCounter ||
+        RedisModule_GetExpire(key) != REDISMODULE_NO_EXPIRE) {
+        return;
+    }
+
+    if (batch->count == batch->capacity) {
+        batch->capacity = batch->capacity == 0 ? 64 : batch->capacity * 2;
+        batch->key_names = RedisModule_Realloc(batch->key_names, sizeof(RedisModuleString*) * batch->capacity);
+    }
+
+    batch->key_names[batch->count++] = RedisModule_CreateStringFromString(ctx, key_name);
+}
+
+// Give a single counter found by the scan its expire, or delete it if it has already degraded to zero.
+void degrading_counter_sweep_key(RedisModuleCtx *ctx, RedisModuleString *key_name) {
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+
+    // Things could have changed between the scan and now.
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY ||
+        RedisModule_ModuleTypeGetType(key) != DegradingCounter ||
+        RedisModule_GetExpire(key) != REDISMODULE_NO_EXPIRE) {
+        RedisModule_CloseKey(key);
+        return;
+    }
+
+    const DegradingCounterData *counter = RedisModule_ModuleTypeGetValue(key);
+
+    // Writes made from a timer aren't propagated on their own, so we replicate explicit commands.
+    if (is_approximately_zero(degrading_counter_compute_value(ctx, counter, degrading_counter_clock()), CLOSE_ENOUGH_TO_ZERO)) {
+        RedisModule_DeleteKey(key);
+        RedisModule_Replicate(ctx, "DEL", "s", key_name);
+        stats_record_lazy_deletion();
+    } else {
+        const mstime_t zero_time = degrading_counter_compute_zero_time(counter);
+
+        if (zero_time != REDISMODULE_NO_EXPIRE) {
+            RedisModule_SetAbsExpire(key, zero_time);
+            RedisModule_Replicate(ctx, "PEXPIREAT", "sl", key_name, zero_time);
+        }
+    }
+
+    RedisModule_CloseKey(key);
+}
+
+// Provided as the timer callback that drives the sweeper. Each call looks at up to `batch_size` keys and then schedules
+// the next sweep.
+void degrading_counter_sweep_timer_callback(RedisModuleCtx *ctx, void *data) {
+    // Replicas get their deletes and expires from the primary.
+    if (!(RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_MASTER)) {
+        RedisModule_CreateTimer(ctx, SweepState.interval, degrading_counter_sweep_timer_callback, NULL);
+        return;
+    }
+
+    if (RedisModule_SelectDb(ctx, SweepState.db) != REDISMODULE_OK) {
+        // We've walked off the end of the configured databases, the sweep is done.
+        RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_NOTICE, "Degrading counter sweep finished.");
+        RedisModule_ScanCursorDestroy(SweepState.cursor);
+        SweepState.cursor = NULL;
+        return;
+    }
+
+    DegradingCounterSweepBatch batch = { .key_names = NULL, .count = 0, .capacity = 0, .visited = 0 };
+    int more_to_scan = 1;
+
+    while (more_to_scan && batch.visited < SweepState.batch_size) {
+        more_to_scan = RedisModule_Scan(ctx, SweepState.cursor, degrading_counter_sweep_scan_callback, &batch);
+    }
+
+    for (size_t i = 0; i < batch.count; i++) {
+        degrading_counter_sweep_key(ctx, batch.key_names[i]);
+        RedisModule_FreeString(ctx, batch.key_names[i]);
+    }
+
+    RedisModule_Free(batch.key_names);
+
+    // This database is done, move on to the next one.
+    if (!more_to_scan) {
+        RedisModule_ScanCursorRestart(SweepState.cursor);
+        SweepState.db++;
+    }
+
+    RedisModule_CreateTimer(ctx, SweepState.interval, degrading_counter_sweep_timer_callback, NULL);
+}
+
+// Parse the module arguments passed to `MODULE LOAD` / `loadmodule`, e.g. `SWEEP_INTERVAL 100 SWEEP_BATCH 1000`.
+int degrading_counter_parse_module_arguments(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    if (argc % 2 != 0) {
+        RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_WARNING, "Module arguments must be provided in name/value pairs.");
+        return REDISMODULE_ERR;
+    }
+
+    for (int i = 0; i < argc; i += 2) {
+        size_t arg_len;
+        const char *arg_name = RedisModule_StringPtrLen(argv[i], &arg_len);
+        long long arg_value;
+
+        if (RedisModule_StringToLongLong(argv[i + 1], &arg_value) != REDISMODULE_OK || arg_value < 0) {
+            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_WARNING, "Invalid value for %s: must be a non-negative integer.", arg_name);
+            return REDISMODULE_ERR;
+        }
+
+        if (strcmp(arg_name, "SWEEP_INTERVAL") == 0) {
+            SweepState.interval = arg_value;
+        } else if (strcmp(arg_name, "SWEEP_BATCH") == 0) {
+            if (arg_value == 0) {
+                RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_WARNING, "Invalid value for SWEEP_BATCH: must be greater than zero.");
+                return REDISMODULE_ERR;
+            }
+
+            SweepState.batch_size = arg_value;
+        } else {
+            RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_WARNING, "Unexpected module argument: %s.", arg_name);
             return REDISMODULE_ERR;
         }
     }
-    // We didn't get a third argument, so we're assuming that the user is using the default value.
-    else {
-        decrement_amount = 1;
+
+    return REDISMODULE_OK;
+}
+
+// ------- INFO
+
+// Provided as the `INFO` callback for the module.
+void degrading_counter_info(RedisModuleInfoCtx *ctx, int for_crash_report) {
+    // If we crashed while holding the pool's lock, asking it for a count would hang the crash report.
+    if (for_crash_report) {
+        stats_add_info(ctx, 0, 0);
+        return;
     }
 
-    // Let's go ahead and get the counter from memory.
-    DegradingCounterData *stored_degrading_counter_data = RedisModule_ModuleTypeGetValue(key);
+    stats_add_info(ctx, pool_objects_in_use(DegradingCounterPool) + pool_objects_in_use(ProfiledCounterPool) +
+                        pool_objects_in_use(MicrosecondCounterPool),
+                   pool_allocated_bytes(DegradingCounterPool) + pool_allocated_bytes(ProfiledCounterPool) +
+                        pool_allocated_bytes(MicrosecondCounterPool));
+}
 
-    // Decrement the value, clamping at zero.
-    double decremented_final_value = fmax(0, stored_degrading_counter_data->value - decrement_amount);
+// ------- Native Type Callbacks.
 
-    // If decremented_final_value is 0, we're deleting the key.
-    if (is_approximately_zero(decremented_final_value, CLOSE_ENOUGH_TO_ZERO)) {
-        RedisModule_UnlinkKey(key); // The value can't degrade anymore so we'll remove it.
+// Flags making up the first byte of a packed counter. The low two bits are the unit (or DEGRADING_COUNTER_PROFILED), the
+// top bit is the unit's third bit, which version 4 added for the microsecond, hour and day units.
+#define PACKED_UNIT_MASK 0x03
+#define PACKED_UNIT_HIGH_BIT (1 << 7)
+#define PACKED_EXPONENTIAL (1 << 2) // The counter decays exponentially.
+#define PACKED_AT_ZERO (1 << 3) // The counter had already reached zero, its value and creation time were left out.
+#define PACKED_RELATIVE_CREATED (1 << 4) // The creation time is a zigzag varint relative to the save's epoch.
+#define PACKED_INTEGER_VALUE (1 << 5) // The value is a varint rather than a double.
+#define PACKED_INTEGER_RATE (1 << 6) // The rate is a varint rather than a double.
+
+// Whole numbers below this fit in a varint of at most 7 bytes, anything else is cheaper as a raw double.
+#define PACKED_MAX_INTEGER 562949953421312.0 // 2^49
+
+static size_t degrading_counter_pack_varint(unsigned char *out, uint64_t value) {
+    size_t len = 0;
+
+    while (value >= 0x80) {
+        out[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
     }
-    // Otherwise we update the value in memory.
-    else {
-        // Update the stored value.
-        stored_degrading_counter_data->value = decremented_final_value;
 
-        // We've decremented the value, now we have to compute.
-        decremented_final_value = degrading_counter_compute_value(ctx, stored_degrading_counter_data);
+    out[len++] = (unsigned char)value;
+
+    return len;
+}
+
+// Returns the number of bytes read, or 0 if the varint runs past `end` or is too long to be one of ours.
+static size_t degrading_counter_unpack_varint(const unsigned char *in, const unsigned char *end, uint64_t *value) {
+    *value = 0;
+
+    for (size_t i = 0; i < 10 && in + i < end; i++) {
+        *value |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+
+        if ((in[i] & 0x80) == 0) {
+            return i + 1;
+        }
     }
 
-    // Mark the key ready to replicate to secondaries or to an AOF file...
-    RedisModule_ReplicateVerbatim(ctx);
+    return 0;
+}
 
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Finishing] (DC.DECR) degrading_counter_decrement_RedisCommand");
+// Doubles are written little-endian whatever the host, so files move between machines.
+static size_t degrading_counter_pack_double(unsigned char *out, const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
 
-    return RedisModule_ReplyWithDouble(ctx, decremented_final_value);
+    for (size_t i = 0; i < sizeof(bits); i++) {
+        out[i] = (unsigned char)(bits >> (8 * i));
+    }
+
+    return sizeof(bits);
 }
 
-// Peek counter (DC.PEEK): look at the current value of the counter without incrementing it.
-int degrading_counter_peek_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Starting] (DC.PEEK) degrading_counter_peek_RedisCommand");
-    RedisModule_AutoMemory(ctx);
+static size_t degrading_counter_unpack_double(const unsigned char *in, const unsigned char *end, double *value) {
+    uint64_t bits = 0;
 
-    if (argc != 2) { // We need a command name, obviously, but we also need a key name.
-        return RedisModule_WrongArity(ctx);
+    if (end - in < (ptrdiff_t)sizeof(bits)) {
+        return 0;
     }
 
-    // Get the key from the argument list.
-    RedisModuleString *key_name = argv[1];
+    for (size_t i = 0; i < sizeof(bits); i++) {
+        bits |= (uint64_t)in[i] << (8 * i);
+    }
 
-    // Get a reference to the actual Redis key handle.
-    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ|REDISMODULE_WRITE);
+    memcpy(value, &bits, sizeof(bits));
 
-    // Get the key type, this will let us know if we're dealing with an empty or invalid key.
-    const int key_type = RedisModule_KeyType(key);
+    return sizeof(bits);
+}
 
-    // Make sure the key is valid...
-    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
-        RedisModule_ModuleTypeGetType(key) != DegradingCounter) {
-        // Wrong kind of key, let's bail and tell the user about it.
-        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+static int degrading_counter_is_packable_integer(const double value) {
+    return value >= 0 && value < PACKED_MAX_INTEGER && value == floor(value);
+}
+
+// Pack a counter into the version 3 record: a flags byte, the interval length (or profile id) as a varint, then the
+// creation time, value and rate, each in the smallest form that holds it exactly. Counters at zero leave out their value
+// and creation time, and the rate is left out whenever it can be worked out from the interval or profile. `epoch` is
+// the save's epoch, or NULL if there isn't one. Returns the number of bytes written, at most
+// DEGRADING_COUNTER_MAX_PACKED_SIZE.
+size_t degrading_counter_pack(const DegradingCounterData *counter, const mstime_t *epoch, const ustime_t now, unsigned char *out) {
+    const int is_profiled = counter->increment == DEGRADING_COUNTER_PROFILED;
+    const int is_exponential = counter->decay == DecayExponential;
+    const int is_at_zero = is_approximately_zero(degrading_counter_compute_value(NULL, counter, now), CLOSE_ENOUGH_TO_ZERO);
+    const int is_integer_value = degrading_counter_is_packable_integer(counter->value);
+    const int is_integer_rate = !is_profiled && !is_exponential && degrading_counter_is_packable_integer(counter->degrades_at);
+    size_t len = 1;
+
+    out[0] = (unsigned char)((counter->increment & PACKED_UNIT_MASK) |
+        (counter->increment > PACKED_UNIT_MASK ? PACKED_UNIT_HIGH_BIT : 0) |
+        (is_exponential ? PACKED_EXPONENTIAL : 0) |
+        (is_at_zero ? PACKED_AT_ZERO : 0) |
+        (!is_at_zero && epoch != NULL ? PACKED_RELATIVE_CREATED : 0) |
+        (!is_at_zero && is_integer_value ? PACKED_INTEGER_VALUE : 0) |
+        (is_integer_rate ? PACKED_INTEGER_RATE : 0));
+
+    len += degrading_counter_pack_varint(out + len, counter->number_of_increments);
+
+    if (!is_at_zero) {
+        // The creation time is in the counter's own precision, microseconds for microsecond counters and milliseconds
+        // for everything else.
+        const int64_t resolution = degrading_counter_has_microseconds(counter) ? 1 : MICROSECONDS_PER_MILLISECOND;
+
+        if (epoch != NULL) {
+            // Zigzag, counters created after the save started (there shouldn't be any, but clocks) come out negative.
+            const int64_t delta = (degrading_counter_get_created(counter) - *epoch * MICROSECONDS_PER_MILLISECOND) / resolution;
+            len += degrading_counter_pack_varint(out + len, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        } else {
+            const int64_t offset = degrading_counter_get_created(counter) - DEGRADING_COUNTER_EPOCH_MS * MICROSECONDS_PER_MILLISECOND;
+            len += degrading_counter_pack_varint(out + len, (uint64_t)(offset / resolution));
+        }
+
+        len += is_integer_value ?
+            degrading_counter_pack_varint(out + len, (uint64_t)counter->value) :
+            degrading_counter_pack_double(out + len, counter->value);
     }
 
-    // Does the key even exist?
-    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
-        return RedisModule_ReplyWithNull(ctx);
+    // Exponential counters store half-lives per millisecond, which is just one over the interval, and profiled counters
+    // get their rate from the profile.
+    if (!is_profiled && !is_exponential) {
+        len += is_integer_rate ?
+            degrading_counter_pack_varint(out + len, (uint64_t)counter->degrades_at) :
+            degrading_counter_pack_double(out + len, counter->degrades_at);
     }
 
-    // We've made it this far, I guess we can assume that the key is valid and that we can proceed.
-    DegradingCounterData *stored_degraded_counter_data = RedisModule_ModuleTypeGetValue(key);
+    return len;
+}
 
-    // Let's compute the current value of the counter.
-    const double current_decremented_value = degrading_counter_compute_value(ctx, stored_degraded_counter_data);
+// The reverse of `degrading_counter_pack`, into a full sized counter. Returns 0 on success, -1 if the record is
+// malformed or relative to an epoch we don't have.
+int degrading_counter_unpack(const unsigned char *in, const size_t in_len, const mstime_t *epoch, DegradingCounterData *counter) {
+    const unsigned char *end = in + in_len;
+    const unsigned char *position = in + 1;
+    uint64_t number_of_increments;
+    size_t read;
 
-    if (is_approximately_zero(current_decremented_value, CLOSE_ENOUGH_TO_ZERO)) { // The counter value is at zero so we're going to get rid of it
-        // TODO: Clean this up, I don't like that we're executing code regardless of whether we actually log a value.
-        size_t len;
+    if (in_len == 0) {
+        return -1;
+    }
+
+    const unsigned char flags = in[0];
 
-        RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "Key %s is approximately zero. Unlinking.", RedisModule_StringPtrLen(RedisModule_GetKeyNameFromModuleKey(key), &len));
-        const int unlink_result = RedisModule_UnlinkKey(key);
-        RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "Unlink result %d", unlink_result);
+    if ((flags & PACKED_RELATIVE_CREATED) && epoch == NULL) {
+        return -1;
     }
 
-    RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, "[Starting] (DC.PEEK) degrading_counter_peek_RedisCommand");
+    uint64_t increment = (flags & PACKED_UNIT_MASK) | (flags & PACKED_UNIT_HIGH_BIT ? PACKED_UNIT_MASK + 1 : 0);
 
-    return RedisModule_ReplyWithDouble(ctx, current_decremented_value);
+    if (increment > Days) {
+        return -1;
+    }
+
+    counter->decay = flags & PACKED_EXPONENTIAL ? DecayExponential : DecayLinear;
+
+    if ((read = degrading_counter_unpack_varint(position, end, &number_of_increments)) == 0 ||
+        (number_of_increments == 0 && increment != DEGRADING_COUNTER_PROFILED) ||
+        (increment == DEGRADING_COUNTER_PROFILED && number_of_increments > DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS) ||
+        degrading_counter_fit_interval(&number_of_increments, &increment) != 0) {
+        return -1;
+    }
+
+    counter->increment = increment;
+    counter->number_of_increments = number_of_increments;
+    counter->created_microseconds = 0;
+    position += read;
+
+    if (flags & PACKED_AT_ZERO) {
+        counter->value = 0;
+        counter->created_offset = 0;
+    } else {
+        const int64_t resolution = degrading_counter_has_microseconds(counter) ? 1 : MICROSECONDS_PER_MILLISECOND;
+        // Nothing we wrote is anywhere near this, it just keeps a corrupt record from overflowing.
+        const int64_t limit = (DEGRADING_COUNTER_MAX_CREATED_OFFSET + 1) * (MICROSECONDS_PER_MILLISECOND / resolution);
+        uint64_t created;
+
+        if ((read = degrading_counter_unpack_varint(position, end, &created)) == 0) {
+            return -1;
+        }
+
+        position += read;
+
+        if (flags & PACKED_RELATIVE_CREATED) {
+            int64_t delta = (int64_t)((created >> 1) ^ (~(created & 1) + 1));
+            delta = delta > limit ? limit : delta < -limit ? -limit : delta;
+            degrading_counter_set_created(counter, *epoch * MICROSECONDS_PER_MILLISECOND + delta * resolution);
+        } else {
+            degrading_counter_set_created(counter, DEGRADING_COUNTER_EPOCH_MS * MICROSECONDS_PER_MILLISECOND +
+                                                   (int64_t)(created > (uint64_t)limit ? (uint64_t)limit : created) * resolution);
+        }
+
+        if (flags & PACKED_INTEGER_VALUE) {
+            uint64_t value;
+            read = degrading_counter_unpack_varint(position, end, &value);
+            counter->value = (double)value;
+        } else {
+            read = degrading_counter_unpack_double(position, end, &counter->value);
+        }
+
+        if (read == 0) {
+            return -1;
+        }
+
+        position += read;
+    }
+
+    if (counter->increment == DEGRADING_COUNTER_PROFILED) {
+        counter->degrades_at = 0;
+    } else if (counter->decay == DecayExponential) {
+        counter->degrades_at = (double)MICROSECONDS_PER_MILLISECOND / (double)degrading_counter_interval_in_microseconds(counter);
+    } else {
+        if (flags & PACKED_INTEGER_RATE) {
+            uint64_t rate;
+            read = degrading_counter_unpack_varint(position, end, &rate);
+            counter->degrades_at = (double)rate;
+        } else {
+            read = degrading_counter_unpack_double(position, end, &counter->degrades_at);
+        }
+
+        if (read == 0) {
+            return -1;
+        }
+
+        position += read;
+    }
+
+    // A record that came in through DC.RESTORE gets no other check on its numbers, and nothing we write is ever NaN or
+    // infinite.
+    if (!isfinite(counter->value) || !isfinite(counter->degrades_at)) {
+        return -1;
+    }
+
+    return position == end ? 0 : -1;
 }
 
-// ------- Native Type Callbacks.
+// Version 3 counters are a single string holding the packed record.
+static void *degrading_counter_rdb_load_packed(RedisModuleIO *io) {
+    size_t packed_len;
+    char *packed = RedisModule_LoadStringBuffer(io, &packed_len);
+    DegradingCounterData unpacked;
+
+    if (packed == NULL) {
+        return NULL;
+    }
+
+    const int result = degrading_counter_unpack((const unsigned char *)packed, packed_len,
+                                                RdbLoadEpoch.is_set ? &RdbLoadEpoch.epoch : NULL, &unpacked);
+    RedisModule_Free(packed);
+
+    if (result != 0) {
+        return NULL;
+    }
+
+    // Profiles are loaded ahead of the keys (see `degrading_counter_aux_load`), so the profile has to be there.
+    if (unpacked.increment == DEGRADING_COUNTER_PROFILED && unpacked.number_of_increments >= ProfileCount) {
+        return NULL;
+    }
+
+    return degrading_counter_copy(&unpacked);
+}
 
 // Provided as the `rdb_load` callback for our data type.
 void *degrading_counter_rdb_load(RedisModuleIO *io, int encoding_version) {
-    // First we have to check if the encoding is the correct version.
-    if (encoding_version != DEGRADING_COUNTER_ENCODING_VERSION) {
+    // First we have to check if the encoding is a version we know about. Version 0 predates exponential decay.
+    if (encoding_version < 0 || encoding_version > DEGRADING_COUNTER_ENCODING_VERSION) {
         // TODO: Log an error here.
         return NULL;
     }
 
-    DegradingCounterData *degrading_counter = RedisModule_Alloc(sizeof(DegradingCounterData));
+    if (encoding_version >= 3) {
+        return degrading_counter_rdb_load_packed(io);
+    }
+
+    // Versions 0 to 2 wrote every field separately.
+
+    // The on-disk format still holds the absolute creation time and full width interval, we pack them once we know which
+    // kind of counter this is.
+    const int64_t created = RedisModule_LoadSigned(io);
+    const double degrades_at = RedisModule_LoadDouble(io);
+    const int64_t number_of_increments = RedisModule_LoadSigned(io);
+    const int64_t increment = RedisModule_LoadSigned(io);
+    const double value = RedisModule_LoadDouble(io);
+    const uint64_t decay = encoding_version >= 1 ? RedisModule_LoadUnsigned(io) : DecayLinear;
+
+    // These versions only had milliseconds, seconds and minutes.
+    if (increment < Milliseconds || increment > DEGRADING_COUNTER_PROFILED) {
+        return NULL;
+    }
+
+    DegradingCounterData *degrading_counter;
+
+    if (increment == DEGRADING_COUNTER_PROFILED) {
+        // Profiles are loaded ahead of the keys (see `degrading_counter_aux_load`), so the profile has to be there.
+        if (number_of_increments < 0 || (uint64_t)number_of_increments >= ProfileCount) {
+            return NULL;
+        }
+
+        degrading_counter = pool_alloc(ProfiledCounterPool);
+        degrading_counter->number_of_increments = (uint64_t)number_of_increments;
+        degrading_counter->increment = DEGRADING_COUNTER_PROFILED;
+    } else {
+        uint64_t length = number_of_increments < 1 ? 1 : (uint64_t)number_of_increments;
+        uint64_t unit = (uint64_t)increment;
+
+        degrading_counter = pool_alloc(DegradingCounterPool);
+        degrading_counter->degrades_at = degrades_at;
+
+        // Older versions accepted longer intervals than we can pack, those move up to a bigger unit. Anything still too
+        // long in days (thousands of years) gets clamped to the longest one we can hold.
+        if (degrading_counter_fit_interval(&length, &unit) != 0) {
+            length = DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS;
+        }
+
+        degrading_counter->number_of_increments = length;
+        degrading_counter->increment = unit;
+    }
 
-    degrading_counter->created = RedisModule_LoadSigned(io);
-    degrading_counter->degrades_at = RedisModule_LoadDouble(io);
-    degrading_counter->number_of_increments = (int)RedisModule_LoadSigned(io);
-    degrading_counter->increment = RedisModule_LoadSigned(io);
-    degrading_counter->value = RedisModule_LoadDouble(io);
+    degrading_counter_set_created(degrading_counter, created * MICROSECONDS_PER_MILLISECOND);
+    degrading_counter->value = value;
+    degrading_counter->decay = decay;
 
     return degrading_counter;
 }
 
-// Provided as the `rdb_save` callback for our data type.
+// Provided as the `rdb_save` callback for our data type. Every counter is written as one packed string, which (with the
+// string's own header) comes to somewhere between 5 and 28 bytes rather than the 34 or so the six separate fields of
+// version 2 took.
 void degrading_counter_rdb_save(RedisModuleIO *io, void *ptr) {
-    const DegradingCounterData *degrading_counter_data = ptr;
+    const DegradingCounterData *counter = ptr;
+    DegradingCounterData resolved;
+    unsigned char packed[DEGRADING_COUNTER_MAX_PACKED_SIZE];
+
+    // Outside a full save (DUMP, MIGRATE) no profiles are written ahead of the key, and the record is headed for a node
+    // that hands out its own profile ids. The counter goes out with its profile's configuration instead.
+    if (!RdbSaveEpoch.is_set && counter->increment == DEGRADING_COUNTER_PROFILED) {
+        degrading_counter_resolve_profile(counter, &resolved);
+        counter = &resolved;
+    }
+
+    // During a full save, whether a counter has reached zero is decided as of the save's epoch, one clock for the file.
+    const ustime_t now = RdbSaveEpoch.is_set ? RdbSaveEpoch.epoch * MICROSECONDS_PER_MILLISECOND : degrading_counter_clock();
+    const size_t packed_len = degrading_counter_pack(counter, RdbSaveEpoch.is_set ? &RdbSaveEpoch.epoch : NULL, now, packed);
+
+    RedisModule_SaveStringBuffer(io, (const char *)packed, packed_len);
+}
+
+// Provided as the `aux_save` callback for our data type. Before the keys we write the save's epoch and the profiles, so
+// counters can refer to both as they're loaded. After the keys there's nothing to write, it just marks the end of the
+// save.
+void degrading_counter_aux_save(RedisModuleIO *io, int when) {
+    if (when == REDISMODULE_AUX_AFTER_RDB) {
+        RdbSaveEpoch.is_set = 0;
+        return;
+    }
+
+    RdbSaveEpoch.epoch = degrading_counter_clock() / MICROSECONDS_PER_MILLISECOND;
+    RdbSaveEpoch.is_set = 1;
+
+    RedisModule_SaveSigned(io, RdbSaveEpoch.epoch);
+    RedisModule_SaveUnsigned(io, ProfileCount);
+
+    for (size_t i = 0; i < ProfileCount; i++) {
+        const DegradingCounterProfile *profile = &Profiles[i];
+
+        RedisModule_SaveStringBuffer(io, profile->name, profile->name_len);
+        RedisModule_SaveDouble(io, profile->config.degrades_at);
+        RedisModule_SaveUnsigned(io, profile->config.number_of_increments);
+        RedisModule_SaveUnsigned(io, profile->config.increment);
+        RedisModule_SaveUnsigned(io, profile->config.decay);
+    }
+}
+
+// Provided as the `aux_load` callback for our data type. The profiles in the file replace whatever we had, the ids the
+// counters in it refer to only make sense together with them.
+int degrading_counter_aux_load(RedisModuleIO *io, int encoding_version, int when) {
+    if (when == REDISMODULE_AUX_AFTER_RDB) {
+        RdbLoadEpoch.is_set = 0;
+        return REDISMODULE_OK;
+    }
+
+    // Nothing was written through `aux_save` before version 2, and version 2 didn't have the epoch.
+    if (encoding_version < 2 || encoding_version > DEGRADING_COUNTER_ENCODING_VERSION) {
+        return REDISMODULE_ERR;
+    }
+
+    if (encoding_version >= 3) {
+        RdbLoadEpoch.epoch = RedisModule_LoadSigned(io);
+        RdbLoadEpoch.is_set = 1;
+    }
+
+    degrading_counter_clear_profiles();
+
+    const uint64_t profile_count = RedisModule_LoadUnsigned(io);
+
+    if (profile_count > DEGRADING_COUNTER_MAX_PROFILES) {
+        return REDISMODULE_ERR;
+    }
+
+    for (uint64_t i = 0; i < profile_count; i++) {
+        DegradingCounterData config = { 0 };
+        size_t name_len;
+        char *name = RedisModule_LoadStringBuffer(io, &name_len);
+
+        config.degrades_at = RedisModule_LoadDouble(io);
+        config.number_of_increments = RedisModule_LoadUnsigned(io);
+        config.increment = RedisModule_LoadUnsigned(io);
+        config.decay = RedisModule_LoadUnsigned(io);
+
+        degrading_counter_add_profile(name, name_len, &config);
+        RedisModule_Free(name);
+    }
 
-    RedisModule_SaveSigned(io, degrading_counter_data->created);
-    RedisModule_SaveDouble(io, degrading_counter_data->degrades_at);
-    RedisModule_SaveSigned(io, degrading_counter_data->number_of_increments);
-    RedisModule_SaveSigned(io, degrading_counter_data->increment);
-    RedisModule_SaveDouble(io, degrading_counter_data->value);
+    return REDISMODULE_OK;
 }
 
-// Provided as the `aof_rewrite` callback for our data type.
+// Provided as the `aof_rewrite` callback for our data type. Replaying a DC.INCR would restart the counter's decay from
+// the moment of the replay, so we emit DC.RESTORE with the packed record instead, which carries the absolute creation
+// time and is cheaper to replay than parsing the DC.INCR arguments.
 void degrading_counter_aof_rewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
     const DegradingCounterData *degrading_counter_data = value;
+    unsigned char packed[DEGRADING_COUNTER_MAX_PACKED_SIZE];
+    const ustime_t now = degrading_counter_clock();
+    const size_t packed_len = degrading_counter_pack(degrading_counter_data, NULL, now, packed);
 
-    // Call out to the DegradingCounter_Create_Interval_String method to formulate the command string. This method
-    // allocates memory for the string, to be sure and free that memory after we're done here.
-    char* interval_string = degrading_counter_create_interval_string(degrading_counter_data);
+    if (degrading_counter_data->increment != DEGRADING_COUNTER_PROFILED) {
+        RedisModule_EmitAOF(aof, "DC.RESTORE", "sb", key, (const char *)packed, packed_len);
+        return;
+    }
 
-    RedisModule_EmitAOF(aof, "DC.INCR", "ssdsdss",
-                        key,
-                        "AMOUNT", degrading_counter_data->value,
-                        "DEGRADE_RATE", degrading_counter_data->degrades_at,
-                        "INTERVAL", interval_string);
+    const DegradingCounterProfile *profile = &Profiles[degrading_counter_data->number_of_increments];
+    unsigned char packed_profile[DEGRADING_COUNTER_MAX_PACKED_SIZE];
+    const size_t packed_profile_len = degrading_counter_pack(&profile->config, NULL, now, packed_profile);
 
-    // Up where we set the interval_string variable we allocated some memory, so here we are freeing that memory...
-    RedisModule_Free(interval_string);
+    RedisModule_EmitAOF(aof, "DC.RESTORE", "sbcbb",
+                        key,
+                        (const char *)packed, packed_len,
+                        "PROFILE",
+                        profile->name, profile->name_len,
+                        (const char *)packed_profile, packed_profile_len);
 }
 
 // Provided as the `free` callback for our data type.
 void degrading_counter_free(void *value) {
     // This should suffice as our data type doesn't require a complex structure.
-    RedisModule_Free(value);
+    pool_free(degrading_counter_pool(value), value);
+}
+
+// Provided as the `mem_usage` callback for our data type, this is what `MEMORY USAGE` reports for the value.
+size_t degrading_counter_mem_usage(const void *value) {
+    // Every counter takes up exactly one pool slot, slab overhead is amortized away.
+    return pool_object_size(degrading_counter_pool(value));
+}
+
+// Provided as the `free_effort` callback for our data type.
+size_t degrading_counter_free_effort(RedisModuleString *key, const void *value) {
+    // A counter is a single pool slot, it's never worth handing off to the lazy free thread.
+    return 1;
+}
+
+// Provided as the `unlink` callback for our data type. It's called on the main thread when the key is removed from the
+// keyspace, before `free` (which may happen later, on another thread).
+void degrading_counter_unlink(RedisModuleString *key, const void *value) {
+    // Counters don't reference anything outside of their own slot, so there's nothing to detach.
+}
+
+// Provided as the `defrag` callback for our data type, active defrag calls it for every counter it comes across. A
+// counter lives inside a pool slab, so rather than have the allocator move it we move it ourselves, out of a sparse slab
+// and into a fuller one. Once a sparse slab has been drained it's handed back to Redis as a whole.
+int degrading_counter_defrag(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value) {
+    void *moved = pool_defrag(degrading_counter_pool(*value), *value);
+
+    if (moved != NULL) {
+        *value = moved;
+    }
+
+    return 0;
+}
+
+// Registered with `RedisModule_RegisterDefragFunc`, called once per active defrag cycle for the module's own globals:
+// the pools' bookkeeping and the profile table.
+int degrading_counter_defrag_globals(RedisModuleDefragCtx *ctx) {
+    pool_defrag_bookkeeping(DegradingCounterPool, ctx);
+    pool_defrag_bookkeeping(ProfiledCounterPool, ctx);
+    pool_defrag_bookkeeping(MicrosecondCounterPool, ctx);
+
+    // Profiles are referenced by their index, never by address, and the dictionary keeps its own copy of the names.
+    if (Profiles != NULL) {
+        DegradingCounterProfile *profiles = RedisModule_DefragAlloc(ctx, Profiles);
+
+        if (profiles != NULL) {
+            Profiles = profiles;
+        }
+    }
+
+    for (size_t i = 0; i < ProfileCount; i++) {
+        char *name = RedisModule_DefragAlloc(ctx, Profiles[i].name);
+
+        if (name != NULL) {
+            Profiles[i].name = name;
+        }
+    }
+
+    return 0;
+}
+
+// Set up the module's global state. Separate from `RedisModule_OnLoad` so the microbenchmarks can run the counter code
+// without a server.
+void degrading_counter_init(void) {
+    DegradingCounterPool = pool_create(offsetof(DegradingCounterData, created_microseconds), DEGRADING_COUNTER_POOL_SLAB_SIZE);
+    ProfiledCounterPool = pool_create(offsetof(DegradingCounterData, degrades_at), DEGRADING_COUNTER_POOL_SLAB_SIZE);
+    MicrosecondCounterPool = pool_create(sizeof(DegradingCounterData), DEGRADING_COUNTER_POOL_SLAB_SIZE);
+    degrading_counter_init_exponential_decay_table();
 }
 
-int RedisModule_OnLoad(RedisModuleCtx *ctx) {
+int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     if (RedisModule_Init(ctx, DEGRADING_COUNTER_TYPE_NAME, DEGRADING_COUNTER_MODULE_VERSION, REDISMODULE_APIVER_1) == REDISMODULE_ERR) {
         return REDISMODULE_ERR;
     }
 
+    if (degrading_counter_parse_module_arguments(ctx, argv, argc) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
     RedisModuleTypeMethods tm = {
         .version = REDISMODULE_TYPE_METHOD_VERSION,
         .rdb_load = degrading_counter_rdb_load,
         .rdb_save = degrading_counter_rdb_save,
+        .aux_load = degrading_counter_aux_load,
+        .aux_save = degrading_counter_aux_save,
+        .aux_save_triggers = REDISMODULE_AUX_BEFORE_RDB|REDISMODULE_AUX_AFTER_RDB,
         .aof_rewrite = degrading_counter_aof_rewrite,
-        .free = degrading_counter_free
+        .mem_usage = degrading_counter_mem_usage,
+        .free = degrading_counter_free,
+        .free_effort = degrading_counter_free_effort,
+        .unlink = degrading_counter_unlink,
+        .defrag = degrading_counter_defrag
     };
 
+    degrading_counter_init();
+    ProfilesByName = RedisModule_CreateDict(NULL);
+
     DegradingCounter = RedisModule_CreateDataType(ctx,
         DEGRADING_COUNTER_TYPE_NAME,
         DEGRADING_COUNTER_ENCODING_VERSION,
@@ -515,19 +2383,103 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx) {
     }
 
     if (RedisModule_CreateCommand(ctx, "dc.incr",
-        degrading_counter_increment_RedisCommand,"fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        degrading_counter_increment_RedisCommand_Timed,"fast write", 1, 1, 1) == REDISMODULE_ERR) {
         return REDISMODULE_ERR;
     }
 
     if (RedisModule_CreateCommand(ctx, "dc.decr",
-        degrading_counter_decrement_RedisCommand,"fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        degrading_counter_decrement_RedisCommand_Timed,"fast write", 1, 1, 1) == REDISMODULE_ERR) {
         return REDISMODULE_ERR;
     }
 
     if (RedisModule_CreateCommand(ctx, "dc.peek",
-        degrading_counter_peek_RedisCommand,"fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        degrading_counter_peek_RedisCommand_Timed,"readonly fast", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // The batch commands take a variable number of keys. For DC.MINCR every seventh argument is a key.
+    if (RedisModule_CreateCommand(ctx, "dc.mincr",
+        degrading_counter_multi_increment_RedisCommand_Timed,"write", 1, -1, 7) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.mpeek",
+        degrading_counter_multi_peek_RedisCommand_Timed,"readonly", 1, -1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.allow",
+        degrading_counter_allow_RedisCommand_Timed, "write deny-oom fast", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.describe",
+        degrading_counter_describe_RedisCommand_Timed, "readonly", 1, -1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // DC.RESTORE only comes from the AOF and the replication stream, the commands that cause it are timed instead.
+    if (RedisModule_CreateCommand(ctx, "dc.restore",
+        degrading_counter_restore_RedisCommand, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // DC.PROFILE only exists to hold its subcommands. Only SET changes anything, so GET still works on a replica.
+    if (RedisModule_CreateCommand(ctx, "dc.profile", NULL, "", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    RedisModuleCommand *profile_command = RedisModule_GetCommand(ctx, "dc.profile");
+
+    if (profile_command == NULL ||
+        RedisModule_CreateSubcommand(profile_command, "set",
+            degrading_counter_profile_set_RedisCommand_Timed, "write deny-oom", 0, 0, 0) == REDISMODULE_ERR ||
+        RedisModule_CreateSubcommand(profile_command, "get",
+            degrading_counter_profile_get_RedisCommand_Timed, "readonly fast", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (window_counter_register(ctx) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (leaderboard_register(ctx) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (hash_counter_register(ctx) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (aggregate_register(ctx) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (watch_register(ctx) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (sketch_register(ctx) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (export_register(ctx) == REDISMODULE_ERR) {
         return REDISMODULE_ERR;
     }
 
+    if (RedisModule_RegisterInfoFunc(ctx, degrading_counter_info) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_RegisterDefragFunc(ctx, degrading_counter_defrag_globals) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // The sweeper is opt-in, it's only needed to reclaim counters that were created before counters had expires.
+    if (SweepState.interval > 0) {
+        SweepState.cursor = RedisModule_ScanCursorCreate();
+        RedisModule_CreateTimer(ctx, SweepState.interval, degrading_counter_sweep_timer_callback, NULL);
+    }
+
     return REDISMODULE_OK;
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#ifndef DEGRADING_COUNTER_MODULE_H
+#define DEGRADING_COUNTER_MODULE_H
+
+// Definitions shared by the data types that make up the module. Each type lives in its own file and registers itself
+// from `RedisModule_OnLoad` in module.c.
+
+#include "redismodule.h"
+#include "stats.h"
+#include <stdint.h>
+
+#define MICROSECONDS_PER_MICROSECOND 1LL // Hehe.
+#define MICROSECONDS_PER_MILLISECOND 1000LL
+#define MICROSECONDS_PER_SECOND 1000000LL
+#define MICROSECONDS_PER_MINUTE 60000000LL
+#define MICROSECONDS_PER_HOUR 3600000000LL
+#define MICROSECONDS_PER_DAY 86400000000LL
+
+#define MICROSECONDS_ABBREVIATION "us"
+#define MILLISECONDS_ABBREVIATION "ms"
+#define SECONDS_ABBREVIATION "sec"
+#define MINUTES_ABBREVIATION "min"
+#define HOURS_ABBREVIATION "hour"
+#define DAYS_ABBREVIATION "day"
+
+#define CLOSE_ENOUGH_TO_ZERO 1e-9
+
+// Counters that won't reach zero for this long (roughly 3,000 years) are left without an expire.
+#define DEGRADING_COUNTER_MAX_EXPIRE_MS 1e14
+
+// Counters store their creation time relative to this epoch (2024-01-01T00:00:00Z) so that it fits in 40 bits, which
+// gives us millisecond resolution until late 2058.
+#define DEGRADING_COUNTER_EPOCH_MS 1704067200000LL
+#define DEGRADING_COUNTER_CREATED_BITS 40
+#define DEGRADING_COUNTER_MAX_CREATED_OFFSET ((1LL << DEGRADING_COUNTER_CREATED_BITS) - 1)
+
+// The interval length shares the rest of the 64-bit word with the unit and decay mode.
+#define DEGRADING_COUNTER_NUMBER_OF_INCREMENTS_BITS 20
+#define DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS ((1 << DEGRADING_COUNTER_NUMBER_OF_INCREMENTS_BITS) - 1)
+
+// Debug tracing is only compiled in when building with `make DEBUG=1`. Release builds don't contain the calls at all, so
+// the arguments aren't even evaluated.
+#ifdef DEGRADING_COUNTER_DEBUG
+#define DEGRADING_COUNTER_LOG_DEBUG(ctx, ...) RedisModule_Log(ctx, REDISMODULE_LOGLEVEL_DEBUG, __VA_ARGS__)
+#else
+#define DEGRADING_COUNTER_LOG_DEBUG(ctx, ...) ((void)0)
+#endif
+
+// Wrap a command handler so that every call is counted and timed for `INFO`. Defines `<handler>_Timed`, which is what
+// gets registered with Redis.
+#define DEGRADING_COUNTER_TIMED_COMMAND(handler, stats_command) \
+    int handler##_Timed(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) { \
+        const uint64_t started = RedisModule_MonotonicMicroseconds(); \
+        const int result = handler(ctx, argv, argc); \
+        stats_record_call(stats_command, RedisModule_MonotonicMicroseconds() - started); \
+        return result; \
+    }
+
+// 3 is DEGRADING_COUNTER_PROFILED, the units added after profiles go after it so records already written keep their meaning.
+typedef enum CounterIncrements {
+    Milliseconds = 0,
+    Seconds = 1,
+    Minutes = 2,
+    Microseconds = 4,
+    Hours = 5,
+    Days = 6
+} CounterIncrements;
+
+typedef enum CounterDecay {
+    DecayLinear = 0, // Subtract `degrades_at` at the end of every interval.
+    DecayExponential = 1 // Halve the value every interval (the half-life).
+} CounterDecay;
+
+// A value of `increment` that isn't a unit marks a counter created from a profile (DC.INCR key amount PROFILE name).
+// Those keep the profile id in `number_of_increments` and read everything else from the profile, so they're allocated
+// without `degrades_at`.
+#define DEGRADING_COUNTER_PROFILED 3
+#define DEGRADING_COUNTER_MAX_PROFILES DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS
+
+// We keep a lot of these around, so the layout is packed down to 24 bytes (16 for a counter created from a profile, which
+// is why `degrades_at` comes last). The creation time, interval length, interval unit and decay mode share a single
+// 64-bit word. Counters with a microsecond interval need their creation time to the microsecond, they're the only ones
+// allocated with `created_microseconds` (and take up 32 bytes).
+//
+// With exponential decay `value` is the value as of `created` (every increment re-anchors the counter to the current
+// time) and `degrades_at` holds the precomputed number of half-lives per millisecond.
+typedef struct DegradingCounterData {
+    double value; // What is accumulated value of the counter? This will be a raw "un-degraded" number. Only increments and decrements apply here.
+    uint64_t created_offset : DEGRADING_COUNTER_CREATED_BITS; // Milliseconds between DEGRADING_COUNTER_EPOCH_MS and when the counter was created.
+    uint64_t number_of_increments : DEGRADING_COUNTER_NUMBER_OF_INCREMENTS_BITS; // How many increments should elapse before degrading the counter? Defaults to 1. The profile id for profiled counters.
+    uint64_t increment : 3; // Which time increment (CounterIncrements) should be used to degrade the counter? DEGRADING_COUNTER_PROFILED for profiled counters.
+    uint64_t decay : 1; // How does the counter degrade (CounterDecay)?
+    double degrades_at; // How much should the counter degrade after an increment has passed. e.g. 1 every millisecond, or .5 every minute. Not allocated for profiled counters.
+    uint16_t created_microseconds; // Microseconds past the millisecond in `created_offset`. Only allocated for microsecond counters.
+} DegradingCounterData;
+
+// Creates the counter pools and lookup tables, called from `RedisModule_OnLoad`.
+void degrading_counter_init(void);
+
+int is_approximately_zero(double value, double epsilon);
+
+// The time (Unix microseconds) as of the start of the current command. Redis caches it before running a command, so
+// every counter a command touches sees the same clock and reading it doesn't cost a syscall. Commands read it once and
+// pass it down.
+ustime_t degrading_counter_now(void);
+
+// The actual current time (Unix microseconds), for timers and background threads that aren't running a command.
+ustime_t degrading_counter_clock(void);
+
+// How many microseconds are in one of the given unit?
+long long degrading_counter_unit_in_microseconds(CounterIncrements unit);
+
+// How many milliseconds are in one of the given unit? 0 for microseconds, which the millisecond based types don't take.
+long long degrading_counter_unit_in_milliseconds(CounterIncrements unit);
+
+// Parse the `AMOUNT`, `DEGRADE_RATE`, `INTERVAL`, `DECAY` and `HALFLIFE` pairs from `argv[2]` up to `argc`. Replies
+// with an error and returns NULL if they don't describe a counter, the result must be released with
+// `degrading_counter_free`.
+DegradingCounterData *get_degrading_counter_data_from_redis_arguments(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
+
+// The same pairs without `AMOUNT`, for commands that only need a decay configuration (the amounts come from elsewhere).
+DegradingCounterData *get_degrading_counter_config_from_redis_arguments(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
+
+void degrading_counter_free(void *value);
+
+// The decayed value of a counter at `now` (Unix microseconds).
+double degrading_counter_compute_value(RedisModuleCtx *ctx, const DegradingCounterData *counter, ustime_t now);
+
+// The counter stored at `key`, or NULL if the key holds something else (or nothing at all).
+DegradingCounterData *degrading_counter_from_key(RedisModuleKey *key);
+
+long long degrading_counter_interval_in_microseconds(const DegradingCounterData *counter);
+
+// The interval in whole milliseconds, for the types that keep a millisecond clock (0 for an interval under one).
+long long degrading_counter_interval_in_milliseconds(const DegradingCounterData *counter);
+
+// When the counter will first read below `threshold`, in Unix milliseconds (rounded up), REDISMODULE_NO_EXPIRE if it
+// never will. A counter that's already below gets its creation time, which is in the past.
+mstime_t degrading_counter_compute_crossing_time(const DegradingCounterData *counter, double threshold);
+
+// The most bytes `degrading_counter_pack` writes for a single counter.
+#define DEGRADING_COUNTER_MAX_PACKED_SIZE 32
+
+// Pack a counter into its compact RDB record, creation time relative to `epoch` unless that's NULL. `now` (Unix
+// microseconds) decides whether the counter has already reached zero. Returns the length.
+size_t degrading_counter_pack(const DegradingCounterData *counter, const mstime_t *epoch, ustime_t now, unsigned char *out);
+
+// Unpack a record written by `degrading_counter_pack`. Returns 0 on success, -1 if it's malformed.
+int degrading_counter_unpack(const unsigned char *in, size_t in_len, const mstime_t *epoch, DegradingCounterData *counter);
+
+// A counter's raw fields the way DC.EXPORT writes them: the creation time as absolute Unix microseconds, and the rate
+// and interval of a counter created from a profile resolved from the profile (profile ids only mean something on the
+// node that handed them out).
+typedef struct DegradingCounterFields {
+    double value;
+    double degrades_at;
+    ustime_t created;
+    uint32_t number_of_increments;
+    uint8_t increment; // CounterIncrements
+    uint8_t decay; // CounterDecay
+} DegradingCounterFields;
+
+// Fill in `fields` from a counter.
+void degrading_counter_get_fields(const DegradingCounterData *counter, DegradingCounterFields *fields);
+
+// Store a counter rebuilt from `fields` at `key_name`, as of `now` (Unix microseconds). The key gets its expire, the
+// write is replicated as a DC.RESTORE and notified like one. Returns 1 if it was stored, 0 if it was skipped because the
+// key already exists or the counter has reached zero, and -1 if the fields don't describe a counter.
+int degrading_counter_import(RedisModuleCtx *ctx, RedisModuleString *key_name, const DegradingCounterFields *fields, ustime_t now);
+
+// Parse an interval string such as `5sec` into its length and unit. Microseconds that add up to whole milliseconds come
+// back as milliseconds, and a length too long for its unit moves up to a bigger one it divides into exactly. Returns 0
+// on success, -1 otherwise.
+int degrading_counter_parse_interval_string(const char *interval_str, int *number_of_increments, CounterIncrements *unit);
+
+// Background threads only hold the GIL for this many keys at a time.
+#define BACKGROUND_KEYS_PER_LOCK 1000
+
+// A command that works through a whole database on a background thread while its client stays blocked (background.c).
+// Each command keeps one of these as the first member of its own job and fills in the callbacks before handing it to
+// `background_start`.
+typedef struct BackgroundJob BackgroundJob;
+
+struct BackgroundJob {
+    // Does the work. With `chunked` set it's on the background thread and takes the GIL itself (`background_lock`),
+    // otherwise it's on the main thread and already holds it.
+    void (*run)(RedisModuleCtx *ctx, BackgroundJob *job, int chunked);
+    // Replies to the client once `run` is done.
+    void (*reply)(RedisModuleCtx *ctx, const BackgroundJob *job);
+    // Releases the job, whether it ran or not.
+    void (*free)(BackgroundJob *job);
+
+    // Only used by `background_scan`. `scan_filter` (optional) turns keys away by name before they're opened,
+    // `scan_counter` gets every counter that's left and `scan_chunk_end` (optional) is called with the GIL released
+    // after every chunk, a non-zero return ends the scan.
+    int (*scan_filter)(BackgroundJob *job, const char *name, size_t name_len);
+    void (*scan_counter)(RedisModuleCtx *ctx, BackgroundJob *job, RedisModuleString *key_name, const DegradingCounterData *counter);
+    int (*scan_chunk_end)(RedisModuleCtx *ctx, BackgroundJob *job, int more);
+
+    RedisModuleBlockedClient *blocked_client;
+    size_t visited; // Keys looked at since the lock was last taken.
+    int chunk_full; // Set by `scan_counter` to end the current chunk early.
+    ustime_t now; // Read once each time the lock is taken, every counter in a chunk is valued at the same instant.
+};
+
+// Run `job` on a background thread and block the client until it's done, or right away where the client can't block.
+// Takes ownership of `job`.
+int background_start(RedisModuleCtx *ctx, BackgroundJob *job);
+
+// Walk the whole database BACKGROUND_KEYS_PER_LOCK keys at a time, handing every counter to `job->scan_counter`. Can be
+// used as `job->run` as it is.
+void background_scan(RedisModuleCtx *ctx, BackgroundJob *job, int chunked);
+
+// Take and give up the GIL around a chunk of work, both do nothing unless `chunked` is set.
+void background_lock(RedisModuleCtx *ctx, int chunked);
+void background_unlock(RedisModuleCtx *ctx, int chunked);
+
+// Sliding window counters (window.c).
+int window_counter_register(RedisModuleCtx *ctx);
+
+// Decaying leaderboards (leaderboard.c).
+int leaderboard_register(RedisModuleCtx *ctx);
+
+// Many counters in one key (hash_counter.c).
+int hash_counter_register(RedisModuleCtx *ctx);
+
+// Keyspace wide aggregates run on a background thread (aggregate.c).
+int aggregate_register(RedisModuleCtx *ctx);
+
+// Threshold watches (watch.c).
+int watch_register(RedisModuleCtx *ctx);
+
+// Decaying count-min sketches (sketch.c).
+int sketch_register(RedisModuleCtx *ctx);
+
+// Streaming export and import of every counter in a database (export.c).
+int export_register(RedisModuleCtx *ctx);
+
+// Move the watches on `key_name` after a write to its counter, NULL once the counter has been deleted.
+void watch_counter_changed(RedisModuleCtx *ctx, RedisModuleString *key_name, const DegradingCounterData *counter);
+
+#endif
@@ -0,0 +1,55 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class AggregateTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItSumsTheMatchingCounters()
+    {
+        // Other tests share the database, so everything here lives under a prefix of its own.
+        var prefix = CreateTestKey();
+        var expected = 0.0;
+
+        for (var i = 0; i < 10; i++)
+        {
+            var amount = GetRandomDouble(1.0, 100.0);
+            expected += amount;
+
+            await _redis.ExecuteAsync(ModuleCommand.Increment, $"{prefix}:{i}", "AMOUNT", amount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        }
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, $"other:{prefix}", "AMOUNT", 1000.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.StringSetAsync($"{prefix}:string", "not a counter");
+
+        var result = await _redis.ExecuteAsync(ModuleCommand.Sum, $"{prefix}:*");
+
+        Assert.Equal(expected, (double)result, 6);
+    }
+
+    [Fact]
+    public async Task ItCountsTheCountersAboveTheThreshold()
+    {
+        var prefix = CreateTestKey();
+
+        foreach (var amount in new[] { 50.0, 150.0, 250.0 })
+        {
+            await _redis.ExecuteAsync(ModuleCommand.Increment, $"{prefix}:{amount}", "AMOUNT", amount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        }
+
+        var result = await _redis.ExecuteAsync(ModuleCommand.CountAbove, $"{prefix}:*", 100);
+
+        Assert.Equal(2, (long)result);
+    }
+
+    [Fact]
+    public async Task ItReturnsZeroWhenNothingMatches()
+    {
+        var result = await _redis.ExecuteAsync(ModuleCommand.Sum, $"{CreateTestKey()}:*");
+
+        Assert.Equal(0.0, (double)result);
+    }
+}
@@ -0,0 +1,66 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class AllowTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItAllowsCallsUntilTheLimitIsReached()
+    {
+        var testKey = CreateTestKey();
+
+        for (var i = 1; i <= 3; i++)
+        {
+            var allowed = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Allow, testKey, "COST", 1.0, "LIMIT", 3.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min"))!;
+
+            Assert.Equal(1, (long)allowed[0]);
+            Assert.Equal(i, (double)allowed[1]);
+        }
+
+        var denied = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Allow, testKey, "COST", 1.0, "LIMIT", 3.0))!;
+
+        Assert.Equal(0, (long)denied[0]);
+        Assert.Equal(3.0, (double)denied[1]);
+        // One interval has to pass before the counter drops to 2.
+        Assert.InRange((long)denied[2], 1, 3600000);
+        Assert.Equal(3.0, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey));
+    }
+
+    [Fact]
+    public async Task ItCreatesTheCounterFromAProfile()
+    {
+        var profile = CreateTestKey();
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        var allowed = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Allow, testKey, "COST", 2.0, "LIMIT", 10.0, "PROFILE", profile))!;
+
+        Assert.Equal(1, (long)allowed[0]);
+        Assert.Equal(0, (long)allowed[2]);
+        Assert.Equal(2.0, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey));
+    }
+
+    [Fact]
+    public async Task ItNeverAllowsACostOverTheLimit()
+    {
+        var testKey = CreateTestKey();
+
+        var denied = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Allow, testKey, "COST", 5.0, "LIMIT", 3.0, "DEGRADE_RATE", 1.0, "INTERVAL", "1sec"))!;
+
+        Assert.Equal(0, (long)denied[0]);
+        Assert.Equal(-1, (long)denied[2]);
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItRequiresAConfigurationToCreateACounter()
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Allow, testKey, "COST", 1.0, "LIMIT", 3.0));
+    }
+}
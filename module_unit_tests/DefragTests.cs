@@ -0,0 +1,77 @@
+using System.Globalization;
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class DefragTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    // Churn: create a lot of counters, then delete nine out of ten of them so every slab is left mostly empty. Active
+    // defrag should drain the sparse slabs into the fuller ones, hand them back, and bring the fragmentation down.
+    [Fact]
+    public async Task ItCompactsTheCounterPoolsUnderActiveDefrag()
+    {
+        const int counterCount = 200_000;
+
+        var prefix = CreateTestKey();
+        var keys = Enumerable.Range(0, counterCount).Select(i => $"{prefix}:{i}").ToArray();
+
+        foreach (var chunk in keys.Chunk(10_000))
+        {
+            await Task.WhenAll(chunk.Select((key, i) => _redis.ExecuteAsync(ModuleCommand.Increment, key, "AMOUNT",
+                (double)(i + 1), "DEGRADE_RATE", 1.0, "INTERVAL", "60min")));
+        }
+
+        var survivors = keys.Where((_, i) => i % 10 == 0).ToArray();
+
+        foreach (var chunk in keys.Where((_, i) => i % 10 != 0).Chunk(10_000))
+        {
+            await _redis.KeyDeleteAsync(chunk.Select(key => (RedisKey)key).ToArray());
+        }
+
+        var poolBytesAfterChurn = await GetInfoField("modules", "pool_bytes");
+        var fragmentationAfterChurn = await GetInfoField("memory", "allocator_frag_ratio");
+
+        try
+        {
+            await _redis.ExecuteAsync("CONFIG", "SET", "active-defrag-ignore-bytes", "1");
+            await _redis.ExecuteAsync("CONFIG", "SET", "active-defrag-threshold-lower", "0");
+            await _redis.ExecuteAsync("CONFIG", "SET", "activedefrag", "yes");
+
+            var deadline = DateTime.UtcNow.AddSeconds(60);
+
+            while (await GetInfoField("modules", "pool_bytes") > poolBytesAfterChurn / 2 && DateTime.UtcNow < deadline)
+            {
+                await Task.Delay(250);
+            }
+        }
+        finally
+        {
+            await _redis.ExecuteAsync("CONFIG", "SET", "activedefrag", "no");
+            await _redis.ExecuteAsync("CONFIG", "SET", "active-defrag-ignore-bytes", "100mb");
+            await _redis.ExecuteAsync("CONFIG", "SET", "active-defrag-threshold-lower", "10");
+        }
+
+        Assert.True(await GetInfoField("modules", "pool_bytes") <= poolBytesAfterChurn / 2);
+        Assert.True(await GetInfoField("memory", "allocator_frag_ratio") <= fragmentationAfterChurn);
+
+        // Moving a counter must not change it.
+        for (var i = 0; i < survivors.Length; i += 97)
+        {
+            Assert.Equal(10.0 * i % 10_000 + 1, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, survivors[i]));
+        }
+
+        await _redis.KeyDeleteAsync(survivors.Select(key => (RedisKey)key).ToArray());
+    }
+
+    private async Task<double> GetInfoField(string section, string field)
+    {
+        var info = (string)(await _redis.ExecuteAsync("INFO", section))!;
+
+        var line = info.Split('\n').Single(l => l.Contains(field + ":"));
+
+        return double.Parse(line.Split(':')[1].Trim(), CultureInfo.InvariantCulture);
+    }
+}
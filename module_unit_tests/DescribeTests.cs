@@ -0,0 +1,87 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class DescribeTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItDescribesALinearCounter()
+    {
+        var testKey = CreateTestKey();
+        var before = DateTimeOffset.UtcNow.ToUnixTimeMilliseconds();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 0.5, "INTERVAL", "5sec");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Describe, testKey))!;
+        var description = (RedisResult[])result[0]!;
+
+        Assert.Equal(10, description.Length);
+        Assert.Equal("VALUE", (string)description[0]!);
+        Assert.Equal(10.0, (double)description[1]);
+        Assert.Equal("CREATED", (string)description[2]!);
+        // Allow for the container's clock being a little off from ours.
+        Assert.InRange((long)description[3], before - 5000, before + 5000);
+        Assert.Equal("LINEAR", (string)description[5]!);
+        Assert.Equal(0.5, (double)description[7]);
+        Assert.Equal("INTERVAL_MS", (string)description[8]!);
+        Assert.Equal(5000, (long)description[9]);
+    }
+
+    [Fact]
+    public async Task ItDescribesAnExponentialCounter()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 100.0, "DECAY", "EXP", "HALFLIFE", "60min");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Describe, testKey))!;
+        var description = (RedisResult[])result[0]!;
+
+        Assert.Equal(8, description.Length);
+        Assert.Equal(100.0, (double)description[1]);
+        Assert.Equal("EXP", (string)description[5]!);
+        Assert.Equal("HALFLIFE_MS", (string)description[6]!);
+        Assert.Equal(3600000, (long)description[7]);
+    }
+
+    [Fact]
+    public async Task ItReturnsNullAndErrorsPerKey()
+    {
+        var stringKey = CreateTestKey();
+
+        await _redis.StringSetAsync(stringKey, "not a counter");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Describe, "whatever_this_is_it_doesnt_exist", stringKey))!;
+
+        Assert.True(result[0].IsNull);
+        Assert.Equal(ResultType.Error, result[1].Resp2Type);
+    }
+
+    // Anything caching a counter from DC.DESCRIBE learns it changed through keyspace events (or client-side caching).
+    [Fact]
+    public async Task ItFiresAKeyspaceEventWhenACounterChanges()
+    {
+        var testKey = CreateTestKey();
+        var events = new TaskCompletionSource<string>();
+        var subscriber = redisFixture.Redis!.GetSubscriber();
+        var channel = RedisChannel.Literal($"__keyspace@0__:{testKey}");
+
+        await _redis.ExecuteAsync("CONFIG", "SET", "notify-keyspace-events", "Kd");
+        await subscriber.SubscribeAsync(channel, (_, message) => events.TrySetResult(message!));
+
+        try
+        {
+            await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+            Assert.Equal("dc.incr", await events.Task.WaitAsync(TimeSpan.FromSeconds(5)));
+        }
+        finally
+        {
+            await subscriber.UnsubscribeAsync(channel);
+            await _redis.ExecuteAsync("CONFIG", "SET", "notify-keyspace-events", "");
+        }
+    }
+}
@@ -0,0 +1,59 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class ExpirationTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItExpiresTheKeyWhenTheCounterReachesZero()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        var timeToLive = await _redis.KeyTimeToLiveAsync(testKey);
+
+        // Ten intervals of sixty minutes.
+        Assert.NotNull(timeToLive);
+        Assert.InRange(timeToLive.Value, TimeSpan.FromMinutes(599), TimeSpan.FromMinutes(600));
+    }
+
+    [Fact]
+    public async Task ItMovesTheExpireWhenTheCounterChanges()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Decrement, testKey, 5.0);
+
+        var timeToLive = await _redis.KeyTimeToLiveAsync(testKey);
+
+        Assert.NotNull(timeToLive);
+        Assert.InRange(timeToLive.Value, TimeSpan.FromMinutes(299), TimeSpan.FromMinutes(300));
+    }
+
+    [Fact]
+    public async Task ItRemovesACounterThatIsNeverReadAgain()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 2.0, "DEGRADE_RATE", 1.0, "INTERVAL", "50ms");
+
+        await Task.Delay(TimeSpan.FromMilliseconds(300));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItDoesNotExpireACounterThatDoesNotDegrade()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 0.0, "INTERVAL", "1sec");
+
+        Assert.Null(await _redis.KeyTimeToLiveAsync(testKey));
+    }
+}
@@ -0,0 +1,56 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class ExponentialDecayTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItCanCreateAnExponentialCounter()
+    {
+        var testKey = CreateTestKey();
+
+        var result = (double)await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 100.0, "DECAY", "EXP", "HALFLIFE", "60min");
+
+        Assert.Equal(100.0, result);
+    }
+
+    [Fact]
+    public async Task ItHalvesTheValueEveryHalfLife()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 100.0, "DECAY", "EXP", "HALFLIFE", "200ms");
+
+        await Task.Delay(TimeSpan.FromMilliseconds(400));
+
+        var peekedResult = (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey);
+
+        // Two half-lives, give or take scheduling.
+        Assert.InRange(peekedResult, 15.0, 25.0);
+    }
+
+    [Fact]
+    public async Task ItAddsIncrementsToTheDecayedValue()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 100.0, "DECAY", "EXP", "HALFLIFE", "60min");
+
+        var result = (double)await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DECAY", "EXP", "HALFLIFE", "60min");
+
+        Assert.InRange(result, 109.9, 110.0);
+    }
+
+    [Theory]
+    [InlineData("DEGRADE_RATE", "1.0")]
+    [InlineData("INTERVAL", "5sec")]
+    public async Task ItRejectsLinearArgumentsForExponentialDecay(string argumentName, string argumentValue)
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 1.0, "DECAY", "EXP", argumentName, argumentValue));
+    }
+}
@@ -0,0 +1,88 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class ExportTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItRoundTripsCountersThroughAFile()
+    {
+        var path = $"/tmp/{CreateTestKey()}.dcx";
+        var linearKey = CreateTestKey();
+        var exponentialKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, linearKey, "AMOUNT", 42.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Increment, exponentialKey, "AMOUNT", 1000.5, "DECAY", "EXP", "HALFLIFE", "60min");
+
+        var exported = (long)await _redis.ExecuteAsync(ModuleCommand.Export, path);
+
+        Assert.True(exported >= 2);
+
+        var exponentialValue = (double)await _redis.ExecuteAsync(ModuleCommand.Peek, exponentialKey);
+
+        await _redis.KeyDeleteAsync([linearKey, exponentialKey]);
+
+        var imported = (long)await _redis.ExecuteAsync(ModuleCommand.Import, path);
+
+        Assert.True(imported >= 2);
+        Assert.Equal(42.0, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, linearKey));
+        Assert.Equal(exponentialValue, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, exponentialKey), 3);
+        // The imported counter keeps its expire.
+        Assert.NotNull(await _redis.KeyTimeToLiveAsync(linearKey));
+    }
+
+    [Fact]
+    public async Task ItLeavesExistingKeysAlone()
+    {
+        var path = $"/tmp/{CreateTestKey()}.dcx";
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Export, path);
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 5.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Import, path);
+
+        Assert.Equal(15.0, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey));
+    }
+
+    // A header asking for a block far bigger than the rest of the file is turned away before anything is allocated for it.
+    [Fact]
+    public async Task ItRejectsABlockBiggerThanTheFile()
+    {
+        // The test directory is mounted into the container as /module_unit_tests.
+        var name = $"{CreateTestKey()}.dcx";
+        var localPath = Path.Combine(AppContext.BaseDirectory, name);
+
+        await using (var writer = new BinaryWriter(File.Create(localPath)))
+        {
+            writer.Write("DCEXPORT"u8);
+            writer.Write(1u); // Version.
+            writer.Write(0x01020304u); // Byte order mark, the container has the same byte order as us.
+            writer.Write(1u << 24); // Counters in the block.
+            writer.Write(0u);
+            writer.Write((ulong)uint.MaxValue); // Bytes of key names.
+        }
+
+        try
+        {
+            var exception = await Assert.ThrowsAsync<RedisServerException>(async () =>
+                await _redis.ExecuteAsync(ModuleCommand.Import, $"/module_unit_tests/{name}"));
+
+            Assert.Contains("truncated or corrupt", exception.Message);
+        }
+        finally
+        {
+            File.Delete(localPath);
+        }
+    }
+
+    [Fact]
+    public async Task ItRejectsAFileThatIsntAnExport()
+    {
+        await Assert.ThrowsAsync<RedisServerException>(async () =>
+            await _redis.ExecuteAsync(ModuleCommand.Import, "/etc/hostname"));
+    }
+}
@@ -0,0 +1,108 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class HashCounterTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItKeepsFieldsSeparate()
+    {
+        var testKey = CreateTestKey();
+        var firstAmount = GetRandomDouble(1.0, 100.0);
+        var secondAmount = GetRandomDouble(1.0, 100.0);
+
+        await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "first", "AMOUNT", firstAmount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "second", "AMOUNT", secondAmount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        var result = await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "first", "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        Assert.Equal(firstAmount + 1.0, (double)result, 9);
+        Assert.Equal(secondAmount, (double)(await _redis.ExecuteAsync(ModuleCommand.HashPeek, testKey, "second")));
+        Assert.True((await _redis.ExecuteAsync(ModuleCommand.HashPeek, testKey, "third")).IsNull);
+    }
+
+    [Fact]
+    public async Task ItReturnsEveryField()
+    {
+        var testKey = CreateTestKey();
+        var expected = new Dictionary<string, double>();
+
+        // Enough fields to make the table grow a few times.
+        for (var i = 0; i < 100; i++)
+        {
+            var amount = GetRandomDouble(1.0, 100.0);
+            expected[$"field{i}"] = amount;
+
+            await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, $"field{i}", "AMOUNT", amount, "DECAY", "EXP", "HALFLIFE", "60min");
+        }
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.HashGetAll, testKey))!;
+
+        Assert.Equal(200, result.Length);
+
+        for (var i = 0; i < result.Length; i += 2)
+        {
+            Assert.Equal(expected[(string)result[i]!], (double)result[i + 1], 3);
+        }
+    }
+
+    [Fact]
+    public async Task ItDropsFieldsThatReachZero()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "short", "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms");
+        await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "long", "AMOUNT", 100.0, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms");
+
+        await Task.Delay(300);
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.HashGetAll, testKey))!;
+
+        Assert.Equal(2, result.Length);
+        Assert.Equal("long", (string)result[0]!);
+    }
+
+    // DC.HDEL is what replicas get for fields the primary dropped.
+    [Fact]
+    public async Task ItDeletesFieldsAndTheKeyOnceTheyreAllGone()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "first", "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "second", "AMOUNT", 20.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        Assert.Equal(1, (long)(await _redis.ExecuteAsync(ModuleCommand.HashDelete, testKey, "first", "missing")));
+        Assert.True((await _redis.ExecuteAsync(ModuleCommand.HashPeek, testKey, "first")).IsNull);
+
+        Assert.Equal(1, (long)(await _redis.ExecuteAsync(ModuleCommand.HashDelete, testKey, "second")));
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    // DC.HRESTORE only replays what the primary or the AOF rewrite wrote, and nothing we write is ever NaN or infinite.
+    [Theory]
+    [InlineData("inf", "5")]
+    [InlineData("1", "inf")]
+    [InlineData("1", "-inf")]
+    public async Task ItRejectsARestoreWithANumberThatIsntFinite(string rate, string value)
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() =>
+            _redis.ExecuteAsync(ModuleCommand.HashRestore, testKey, 0, rate, 60000, "field", value, 0));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItRejectsTheWrongKeyType()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        await Assert.ThrowsAsync<RedisServerException>(async () =>
+            await _redis.ExecuteAsync(ModuleCommand.HashPeek, testKey, "field"));
+    }
+}
@@ -7,7 +7,7 @@ public class IncrementTests(RedisContainerFixture redisFixture)
 {
     private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
     
-    public static IEnumerable<object[]> TimeUnits => [["ms"], ["sec"], ["min"]];
+    public static IEnumerable<object[]> TimeUnits => [["ms"], ["sec"], ["min"], ["hour"], ["day"]];
     
     [Theory]
     [MemberData(nameof(TimeUnits))]
@@ -44,4 +44,37 @@ public class IncrementTests(RedisContainerFixture redisFixture)
         
         Assert.Equal(expectedTotalAmount, actualValue);
     }
+
+    // Too long for its own unit, but a whole number of a bigger one.
+    [Theory]
+    [InlineData("5000000ms", 5000000L)]
+    [InlineData("3000000sec", 3000000000L)]
+    public async Task ItAcceptsALongIntervalThatFitsABiggerUnit(string interval, long intervalMilliseconds)
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", interval);
+
+        var description = (RedisResult[])((RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Describe, testKey))!)[0]!;
+
+        Assert.Equal(intervalMilliseconds, (long)description[9]);
+    }
+
+    [Theory]
+    [InlineData("0sec")]
+    [InlineData("-5sec")]
+    [InlineData("5000001ms")]
+    [InlineData("1048576day")]
+    [InlineData("1048576ms")]
+    [InlineData("5hours")]
+    [InlineData("5sec5")]
+    [InlineData("5d")]
+    public async Task ItRejectsAnIntervalThatCantBeStored(string interval)
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", interval));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
 }
\ No newline at end of file
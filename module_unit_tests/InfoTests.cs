@@ -0,0 +1,44 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class InfoTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItReportsCommandStatistics()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Peek, testKey);
+
+        var info = (string)(await _redis.ExecuteAsync("INFO", "modules"))!;
+
+        Assert.Contains("live_counters:", info);
+        Assert.Contains("dc_incr:calls=", info);
+        Assert.Contains("dc_peek:calls=", info);
+        Assert.Contains("p999=", info);
+    }
+
+    [Fact]
+    public async Task ItCountsParseErrors()
+    {
+        var before = await GetParseErrors();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Increment, CreateTestKey(), "AMOUNT", "abc", "DEGRADE_RATE", 1.0, "INTERVAL", "60min"));
+
+        Assert.Equal(before + 1, await GetParseErrors());
+    }
+
+    private async Task<long> GetParseErrors()
+    {
+        var info = (string)(await _redis.ExecuteAsync("INFO", "modules"))!;
+
+        var line = info.Split('\n').Single(l => l.Contains("parse_errors:"));
+
+        return long.Parse(line.Split(':')[1].Trim());
+    }
+}
@@ -0,0 +1,116 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class LeaderboardTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItRanksMembersHighestFirst()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "low", "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "high", "AMOUNT", 30.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "middle", "AMOUNT", 20.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        var range = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.LeaderboardRange, testKey, 0, -1))!;
+        var rank = await _redis.ExecuteAsync(ModuleCommand.LeaderboardRank, testKey, "middle");
+
+        Assert.Equal(new[] { "high", "middle", "low" }, range.Select(r => (string)r!).ToArray());
+        Assert.Equal(1, (long)rank);
+    }
+
+    [Fact]
+    public async Task ItAddsToAnExistingMember()
+    {
+        var testKey = CreateTestKey();
+        var firstAmount = GetRandomDouble(1.0, 100.0);
+        var secondAmount = GetRandomDouble(1.0, 100.0);
+
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "member", "AMOUNT", firstAmount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        var result = await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "member", "AMOUNT", secondAmount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        var score = await _redis.ExecuteAsync(ModuleCommand.LeaderboardScore, testKey, "member");
+
+        Assert.Equal(firstAmount + secondAmount, (double)result, 9);
+        Assert.Equal(firstAmount + secondAmount, (double)score, 9);
+    }
+
+    [Fact]
+    public async Task ItFiltersByCurrentValue()
+    {
+        var testKey = CreateTestKey();
+
+        foreach (var amount in new[] { 5.0, 15.0, 25.0, 35.0 })
+        {
+            await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, $"member{amount}", "AMOUNT", amount, "DECAY", "EXP", "HALFLIFE", "60min");
+        }
+
+        var range = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.LeaderboardRange, testKey, 10, 30, "BYSCORE", "WITHSCORES"))!;
+
+        Assert.Equal(4, range.Length);
+        Assert.Equal("member25", (string)range[0]!);
+        Assert.Equal(25.0, (double)range[1], 3);
+        Assert.Equal("member15", (string)range[2]!);
+    }
+
+    [Fact]
+    public async Task ItDropsMembersThatDecayToZero()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "short", "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms");
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "long", "AMOUNT", 100.0, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms");
+
+        await Task.Delay(300);
+
+        Assert.True((await _redis.ExecuteAsync(ModuleCommand.LeaderboardScore, testKey, "short")).IsNull);
+        Assert.Equal(0, (long)(await _redis.ExecuteAsync(ModuleCommand.LeaderboardRank, testKey, "long")));
+    }
+
+    // DC.ZREM is what replicas get for members the primary dropped.
+    [Fact]
+    public async Task ItRemovesMembersAndTheKeyOnceTheyreAllGone()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "first", "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "second", "AMOUNT", 20.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        Assert.Equal(1, (long)(await _redis.ExecuteAsync(ModuleCommand.LeaderboardRemove, testKey, "first", "missing")));
+        Assert.True((await _redis.ExecuteAsync(ModuleCommand.LeaderboardScore, testKey, "first")).IsNull);
+
+        Assert.Equal(1, (long)(await _redis.ExecuteAsync(ModuleCommand.LeaderboardRemove, testKey, "second")));
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    // DC.ZRESTORE only replays what the primary or the AOF rewrite wrote. A zero interval would have the next read divide
+    // by zero, and nothing we write is ever NaN or infinite.
+    [Theory]
+    [InlineData(0, "1", 0, "5")]
+    [InlineData(7, "1", 60000, "5")]
+    [InlineData(0, "nan", 60000, "5")]
+    [InlineData(0, "1", 60000, "inf")]
+    public async Task ItRejectsARestoreThatDoesntDescribeALeaderboard(long decay, string rate, long interval, string score)
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() =>
+            _redis.ExecuteAsync(ModuleCommand.LeaderboardRestore, testKey, 0, decay, rate, interval, "member", score));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItRejectsTheWrongKeyType()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        await Assert.ThrowsAsync<RedisServerException>(async () =>
+            await _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "member", "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min"));
+    }
+}
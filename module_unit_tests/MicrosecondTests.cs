@@ -0,0 +1,86 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class MicrosecondTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItDegradesWithAnIntervalShorterThanAMillisecond()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 1_000_000.0, "DEGRADE_RATE", 1.0, "INTERVAL", "250us");
+
+        await Task.Delay(TimeSpan.FromMilliseconds(20));
+
+        // Four intervals to the millisecond, so at least 80 of them have gone by.
+        var value = (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey);
+
+        Assert.InRange(value, 0, 1_000_000.0 - 80);
+    }
+
+    [Fact]
+    public async Task ItDescribesAMicrosecondCounterInMicroseconds()
+    {
+        var testKey = CreateTestKey();
+        var before = DateTimeOffset.UtcNow.ToUnixTimeMilliseconds() * 1000;
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 0.5, "INTERVAL", "1500us");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Describe, testKey))!;
+        var description = (RedisResult[])result[0]!;
+
+        Assert.Equal("CREATED_US", (string)description[2]!);
+        // Allow for the container's clock being a little off from ours.
+        Assert.InRange((long)description[3], before - 5_000_000, before + 5_000_000);
+        Assert.Equal("INTERVAL_US", (string)description[8]!);
+        Assert.Equal(1500, (long)description[9]);
+    }
+
+    [Fact]
+    public async Task ItTreatsWholeMillisecondsAsMilliseconds()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DECAY", "EXP", "HALFLIFE", "2000us");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Describe, testKey))!;
+        var description = (RedisResult[])result[0]!;
+
+        Assert.Equal("CREATED", (string)description[2]!);
+        Assert.Equal("HALFLIFE_MS", (string)description[6]!);
+        Assert.Equal(2, (long)description[7]);
+    }
+
+    // Every key in one command is evaluated at the same instant, so two identical counters created together read the same.
+    [Fact]
+    public async Task ItReadsTheClockOncePerCommand()
+    {
+        var firstKey = CreateTestKey();
+        var secondKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.MultiIncrement,
+            firstKey, "AMOUNT", 1_000_000.0, "DEGRADE_RATE", 1.0, "INTERVAL", "1us",
+            secondKey, "AMOUNT", 1_000_000.0, "DEGRADE_RATE", 1.0, "INTERVAL", "1us");
+
+        var values = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.MultiPeek, firstKey, secondKey))!;
+
+        Assert.Equal((double)values[0], (double)values[1]);
+    }
+
+    [Fact]
+    public async Task ItRejectsMicrosecondsWhereTheyCantBeStored()
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Profile, "SET", CreateTestKey(), "DEGRADE_RATE", 1.0, "INTERVAL", "250us"));
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.HashIncrement, testKey, "field", "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "250us"));
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.LeaderboardIncrement, testKey, "member", "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "250us"));
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", 1.0, "WINDOW", "250us", "BUCKETS", 1));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+}
@@ -5,4 +5,31 @@ public static class ModuleCommand
     public const string Increment = "DC.INCR";
     public const string Decrement = "DC.DECR";
     public const string Peek = "DC.PEEK";
+    public const string MultiIncrement = "DC.MINCR";
+    public const string MultiPeek = "DC.MPEEK";
+    public const string WindowIncrement = "DC.WINCR";
+    public const string WindowPeek = "DC.WPEEK";
+    public const string WindowRestore = "DC.WRESTORE";
+    public const string LeaderboardIncrement = "DC.ZINCR";
+    public const string LeaderboardScore = "DC.ZSCORE";
+    public const string LeaderboardRank = "DC.ZRANK";
+    public const string LeaderboardRange = "DC.ZRANGE";
+    public const string LeaderboardRemove = "DC.ZREM";
+    public const string LeaderboardRestore = "DC.ZRESTORE";
+    public const string HashIncrement = "DC.HINCR";
+    public const string HashPeek = "DC.HPEEK";
+    public const string HashGetAll = "DC.HGETALL";
+    public const string HashDelete = "DC.HDEL";
+    public const string HashRestore = "DC.HRESTORE";
+    public const string Sum = "DC.SUM";
+    public const string CountAbove = "DC.COUNTABOVE";
+    public const string Profile = "DC.PROFILE";
+    public const string Restore = "DC.RESTORE";
+    public const string Describe = "DC.DESCRIBE";
+    public const string Watch = "DC.WATCH";
+    public const string Allow = "DC.ALLOW";
+    public const string SketchIncrement = "DC.CMS.INCR";
+    public const string SketchQuery = "DC.CMS.QUERY";
+    public const string Export = "DC.EXPORT";
+    public const string Import = "DC.IMPORT";
 }
\ No newline at end of file
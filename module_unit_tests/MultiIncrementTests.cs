@@ -0,0 +1,56 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class MultiIncrementTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItCanIncrementSeveralCountersAtOnce()
+    {
+        var firstKey = CreateTestKey();
+        var secondKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, firstKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.MultiIncrement,
+            firstKey, "AMOUNT", 5.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min",
+            secondKey, "AMOUNT", 7.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min"))!;
+
+        Assert.Equal(2, result.Length);
+        Assert.Equal(15.0, (double)result[0]);
+        Assert.Equal(7.0, (double)result[1]);
+    }
+
+    [Fact]
+    public async Task ItReportsWrongTypeForASingleKey()
+    {
+        var counterKey = CreateTestKey();
+        var stringKey = CreateTestKey();
+
+        await _redis.StringSetAsync(stringKey, "not a counter");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.MultiIncrement,
+            stringKey, "AMOUNT", 5.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min",
+            counterKey, "AMOUNT", 3.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min"))!;
+
+        Assert.Equal(ResultType.Error, result[0].Resp2Type);
+        Assert.Equal(3.0, (double)result[1]);
+    }
+
+    [Fact]
+    public async Task ItDoesNotTouchAnyKeyWhenAnArgumentIsInvalid()
+    {
+        var firstKey = CreateTestKey();
+        var secondKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.MultiIncrement,
+            firstKey, "AMOUNT", 5.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min",
+            secondKey, "AMOUNT", 3.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60years"));
+
+        Assert.False(await _redis.KeyExistsAsync(firstKey));
+        Assert.False(await _redis.KeyExistsAsync(secondKey));
+    }
+}
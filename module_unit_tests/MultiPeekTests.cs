@@ -0,0 +1,43 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class MultiPeekTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItCanGetSeveralCounterValues()
+    {
+        var firstAmount = GetRandomDouble(1.0, 100.0);
+        var secondAmount = GetRandomDouble(1.0, 100.0);
+
+        var firstKey = CreateTestKey();
+        var secondKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, firstKey, "AMOUNT", firstAmount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Increment, secondKey, "AMOUNT", secondAmount, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.MultiPeek, firstKey, secondKey))!;
+
+        Assert.Equal(firstAmount, (double)result[0]);
+        Assert.Equal(secondAmount, (double)result[1]);
+    }
+
+    [Fact]
+    public async Task ItReturnsNullAndErrorsPerKey()
+    {
+        var counterKey = CreateTestKey();
+        var stringKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, counterKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.StringSetAsync(stringKey, "not a counter");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.MultiPeek, counterKey, "whatever_this_is_it_doesnt_exist", stringKey))!;
+
+        Assert.Equal(10.0, (double)result[0]);
+        Assert.True(result[1].IsNull);
+        Assert.Equal(ResultType.Error, result[2].Resp2Type);
+    }
+}
@@ -1,3 +1,4 @@
+using System.Globalization;
 using StackExchange.Redis;
 
 namespace module_unit_tests;
@@ -22,6 +23,20 @@ public class PeekTests(RedisContainerFixture redisFixture)
         Assert.Equal(amount, peekedResult);
     }
 
+    // EVAL_RO only allows read-only commands, the same restriction a replica serving reads puts on DC.PEEK.
+    [Fact]
+    public async Task ItCanBeCalledFromAReadOnlyScript()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 12.5, "DEGRADE_RATE", 1.0, "INTERVAL",
+            "60min");
+
+        var peekedResult = await _redis.ExecuteAsync("EVAL_RO", "return redis.call('DC.PEEK', KEYS[1])", 1, testKey);
+
+        Assert.Equal(12.5, double.Parse(peekedResult.ToString()!, CultureInfo.InvariantCulture));
+    }
+
     [Fact]
     public async Task ItWillReturnNullIfANonExistentKey()
     {
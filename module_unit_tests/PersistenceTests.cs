@@ -0,0 +1,113 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class PersistenceTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    public static IEnumerable<object[]> Counters =>
+    [
+        [new object[] { "AMOUNT", 42, "DEGRADE_RATE", 1, "INTERVAL", "60min" }],
+        [new object[] { "AMOUNT", 12.345, "DEGRADE_RATE", 0.25, "INTERVAL", "5min" }],
+        [new object[] { "AMOUNT", 1000.5, "DECAY", "EXP", "HALFLIFE", "60min" }]
+    ];
+
+    // DUMP and RESTORE go through the same record the RDB file uses.
+    [Theory]
+    [MemberData(nameof(Counters))]
+    public async Task ItRoundTripsACounterThroughDumpAndRestore(object[] arguments)
+    {
+        var testKey = CreateTestKey();
+        var restoredKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, new object[] { testKey }.Concat(arguments).ToArray());
+
+        var dump = await _redis.KeyDumpAsync(testKey);
+        await _redis.KeyRestoreAsync(restoredKey, dump!);
+
+        var original = (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey);
+        var restored = (double)await _redis.ExecuteAsync(ModuleCommand.Peek, restoredKey);
+
+        Assert.Equal(original, restored, 3);
+    }
+
+    [Fact]
+    public async Task ItRoundTripsACounterCreatedFromAProfile()
+    {
+        var profile = CreateTestKey();
+        var testKey = CreateTestKey();
+        var restoredKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, 25.0, "PROFILE", profile);
+
+        var dump = await _redis.KeyDumpAsync(testKey);
+        await _redis.KeyRestoreAsync(restoredKey, dump!);
+
+        Assert.Equal(25.0, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, restoredKey));
+        // The restored counter keeps the profile's configuration, so the short form works on it.
+        Assert.Equal(26.0, (double)await _redis.ExecuteAsync(ModuleCommand.Increment, restoredKey, 1.0));
+    }
+
+    // Profile ids are handed out by each node, so a counter moved with DUMP and RESTORE (or MIGRATE) can't refer to its
+    // profile by id. On the other node the same id belongs to a profile with another configuration.
+    [Fact]
+    public async Task ItRoundTripsACounterCreatedFromAProfileToAnotherNode()
+    {
+        var profile = CreateTestKey();
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, 25.0, "PROFILE", profile);
+
+        var dump = await _redis.KeyDumpAsync(testKey);
+
+        var container = RedisContainerFixture.CreateContainer("degrading_counter_tests_target");
+        await container.StartAsync();
+
+        try
+        {
+            await using var connection = await ConnectionMultiplexer.ConnectAsync(container.GetConnectionString());
+            var target = connection.GetDatabase();
+
+            await target.ExecuteAsync(ModuleCommand.Profile, "SET", CreateTestKey(), "DEGRADE_RATE", 5.0, "INTERVAL", "1sec");
+            await target.KeyRestoreAsync(testKey, dump!);
+
+            var description = (RedisResult[])((RedisResult[])(await target.ExecuteAsync(ModuleCommand.Describe, testKey))!)[0]!;
+
+            Assert.Equal(25.0, (double)await target.ExecuteAsync(ModuleCommand.Peek, testKey));
+            Assert.Equal(1.0, (double)description[7]);
+            Assert.Equal(3600000, (long)description[9]);
+        }
+        finally
+        {
+            await container.StopAsync();
+            await container.DisposeAsync();
+        }
+    }
+
+    // DC.RESTORE is only meant to replay what the AOF rewrite or the primary wrote, anything else is turned away without touching the key.
+    [Fact]
+    public async Task ItRejectsARestoreWithAnInvalidRecord()
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Restore, testKey, "garbage"));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItRejectsARestoreWithAValueThatIsntFinite()
+    {
+        var testKey = CreateTestKey();
+        // Seconds with an integer rate, one second per increment, created at the epoch, a NaN value and a rate of one.
+        var record = new byte[] { 0x41, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x7F, 0x01 };
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Restore, testKey, record));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+}
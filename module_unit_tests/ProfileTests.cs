@@ -0,0 +1,90 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class ProfileTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItCanCreateACounterFromAProfile()
+    {
+        // Profiles are shared by the whole server, so every test uses a name of its own.
+        var profile = CreateTestKey();
+        var testKey = CreateTestKey();
+        var amount = GetRandomDouble(1.0, 100.0);
+
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        var result = await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, amount, "PROFILE", profile);
+
+        Assert.Equal(amount, (double)result);
+        Assert.Equal(amount, (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey));
+    }
+
+    [Fact]
+    public async Task ItWillAccumulateWithTheShortForm()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, 5.0);
+
+        var result = await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, 2.5);
+
+        Assert.Equal(17.5, (double)result);
+    }
+
+    [Fact]
+    public async Task ItDegradesACounterCreatedFromAProfile()
+    {
+        var profile = CreateTestKey();
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 1.0, "INTERVAL", "1sec");
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, 10.0, "PROFILE", profile);
+
+        await Task.Delay(2500);
+
+        var result = (double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey);
+
+        Assert.InRange(result, 7.0, 8.0);
+    }
+
+    [Fact]
+    public async Task ItRejectsTheShortFormForAMissingCounterWithoutAProfile()
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Increment, testKey, 1.0));
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Increment, testKey, 1.0, "PROFILE", CreateTestKey()));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItReturnsTheProfileConfiguration()
+    {
+        var profile = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DECAY", "EXP", "HALFLIFE", "5min");
+
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.Profile, "GET", profile))!;
+
+        Assert.Equal(new[] { "DECAY", "EXP", "HALFLIFE", "5min" }, result.Select(r => r.ToString()));
+        Assert.True((await _redis.ExecuteAsync(ModuleCommand.Profile, "GET", CreateTestKey())).IsNull);
+    }
+
+    [Fact]
+    public async Task ItOnlyAcceptsTheSameConfigurationForAnExistingProfile()
+    {
+        var profile = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 1.0, "INTERVAL", "5sec");
+        await _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 1.0, "INTERVAL", "5sec");
+
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Profile, "SET", profile, "DEGRADE_RATE", 2.0, "INTERVAL", "5sec"));
+        await Assert.ThrowsAsync<RedisServerException>(() => _redis.ExecuteAsync(ModuleCommand.Profile, "SET", CreateTestKey(), "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "5sec"));
+    }
+}
@@ -7,9 +7,14 @@ namespace module_unit_tests;
 // ReSharper disable once ClassNeverInstantiated.Global
 public class RedisContainerFixture : IAsyncLifetime
 {
-    private readonly RedisContainer _redisContainer = new RedisBuilder()
+    private readonly RedisContainer _redisContainer = CreateContainer("degrading_counter_tests");
+    
+    public ConnectionMultiplexer? Redis { get; private set; }
+
+    // A server with the module loaded. Tests that need a second node (moving keys between them) start their own.
+    public static RedisContainer CreateContainer(string name) => new RedisBuilder()
         .WithImage("redis:7.0")
-        .WithName("degrading_counter_tests")
+        .WithName(name)
         .WithBindMount(AppContext.BaseDirectory, "/module_unit_tests")
 
         .WithCommand(
@@ -22,8 +27,6 @@ public class RedisContainerFixture : IAsyncLifetime
             .UntilCommandIsCompleted("redis-cli", "PING")
         )
         .Build();
-    
-    public ConnectionMultiplexer? Redis { get; private set; }
 
     public async Task InitializeAsync()
     {
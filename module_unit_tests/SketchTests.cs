@@ -0,0 +1,97 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class SketchTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItCountsEveryItemInABatch()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.SketchIncrement, testKey, "WIDTH", 2048, "DEPTH", 4, "DEGRADE_RATE", 1.0, "INTERVAL", "60min",
+            "ITEMS", "first", 10.0, "second", 5.0);
+        var result = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.SketchIncrement, testKey, "WIDTH", 2048, "DEPTH", 4, "DEGRADE_RATE", 1.0, "INTERVAL", "60min",
+            "ITEMS", "first", 1.0))!;
+        var queried = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.SketchQuery, testKey, "first", "second", "third"))!;
+
+        Assert.Equal(11.0, (double)result[0]);
+        Assert.Equal(11.0, (double)queried[0]);
+        Assert.Equal(5.0, (double)queried[1]);
+        Assert.Equal(0.0, (double)queried[2]);
+    }
+
+    [Fact]
+    public async Task ItDecaysTheCells()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.SketchIncrement, testKey, "WIDTH", 64, "DEPTH", 2, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms",
+            "ITEMS", "item", 5.0);
+        await Task.Delay(250);
+        var queried = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.SketchQuery, testKey, "item"))!;
+
+        Assert.Equal(3.0, (double)queried[0]);
+    }
+
+    [Fact]
+    public async Task ItExpiresOnceEveryCellReachesZero()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.SketchIncrement, testKey, "WIDTH", 2048, "DEPTH", 2, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms",
+            "ITEMS", "short", 1.0, "long", 3.0);
+
+        var timeToLive = await _redis.KeyTimeToLiveAsync(testKey);
+
+        Assert.NotNull(timeToLive);
+        Assert.True(timeToLive.Value <= TimeSpan.FromMilliseconds(300));
+        Assert.True(timeToLive.Value > TimeSpan.FromMilliseconds(100));
+    }
+
+    // DUMP and RESTORE go through the same record the RDB file uses.
+    [Fact]
+    public async Task ItRoundTripsThroughDumpAndRestore()
+    {
+        var testKey = CreateTestKey();
+        var restoredKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.SketchIncrement, testKey, "WIDTH", 512, "DEPTH", 3, "DECAY", "EXP", "HALFLIFE", "60min",
+            "ITEMS", "first", 100.0, "second", 50.0);
+
+        var dump = await _redis.KeyDumpAsync(testKey);
+        await _redis.KeyRestoreAsync(restoredKey, dump!);
+
+        var original = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.SketchQuery, testKey, "first", "second"))!;
+        var restored = (RedisResult[])(await _redis.ExecuteAsync(ModuleCommand.SketchQuery, restoredKey, "first", "second"))!;
+
+        Assert.Equal((double)original[0], (double)restored[0], 3);
+        Assert.Equal((double)original[1], (double)restored[1], 3);
+    }
+
+    [Fact]
+    public async Task ItRejectsNegativeAmountsWithoutCountingTheBatch()
+    {
+        var testKey = CreateTestKey();
+
+        await Assert.ThrowsAsync<RedisServerException>(async () =>
+            await _redis.ExecuteAsync(ModuleCommand.SketchIncrement, testKey, "WIDTH", 64, "DEPTH", 2, "DEGRADE_RATE", 1.0, "INTERVAL", "60min",
+                "ITEMS", "first", 1.0, "second", -1.0));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItRejectsTheWrongKeyType()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        await Assert.ThrowsAsync<RedisServerException>(async () =>
+            await _redis.ExecuteAsync(ModuleCommand.SketchQuery, testKey, "item"));
+    }
+}
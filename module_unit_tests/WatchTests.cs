@@ -0,0 +1,124 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class WatchTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItPublishesWhenTheCounterDecaysBelowTheThreshold()
+    {
+        var testKey = CreateTestKey();
+        var channel = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 3.0, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms");
+
+        var published = await SubscribeAsync(channel);
+        var firesAt = (long)await _redis.ExecuteAsync(ModuleCommand.Watch, testKey, "BELOW", 2.0, "CHANNEL", channel);
+
+        Assert.True(firesAt > 0);
+        Assert.Equal(testKey, await published.WaitAsync(TimeSpan.FromSeconds(5)));
+        Assert.True((double)await _redis.ExecuteAsync(ModuleCommand.Peek, testKey) < 2.0);
+    }
+
+    // The watch has to move when a write changes where the counter is headed.
+    [Fact]
+    public async Task ItPublishesRightAwayWhenADecrementCrossesTheThreshold()
+    {
+        var testKey = CreateTestKey();
+        var channel = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        var published = await SubscribeAsync(channel);
+        await _redis.ExecuteAsync(ModuleCommand.Watch, testKey, "BELOW", 5.0, "CHANNEL", channel);
+        await _redis.ExecuteAsync(ModuleCommand.Decrement, testKey, 6.0);
+
+        Assert.Equal(testKey, await published.WaitAsync(TimeSpan.FromSeconds(5)));
+    }
+
+    [Fact]
+    public async Task ItRepliesWithZeroWhenTheCounterIsAlreadyBelow()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 1.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        Assert.Equal(0, (long)await _redis.ExecuteAsync(ModuleCommand.Watch, testKey, "BELOW", 5.0, "CHANNEL", "unused"));
+    }
+
+    [Fact]
+    public async Task ItRepliesWithMinusOneWhenTheCounterNeverGetsThere()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 0.0, "INTERVAL", "1sec");
+
+        Assert.Equal(-1, (long)await _redis.ExecuteAsync(ModuleCommand.Watch, testKey, "BELOW", 5.0, "CHANNEL", "unused"));
+    }
+
+    [Fact]
+    public async Task ItRepliesWithMinusOneForAThresholdOfZero()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "1sec");
+
+        Assert.Equal(-1, (long)await _redis.ExecuteAsync(ModuleCommand.Watch, testKey, "BELOW", 0.0, "CHANNEL", "unused"));
+    }
+
+    // Deleting the key, or putting something else in its place, drops its watches without publishing.
+    [Fact]
+    public async Task ItDropsTheWatchWhenTheKeyIsDeleted()
+    {
+        var testKey = CreateTestKey();
+        var channel = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 3.0, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms");
+
+        var published = await SubscribeAsync(channel);
+        await _redis.ExecuteAsync(ModuleCommand.Watch, testKey, "BELOW", 2.0, "CHANNEL", channel);
+        await _redis.KeyDeleteAsync(testKey);
+
+        await Task.Delay(500);
+
+        Assert.False(published.IsCompleted);
+    }
+
+    [Fact]
+    public async Task ItDropsTheWatchWhenTheKeyIsOverwritten()
+    {
+        var testKey = CreateTestKey();
+        var channel = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 3.0, "DEGRADE_RATE", 1.0, "INTERVAL", "100ms");
+
+        var published = await SubscribeAsync(channel);
+        await _redis.ExecuteAsync(ModuleCommand.Watch, testKey, "BELOW", 2.0, "CHANNEL", channel);
+        await _redis.StringSetAsync(testKey, "something else");
+
+        await Task.Delay(500);
+
+        Assert.False(published.IsCompleted);
+    }
+
+    [Fact]
+    public async Task ItReturnsNullForAMissingKey()
+    {
+        var result = await _redis.ExecuteAsync(ModuleCommand.Watch, "whatever_this_is_it_doesnt_exist", "BELOW", 5.0, "CHANNEL", "unused");
+
+        Assert.True(result.IsNull);
+    }
+
+    private async Task<Task<string>> SubscribeAsync(string channel)
+    {
+        var published = new TaskCompletionSource<string>();
+
+        await redisFixture.Redis!.GetSubscriber().SubscribeAsync(RedisChannel.Literal(channel),
+            (_, message) => published.TrySetResult(message!));
+
+        return published.Task;
+    }
+}
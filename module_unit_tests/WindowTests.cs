@@ -0,0 +1,113 @@
+using StackExchange.Redis;
+
+namespace module_unit_tests;
+
+[Collection("Module Test Collection")]
+public class WindowTests(RedisContainerFixture redisFixture)
+{
+    private readonly IDatabase _redis = redisFixture.Redis!.GetDatabase();
+
+    [Fact]
+    public async Task ItSumsTheIncrementsInTheWindow()
+    {
+        var testKey = CreateTestKey();
+        var firstAmount = GetRandomDouble(1.0, 100.0);
+        var secondAmount = GetRandomDouble(1.0, 100.0);
+
+        await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", firstAmount, "WINDOW", "60min", "BUCKETS", 60);
+        var result = await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", secondAmount, "WINDOW", "60min", "BUCKETS", 60);
+        var peeked = await _redis.ExecuteAsync(ModuleCommand.WindowPeek, testKey);
+
+        Assert.Equal(firstAmount + secondAmount, (double)result, 9);
+        Assert.Equal(firstAmount + secondAmount, (double)peeked, 9);
+    }
+
+    [Fact]
+    public async Task ItForgetsIncrementsThatLeftTheWindow()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", 10.0, "WINDOW", "1sec", "BUCKETS", 10);
+        await Task.Delay(1500);
+        var result = await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", 1.0, "WINDOW", "1sec", "BUCKETS", 10);
+
+        Assert.Equal(1.0, (double)result);
+    }
+
+    [Fact]
+    public async Task ItLeavesOutIncrementsThatLeftTheWindowWhenPeeking()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", 10.0, "WINDOW", "2sec", "BUCKETS", 20);
+        await Task.Delay(1000);
+        await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", 1.0, "WINDOW", "2sec", "BUCKETS", 20);
+        await Task.Delay(1200);
+
+        Assert.Equal(1.0, (double)await _redis.ExecuteAsync(ModuleCommand.WindowPeek, testKey), 9);
+    }
+
+    // Peeking doesn't write, so it's allowed where only reads are (read-only scripts and replicas).
+    [Fact]
+    public async Task ItCanBePeekedFromAReadOnlyScript()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", 5.0, "WINDOW", "60min", "BUCKETS", 60);
+
+        var result = await _redis.ExecuteAsync("EVAL_RO", "return redis.call('DC.WPEEK', KEYS[1])", 1, testKey);
+
+        Assert.Equal(5.0, (double)result);
+    }
+
+    [Fact]
+    public async Task ItExpiresOnceTheWindowIsEmpty()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, testKey, "AMOUNT", 10.0, "WINDOW", "500ms", "BUCKETS", 5);
+
+        var timeToLive = await _redis.KeyTimeToLiveAsync(testKey);
+
+        Assert.NotNull(timeToLive);
+        Assert.True(timeToLive.Value <= TimeSpan.FromMilliseconds(500));
+
+        await Task.Delay(700);
+
+        Assert.True((await _redis.ExecuteAsync(ModuleCommand.WindowPeek, testKey)).IsNull);
+    }
+
+    [Fact]
+    public async Task ItRejectsAWindowThatDoesntSplitIntoBuckets()
+    {
+        await Assert.ThrowsAsync<RedisServerException>(async () =>
+            await _redis.ExecuteAsync(ModuleCommand.WindowIncrement, CreateTestKey(), "AMOUNT", 1.0, "WINDOW", "10ms", "BUCKETS", 3));
+    }
+
+    // DC.WRESTORE only replays what the primary or the AOF rewrite wrote, a shape DC.WINCR couldn't have created (a slot
+    // before the epoch, a bucket wider than the longest interval) is turned away without touching the key.
+    [Theory]
+    [InlineData(1000L, -5L)]
+    [InlineData(1000000000000000L, 0L)]
+    public async Task ItRejectsARestoreWithAShapeItCouldntHaveCreated(long bucketWidth, long lastSlot)
+    {
+        var testKey = CreateTestKey();
+        var buckets = new byte[4 * sizeof(double)];
+
+        await Assert.ThrowsAsync<RedisServerException>(() =>
+            _redis.ExecuteAsync(ModuleCommand.WindowRestore, testKey, bucketWidth, lastSlot, 4, buckets));
+
+        Assert.False(await _redis.KeyExistsAsync(testKey));
+    }
+
+    [Fact]
+    public async Task ItRejectsTheWrongKeyType()
+    {
+        var testKey = CreateTestKey();
+
+        await _redis.ExecuteAsync(ModuleCommand.Increment, testKey, "AMOUNT", 10.0, "DEGRADE_RATE", 1.0, "INTERVAL", "60min");
+
+        await Assert.ThrowsAsync<RedisServerException>(async () =>
+            await _redis.ExecuteAsync(ModuleCommand.WindowPeek, testKey));
+    }
+}
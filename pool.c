@@ -0,0 +1,320 @@
+#include "pool.h"
+#include "redismodule.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+// A slab is one contiguous allocation of `objects_per_slab` slots. Freed slots are threaded into a per slab free list
+// using the first bytes of the slot itself, so there is no per object bookkeeping at all.
+typedef struct PoolSlab {
+    char *slots; // Start of the slot storage, slabs are kept sorted by this address.
+    void *free_list; // Slots in this slab that have been returned to the pool.
+    size_t next_unused; // Index of the first slot that has never been handed out.
+    size_t in_use; // How many slots are currently handed out.
+    struct PoolSlab *next_partial; // Links the slabs that still have room for another object.
+    struct PoolSlab *prev_partial;
+    int is_partial;
+} PoolSlab;
+
+struct Pool {
+    size_t object_size;
+    size_t objects_per_slab;
+    PoolSlab **slabs; // Every slab we own, sorted by address so `pool_free` can find the owner with a binary search.
+    size_t slab_count;
+    size_t slab_capacity;
+    PoolSlab *partial; // Slabs with at least one free slot.
+    PoolSlab *defrag_target; // The partial slab `pool_defrag` last moved objects into, NULL once it fills up or goes.
+    size_t objects_in_use;
+    // Values can be freed off the main thread (e.g. FLUSHALL ASYNC), so every operation takes this lock. It's
+    // uncontended in practice.
+    pthread_mutex_t lock;
+};
+
+static void pool_partial_push(Pool *pool, PoolSlab *slab) {
+    slab->prev_partial = NULL;
+    slab->next_partial = pool->partial;
+
+    if (pool->partial != NULL) {
+        pool->partial->prev_partial = slab;
+    }
+
+    pool->partial = slab;
+    slab->is_partial = 1;
+}
+
+static void pool_partial_remove(Pool *pool, PoolSlab *slab) {
+    if (slab->prev_partial != NULL) {
+        slab->prev_partial->next_partial = slab->next_partial;
+    } else {
+        pool->partial = slab->next_partial;
+    }
+
+    if (slab->next_partial != NULL) {
+        slab->next_partial->prev_partial = slab->prev_partial;
+    }
+
+    slab->next_partial = NULL;
+    slab->prev_partial = NULL;
+    slab->is_partial = 0;
+
+    if (pool->defrag_target == slab) {
+        pool->defrag_target = NULL;
+    }
+}
+
+// Find the position of the first slab whose storage starts after `address`.
+static size_t pool_slab_upper_bound(const Pool *pool, const char *address) {
+    size_t low = 0;
+    size_t high = pool->slab_count;
+
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+
+        if ((uintptr_t)pool->slabs[middle]->slots <= (uintptr_t)address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static PoolSlab *pool_add_slab(Pool *pool) {
+    if (pool->slab_count == pool->slab_capacity) {
+        pool->slab_capacity = pool->slab_capacity == 0 ? 16 : pool->slab_capacity * 2;
+        pool->slabs = RedisModule_Realloc(pool->slabs, sizeof(PoolSlab*) * pool->slab_capacity);
+    }
+
+    PoolSlab *slab = RedisModule_Calloc(1, sizeof(PoolSlab));
+    slab->slots = RedisModule_Alloc(pool->object_size * pool->objects_per_slab);
+
+    // Keep the slab list sorted.
+    const size_t position = pool_slab_upper_bound(pool, slab->slots);
+    memmove(&pool->slabs[position + 1], &pool->slabs[position], sizeof(PoolSlab*) * (pool->slab_count - position));
+    pool->slabs[position] = slab;
+    pool->slab_count++;
+
+    pool_partial_push(pool, slab);
+
+    return slab;
+}
+
+static void pool_remove_slab(Pool *pool, const size_t position) {
+    PoolSlab *slab = pool->slabs[position];
+
+    if (slab->is_partial) {
+        pool_partial_remove(pool, slab);
+    }
+
+    memmove(&pool->slabs[position], &pool->slabs[position + 1], sizeof(PoolSlab*) * (pool->slab_count - position - 1));
+    pool->slab_count--;
+
+    RedisModule_Free(slab->slots);
+    RedisModule_Free(slab);
+}
+
+Pool *pool_create(size_t object_size, const size_t objects_per_slab) {
+    // Free slots store a pointer to the next free slot, so a slot has to be at least that big and stay pointer aligned.
+    if (object_size < sizeof(void*)) {
+        object_size = sizeof(void*);
+    }
+
+    object_size = (object_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    Pool *pool = RedisModule_Calloc(1, sizeof(Pool));
+    pool->object_size = object_size;
+    pool->objects_per_slab = objects_per_slab;
+    pthread_mutex_init(&pool->lock, NULL);
+
+    return pool;
+}
+
+void pool_destroy(Pool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < pool->slab_count; i++) {
+        RedisModule_Free(pool->slabs[i]->slots);
+        RedisModule_Free(pool->slabs[i]);
+    }
+
+    RedisModule_Free(pool->slabs);
+    pthread_mutex_destroy(&pool->lock);
+    RedisModule_Free(pool);
+}
+
+// Hand out a slot from a slab that has room. Expects the lock to be held.
+static void *pool_take_slot(Pool *pool, PoolSlab *slab) {
+    void *object;
+
+    // Prefer recycled slots, they're more likely to still be in cache.
+    if (slab->free_list != NULL) {
+        object = slab->free_list;
+        slab->free_list = *(void**)object;
+    } else {
+        object = slab->slots + (slab->next_unused * pool->object_size);
+        slab->next_unused++;
+    }
+
+    slab->in_use++;
+    pool->objects_in_use++;
+
+    if (slab->free_list == NULL && slab->next_unused == pool->objects_per_slab) {
+        pool_partial_remove(pool, slab);
+    }
+
+    return object;
+}
+
+// Put a slot back into the slab at `position`. Expects the lock to be held.
+static void pool_release_slot(Pool *pool, const size_t position, void *object) {
+    PoolSlab *slab = pool->slabs[position];
+
+    *(void**)object = slab->free_list;
+    slab->free_list = object;
+    slab->in_use--;
+    pool->objects_in_use--;
+
+    if (slab->in_use == 0 && pool->slab_count > 1) {
+        // Nothing left in this slab, give the memory back. We always hang on to the last slab so that a counter being
+        // created and deleted over and over doesn't allocate and free a whole slab each time.
+        pool_remove_slab(pool, position);
+    } else if (!slab->is_partial) {
+        pool_partial_push(pool, slab);
+    }
+}
+
+// The owning slab is the last one that starts at or before the object.
+static size_t pool_slab_position(const Pool *pool, const void *object) {
+    return pool_slab_upper_bound(pool, object) - 1;
+}
+
+void *pool_alloc(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+
+    void *object = pool_take_slot(pool, pool->partial != NULL ? pool->partial : pool_add_slab(pool));
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return object;
+}
+
+void pool_free(Pool *pool, void *object) {
+    if (object == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool_release_slot(pool, pool_slab_position(pool, object), object);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Find a partial slab at least as full as `source` to move objects into. The last one we picked is reused for as long as it
+// has room, so draining a sparse slab doesn't walk the partial list for every object in it.
+static PoolSlab *pool_defrag_target(Pool *pool, const PoolSlab *source) {
+    PoolSlab *target = pool->defrag_target;
+
+    if (target != NULL && target != source && target->in_use >= source->in_use) {
+        return target;
+    }
+
+    target = NULL;
+
+    for (PoolSlab *slab = pool->partial; slab != NULL; slab = slab->next_partial) {
+        if (slab != source && slab->in_use >= source->in_use && (target == NULL || slab->in_use > target->in_use)) {
+            target = slab;
+        }
+    }
+
+    pool->defrag_target = target;
+
+    return target;
+}
+
+void *pool_defrag(Pool *pool, void *object) {
+    pthread_mutex_lock(&pool->lock);
+
+    const size_t position = pool_slab_position(pool, object);
+    const PoolSlab *slab = pool->slabs[position];
+    void *moved = NULL;
+
+    // Only objects in slabs that are no fuller than the pool's average get moved. Anything fuller is where we want
+    // objects to end up, and moving out of it would just make room that the next allocations fill again. Every move
+    // goes from a slab into one that's at least as full, so evenly sparse slabs still pull apart and nothing ping-pongs.
+    if (slab->in_use * pool->slab_count <= pool->objects_in_use) {
+        PoolSlab *target = pool_defrag_target(pool, slab);
+
+        if (target != NULL) {
+            // Taking a slot from a slab that already exists doesn't move any slab around, so `position` still holds.
+            moved = pool_take_slot(pool, target);
+            memcpy(moved, object, pool->object_size);
+            pool_release_slot(pool, position, object);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return moved;
+}
+
+void pool_defrag_bookkeeping(Pool *pool, struct RedisModuleDefragCtx *ctx) {
+    pthread_mutex_lock(&pool->lock);
+
+    PoolSlab **slabs = RedisModule_DefragAlloc(ctx, pool->slabs);
+
+    if (slabs != NULL) {
+        pool->slabs = slabs;
+    }
+
+    // The slot storage stays put (counters point into it), but the small slab headers can move as long as the partial
+    // list and the cached target follow them.
+    for (size_t i = 0; i < pool->slab_count; i++) {
+        PoolSlab *old_slab = pool->slabs[i];
+        PoolSlab *slab = RedisModule_DefragAlloc(ctx, old_slab);
+
+        if (slab == NULL) {
+            continue;
+        }
+
+        pool->slabs[i] = slab;
+
+        if (slab->prev_partial != NULL) {
+            slab->prev_partial->next_partial = slab;
+        } else if (pool->partial == old_slab) {
+            pool->partial = slab;
+        }
+
+        if (slab->next_partial != NULL) {
+            slab->next_partial->prev_partial = slab;
+        }
+
+        if (pool->defrag_target == old_slab) {
+            pool->defrag_target = slab;
+        }
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t pool_object_size(const Pool *pool) {
+    return pool->object_size;
+}
+
+size_t pool_objects_in_use(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    const size_t objects_in_use = pool->objects_in_use;
+    pthread_mutex_unlock(&pool->lock);
+
+    return objects_in_use;
+}
+
+size_t pool_allocated_bytes(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    const size_t allocated_bytes = pool->slab_count * (pool->object_size * pool->objects_per_slab + sizeof(PoolSlab)) +
+                                   pool->slab_capacity * sizeof(PoolSlab*);
+    pthread_mutex_unlock(&pool->lock);
+
+    return allocated_bytes;
+}
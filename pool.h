@@ -0,0 +1,41 @@
+#ifndef DEGRADING_COUNTER_POOL_H
+#define DEGRADING_COUNTER_POOL_H
+
+#include <stddef.h>
+
+// A fixed size object pool. Objects are carved out of large slabs so that we don't pay the allocator's size class
+// rounding (and, depending on how Redis was built, a per allocation header) for every single counter. Slabs that become
+// completely empty are handed back to Redis.
+typedef struct Pool Pool;
+
+// Create a pool handing out objects of `object_size` bytes, `objects_per_slab` at a time.
+Pool *pool_create(size_t object_size, size_t objects_per_slab);
+
+// Release the pool and every slab it owns. Any objects still handed out become invalid.
+void pool_destroy(Pool *pool);
+
+// Get an object from the pool. The memory isn't initialized.
+void *pool_alloc(Pool *pool);
+
+// Return an object to the pool. Passing NULL is a no-op.
+void pool_free(Pool *pool, void *object);
+
+// How big is a single object handed out by the pool?
+size_t pool_object_size(const Pool *pool);
+
+// How many objects are currently handed out?
+size_t pool_objects_in_use(Pool *pool);
+
+// How many bytes has the pool requested from Redis, including slots that aren't in use?
+size_t pool_allocated_bytes(Pool *pool);
+
+// Active defrag can't move a single object, they live inside slabs. What it can do is move objects out of sparsely used
+// slabs into fuller ones, so the sparse slabs empty out and get handed back. If `object` is worth moving, it's copied
+// into a fuller slab, its old slot is freed and the new address is returned. Returns NULL if it's fine where it is.
+void *pool_defrag(Pool *pool, void *object);
+
+// Let active defrag move the pool's own bookkeeping (the slab list and slab headers). The slot storage stays put.
+struct RedisModuleDefragCtx;
+void pool_defrag_bookkeeping(Pool *pool, struct RedisModuleDefragCtx *ctx);
+
+#endif
@@ -0,0 +1,644 @@
+#include "redismodule.h"
+#include "module.h"
+#include <string.h>
+#include <math.h>
+
+// A decaying count-min sketch counts how often each of an unbounded number of items has been seen in a fixed amount of
+// memory, at the price of over-counting items that share cells with others. Every cell decays exactly like a hash
+// counter field, with the decay shared by the whole key, so each cell only needs its value and the moment it was last
+// anchored.
+//
+// The cells are a single `depth` x `width` block stored row by row, each cell keeping its value next to its anchor so
+// reading one costs a single cache line. An item maps to one cell per row (double hashing on one 64-bit hash), and its
+// count is the smallest of those cells.
+
+#define SKETCH_TYPE_NAME "DeGrad-CM"
+#define SKETCH_ENCODING_VERSION 0
+
+#define SKETCH_MAX_WIDTH (1 << 24)
+#define SKETCH_MAX_DEPTH 16
+#define SKETCH_MAX_CELLS (1 << 26) // A gigabyte of cells, anything bigger should probably be exact counters after all.
+
+static RedisModuleType *Sketch;
+
+typedef struct SketchCell {
+    double value; // The raw, un-degraded value as of `anchor`.
+    ustime_t anchor; // When the value was last reset (linear) or re-anchored (exponential), Unix microseconds.
+} SketchCell;
+
+// One cell as DC.CMS.INCR left it, replicated so replicas don't redo the decay against their own clock.
+typedef struct SketchCellUpdate {
+    uint64_t index; // Into `cells`.
+    SketchCell cell;
+} SketchCellUpdate;
+
+typedef struct SketchData {
+    double rate; // Linear decay: subtracted every interval. Exponential decay: half-lives per millisecond.
+    long long interval; // Microseconds per interval (linear decay) or the half-life (exponential decay).
+    int decay; // CounterDecay
+    uint32_t width;
+    uint32_t depth;
+    SketchCell cells[]; // Row `r` starts at `cells[r * width]`.
+} SketchData;
+
+static inline size_t sketch_size(const uint32_t width, const uint32_t depth) {
+    return sizeof(SketchData) + (size_t)width * depth * sizeof(SketchCell);
+}
+
+SketchData *sketch_create(const int decay, const double rate, const long long interval, const uint32_t width, const uint32_t depth) {
+    SketchData *sketch = RedisModule_Calloc(1, sketch_size(width, depth));
+
+    sketch->decay = decay;
+    sketch->rate = rate;
+    sketch->interval = interval;
+    sketch->width = width;
+    sketch->depth = depth;
+
+    return sketch;
+}
+
+// FNV-1a with a murmur style finalizer. FNV alone mixes the high bits poorly, and both halves of the hash get used.
+static uint64_t sketch_hash(const char *item, const size_t len) {
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)item[i];
+        hash *= 1099511628211ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+// The index into `cells` of the item's cell in `row`. Rows after the first step through the hash's high half (forced odd
+// so it never stands still), and the 32-bit result is scaled onto the width with a multiply rather than a modulo.
+static inline size_t sketch_cell_index(const SketchData *sketch, const uint64_t hash, const uint32_t row) {
+    const uint32_t mixed = (uint32_t)hash + row * ((uint32_t)(hash >> 32) | 1);
+
+    return (size_t)row * sketch->width + (size_t)(((uint64_t)mixed * sketch->width) >> 32);
+}
+
+// ------- Decay
+
+// The current value of a cell.
+static inline double sketch_cell_value(const SketchData *sketch, const SketchCell *cell, const ustime_t now) {
+    if (sketch->decay == DecayExponential) {
+        return cell->value * exp2(-(double)(now - cell->anchor) / MICROSECONDS_PER_MILLISECOND * sketch->rate);
+    }
+
+    return fmax(0, cell->value - sketch->rate * (double)((now - cell->anchor) / sketch->interval));
+}
+
+// Add `amount` to a cell, with the same semantics as DC.HINCR.
+static inline void sketch_cell_add(const SketchData *sketch, SketchCell *cell, const double amount, const ustime_t now) {
+    const double current = sketch_cell_value(sketch, cell, now);
+
+    if (is_approximately_zero(current, CLOSE_ENOUGH_TO_ZERO) || sketch->decay == DecayExponential) {
+        // A finished cell starts over, and exponential decay re-anchors to now on every increment.
+        cell->value = current + amount;
+        cell->anchor = now;
+    } else {
+        cell->value += amount;
+    }
+}
+
+// The estimated count of the item with `hash`: the smallest of its cells.
+static double sketch_estimate(const SketchData *sketch, const uint64_t hash, const ustime_t now) {
+    double estimate = sketch_cell_value(sketch, &sketch->cells[sketch_cell_index(sketch, hash, 0)], now);
+
+    for (uint32_t row = 1; row < sketch->depth; row++) {
+        estimate = fmin(estimate, sketch_cell_value(sketch, &sketch->cells[sketch_cell_index(sketch, hash, row)], now));
+    }
+
+    return estimate;
+}
+
+// When will the cell reach zero (Unix milliseconds)? REDISMODULE_NO_EXPIRE if it's too far off to bother.
+static mstime_t sketch_cell_zero_time(const SketchData *sketch, const SketchCell *cell) {
+    if (sketch->rate <= 0) {
+        return REDISMODULE_NO_EXPIRE;
+    }
+
+    const double microseconds_until_zero = sketch->decay == DecayExponential ?
+        ceil(log2(fmax(cell->value, CLOSE_ENOUGH_TO_ZERO) / CLOSE_ENOUGH_TO_ZERO) / sketch->rate * MICROSECONDS_PER_MILLISECOND) :
+        fmax(0, ceil((cell->value - CLOSE_ENOUGH_TO_ZERO) / sketch->rate)) * (double)sketch->interval;
+
+    if (microseconds_until_zero / MICROSECONDS_PER_MILLISECOND > DEGRADING_COUNTER_MAX_EXPIRE_MS) {
+        return REDISMODULE_NO_EXPIRE;
+    }
+
+    const ustime_t zero_time = cell->anchor + (ustime_t)microseconds_until_zero;
+
+    // Rounded up, so the key never goes before its last cell has actually got there.
+    return zero_time / MICROSECONDS_PER_MILLISECOND + (zero_time % MICROSECONDS_PER_MILLISECOND > 0);
+}
+
+// The key can go once its last cell reaches zero. Cells only ever move their zero time out, so pushing the expire back
+// when a cell outlives it is enough. A key that was just created doesn't have an expire to compare against yet.
+static void sketch_extend_expire(RedisModuleKey *key, const mstime_t zero_time, const int is_new, const ustime_t now) {
+    const mstime_t ttl = RedisModule_GetExpire(key);
+
+    if (zero_time == REDISMODULE_NO_EXPIRE) {
+        if (ttl != REDISMODULE_NO_EXPIRE) {
+            RedisModule_SetExpire(key, REDISMODULE_NO_EXPIRE);
+        }
+    } else if (is_new || (ttl != REDISMODULE_NO_EXPIRE && zero_time > now / MICROSECONDS_PER_MILLISECOND + ttl)) {
+        RedisModule_SetAbsExpire(key, zero_time);
+    }
+}
+
+// The latest zero time among `count` cells starting at `cells`, REDISMODULE_NO_EXPIRE if any of them never gets there.
+static mstime_t sketch_latest_zero_time(const SketchData *sketch, const SketchCell *cells, const size_t count) {
+    mstime_t latest = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (cells[i].value <= 0) {
+            continue;
+        }
+
+        const mstime_t zero_time = sketch_cell_zero_time(sketch, &cells[i]);
+
+        if (zero_time == REDISMODULE_NO_EXPIRE) {
+            return REDISMODULE_NO_EXPIRE;
+        }
+
+        latest = zero_time > latest ? zero_time : latest;
+    }
+
+    return latest;
+}
+
+// Open `key_name` and make sure it's either empty or a sketch. Replies with WRONGTYPE and returns NULL otherwise.
+static RedisModuleKey *sketch_open_key(RedisModuleCtx *ctx, RedisModuleString *key_name, const int mode) {
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, mode);
+
+    if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != Sketch) {
+        RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+        return NULL;
+    }
+
+    return key;
+}
+
+// Parse the name/value pairs in front of `ITEMS`, starting at `argv[2]`. `WIDTH` and `DEPTH` are picked out here and
+// everything else is handed to the DC.INCR parser as the decay. Replies with an error and returns NULL if anything is
+// missing or invalid, the result must be released with `degrading_counter_free`.
+static DegradingCounterData *sketch_parse_arguments(RedisModuleCtx *ctx, RedisModuleString **argv, const int items_index,
+                                                    uint32_t *width, uint32_t *depth) {
+    // The decay parser expects its pairs to start at index 2, so the first two slots are just carried over.
+    RedisModuleString **config_argv = RedisModule_PoolAlloc(ctx, sizeof(RedisModuleString *) * (size_t)items_index);
+    int config_argc = 2;
+    long long parsed_width = 0, parsed_depth = 0;
+
+    config_argv[0] = argv[0];
+    config_argv[1] = argv[1];
+
+    for (int i = 2; i + 1 < items_index; i += 2) {
+        const char *arg_name = RedisModule_StringPtrLen(argv[i], NULL);
+
+        if (strcmp(arg_name, "WIDTH") == 0) {
+            if (RedisModule_StringToLongLong(argv[i + 1], &parsed_width) != REDISMODULE_OK ||
+                parsed_width < 1 || parsed_width > SKETCH_MAX_WIDTH) {
+                RedisModule_ReplyWithErrorFormat(ctx, "ERR invalid value for WIDTH: must be an integer between 1 and %d.", SKETCH_MAX_WIDTH);
+                stats_record_parse_error();
+                return NULL;
+            }
+        } else if (strcmp(arg_name, "DEPTH") == 0) {
+            if (RedisModule_StringToLongLong(argv[i + 1], &parsed_depth) != REDISMODULE_OK ||
+                parsed_depth < 1 || parsed_depth > SKETCH_MAX_DEPTH) {
+                RedisModule_ReplyWithErrorFormat(ctx, "ERR invalid value for DEPTH: must be an integer between 1 and %d.", SKETCH_MAX_DEPTH);
+                stats_record_parse_error();
+                return NULL;
+            }
+        } else {
+            config_argv[config_argc++] = argv[i];
+            config_argv[config_argc++] = argv[i + 1];
+        }
+    }
+
+    if (parsed_width == 0 || parsed_depth == 0) {
+        RedisModule_ReplyWithError(ctx, "ERR WIDTH and DEPTH are both required.");
+        stats_record_parse_error();
+        return NULL;
+    }
+
+    if (parsed_width * parsed_depth > SKETCH_MAX_CELLS) {
+        RedisModule_ReplyWithErrorFormat(ctx, "ERR WIDTH times DEPTH can't be more than %d cells.", SKETCH_MAX_CELLS);
+        stats_record_parse_error();
+        return NULL;
+    }
+
+    *width = (uint32_t)parsed_width;
+    *depth = (uint32_t)parsed_depth;
+
+    return get_degrading_counter_config_from_redis_arguments(ctx, config_argv, config_argc);
+}
+
+// Replicate the cells the batch of `hashes` touched, as they are now, rather than the increment. Rows are sent a cell at
+// a time, a whole one can be megabytes. An item counted twice in a batch sends its cells twice, which is harmless.
+static void sketch_replicate_cells(RedisModuleCtx *ctx, RedisModuleString *key_name, const SketchData *sketch,
+                                   const uint64_t *hashes, const int item_count) {
+    const size_t count = (size_t)item_count * sketch->depth;
+    SketchCellUpdate *updates = RedisModule_PoolAlloc(ctx, sizeof(SketchCellUpdate) * count);
+    size_t n = 0;
+    char rate[32];
+
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        for (int i = 0; i < item_count; i++, n++) {
+            updates[n].index = sketch_cell_index(sketch, hashes[i], row);
+            updates[n].cell = sketch->cells[updates[n].index];
+        }
+    }
+
+    // Doubles are written out with enough digits to come back bit for bit.
+    snprintf(rate, sizeof(rate), "%.17g", sketch->rate);
+
+    RedisModule_Replicate(ctx, "DC.CMS.RESTORE", "slcllcb",
+                          key_name,
+                          (long long)sketch->decay,
+                          rate,
+                          sketch->interval,
+                          (long long)sketch->width,
+                          (long long)sketch->depth,
+                          "CELLS",
+                          (const char *)updates, sizeof(SketchCellUpdate) * count);
+}
+
+// ------- Commands
+
+// DC.CMS.INCR key WIDTH <width> DEPTH <depth> (DEGRADE_RATE <rate> INTERVAL <interval> | DECAY EXP HALFLIFE <interval>)
+//     ITEMS <item> <amount> [<item> <amount> ...]
+int sketch_increment_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.CMS.INCR) sketch_increment_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 5) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    // `ITEMS` ends the pairs, everything after it is items and their amounts.
+    int items_index = 2;
+
+    while (items_index < argc && strcmp(RedisModule_StringPtrLen(argv[items_index], NULL), "ITEMS") != 0) {
+        items_index += 2;
+    }
+
+    const int item_count = (argc - items_index - 1) / 2;
+
+    if (items_index >= argc || item_count == 0 || (argc - items_index - 1) % 2 != 0) {
+        RedisModule_ReplyWithError(ctx, "ERR ITEMS must be followed by one or more item and amount pairs.");
+        stats_record_parse_error();
+        return REDISMODULE_ERR;
+    }
+
+    RedisModuleKey *key = sketch_open_key(ctx, argv[1], REDISMODULE_READ|REDISMODULE_WRITE);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    uint32_t width, depth;
+
+    // The arguments are validated even when the key exists so a typo doesn't go unnoticed until the key expires.
+    DegradingCounterData *config = sketch_parse_arguments(ctx, argv, items_index, &width, &depth);
+
+    if (config == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    // Every item is checked before any of them is counted, so a bad amount doesn't leave half the batch applied.
+    uint64_t *hashes = RedisModule_PoolAlloc(ctx, sizeof(uint64_t) * (size_t)item_count);
+    double *amounts = RedisModule_PoolAlloc(ctx, sizeof(double) * (size_t)item_count);
+
+    for (int i = 0; i < item_count; i++) {
+        RedisModuleString *amount = argv[items_index + 2 + i * 2];
+
+        // Count-min only works for counts that go up, taking something away could make an item read less than it's seen.
+        if (RedisModule_StringToDouble(amount, &amounts[i]) != REDISMODULE_OK || !(amounts[i] > 0)) {
+            degrading_counter_free(config);
+            stats_record_parse_error();
+            return RedisModule_ReplyWithErrorFormat(ctx, "ERR invalid amount for item %d: must be a positive double.", i + 1);
+        }
+
+        size_t len;
+        const char *item = RedisModule_StringPtrLen(argv[items_index + 1 + i * 2], &len);
+
+        hashes[i] = sketch_hash(item, len);
+    }
+
+    const ustime_t now = degrading_counter_now();
+    const int is_new = RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY;
+    SketchData *sketch;
+
+    if (is_new) {
+        sketch = sketch_create(config->decay, config->degrades_at, degrading_counter_interval_in_microseconds(config), width, depth);
+        RedisModule_ModuleTypeSetValue(key, Sketch, sketch);
+    } else {
+        // An existing sketch keeps the shape and decay it was created with.
+        sketch = RedisModule_ModuleTypeGetValue(key);
+    }
+
+    degrading_counter_free(config);
+
+    // The batch is applied a row at a time, so every update within a pass lands in the same row of the block.
+    mstime_t latest_zero_time = 0;
+
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        for (int i = 0; i < item_count; i++) {
+            SketchCell *cell = &sketch->cells[sketch_cell_index(sketch, hashes[i], row)];
+
+            sketch_cell_add(sketch, cell, amounts[i], now);
+
+            if (latest_zero_time != REDISMODULE_NO_EXPIRE) {
+                const mstime_t zero_time = sketch_cell_zero_time(sketch, cell);
+                latest_zero_time = zero_time == REDISMODULE_NO_EXPIRE || zero_time > latest_zero_time ? zero_time : latest_zero_time;
+            }
+        }
+    }
+
+    sketch_extend_expire(key, latest_zero_time, is_new, now);
+
+    RedisModule_ReplyWithArray(ctx, item_count);
+
+    for (int i = 0; i < item_count; i++) {
+        RedisModule_ReplyWithDouble(ctx, sketch_estimate(sketch, hashes[i], now));
+    }
+
+    sketch_replicate_cells(ctx, argv[1], sketch, hashes, item_count);
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.CMS.INCR) sketch_increment_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// DC.CMS.QUERY key item [item ...]
+int sketch_query_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 3) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = sketch_open_key(ctx, argv[1], REDISMODULE_READ);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    RedisModule_ReplyWithArray(ctx, argc - 2);
+
+    // A sketch can't tell an item it has never seen from one that has decayed away, and neither can a missing key.
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        for (int i = 2; i < argc; i++) {
+            RedisModule_ReplyWithDouble(ctx, 0);
+        }
+
+        return REDISMODULE_OK;
+    }
+
+    const SketchData *sketch = RedisModule_ModuleTypeGetValue(key);
+    const ustime_t now = degrading_counter_now();
+
+    for (int i = 2; i < argc; i++) {
+        size_t len;
+        const char *item = RedisModule_StringPtrLen(argv[i], &len);
+
+        RedisModule_ReplyWithDouble(ctx, sketch_estimate(sketch, sketch_hash(item, len), now));
+    }
+
+    return REDISMODULE_OK;
+}
+
+// DC.CMS.RESTORE key <decay> <rate> <interval us> <width> <depth> <row> <cells>
+// DC.CMS.RESTORE key <decay> <rate> <interval us> <width> <depth> CELLS <updates>
+//
+// The first form is emitted by the AOF rewrite and recreates one row exactly as it was, `cells` is the raw array of the
+// row's cells. The second is replicated in place of DC.CMS.INCR and sets just the cells in `updates`, a raw array of
+// `SketchCellUpdate`. Either creates the key with the given shape and decay if it doesn't exist yet.
+int sketch_restore_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 9) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long decay, interval, width, depth, row;
+    double rate;
+    size_t cells_len;
+    const char *cells = RedisModule_StringPtrLen(argv[8], &cells_len);
+
+    if (RedisModule_StringToLongLong(argv[2], &decay) != REDISMODULE_OK || (decay != DecayLinear && decay != DecayExponential) ||
+        RedisModule_StringToDouble(argv[3], &rate) != REDISMODULE_OK ||
+        RedisModule_StringToLongLong(argv[4], &interval) != REDISMODULE_OK || interval < 1 ||
+        RedisModule_StringToLongLong(argv[5], &width) != REDISMODULE_OK || width < 1 || width > SKETCH_MAX_WIDTH ||
+        RedisModule_StringToLongLong(argv[6], &depth) != REDISMODULE_OK || depth < 1 || depth > SKETCH_MAX_DEPTH ||
+        width * depth > SKETCH_MAX_CELLS) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid sketch payload.");
+    }
+
+    const int is_update = strcmp(RedisModule_StringPtrLen(argv[7], NULL), "CELLS") == 0;
+    const size_t update_count = cells_len / sizeof(SketchCellUpdate);
+
+    if (is_update) {
+        if (cells_len % sizeof(SketchCellUpdate) != 0) {
+            return RedisModule_ReplyWithError(ctx, "ERR invalid sketch payload.");
+        }
+
+        // Checked before anything is applied so a bad payload doesn't leave the key half updated.
+        for (size_t i = 0; i < update_count; i++) {
+            SketchCellUpdate update;
+            memcpy(&update, cells + i * sizeof(SketchCellUpdate), sizeof(SketchCellUpdate));
+
+            if (update.index >= (uint64_t)(width * depth)) {
+                return RedisModule_ReplyWithError(ctx, "ERR invalid sketch payload.");
+            }
+        }
+    } else if (RedisModule_StringToLongLong(argv[7], &row) != REDISMODULE_OK || row < 0 || row >= depth ||
+               cells_len != (size_t)width * sizeof(SketchCell)) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid sketch payload.");
+    }
+
+    RedisModuleKey *key = sketch_open_key(ctx, argv[1], REDISMODULE_READ|REDISMODULE_WRITE);
+
+    if (key == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    const int is_new = RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY;
+    SketchData *sketch;
+
+    if (is_new) {
+        sketch = sketch_create((int)decay, rate, interval, (uint32_t)width, (uint32_t)depth);
+        RedisModule_ModuleTypeSetValue(key, Sketch, sketch);
+    } else {
+        sketch = RedisModule_ModuleTypeGetValue(key);
+
+        if (sketch->width != width || sketch->depth != depth) {
+            return RedisModule_ReplyWithError(ctx, "ERR sketch payload doesn't match the existing key.");
+        }
+    }
+
+    mstime_t latest_zero_time;
+
+    if (is_update) {
+        latest_zero_time = 0;
+
+        for (size_t i = 0; i < update_count; i++) {
+            SketchCellUpdate update;
+            memcpy(&update, cells + i * sizeof(SketchCellUpdate), sizeof(SketchCellUpdate));
+            sketch->cells[update.index] = update.cell;
+
+            if (latest_zero_time != REDISMODULE_NO_EXPIRE) {
+                const mstime_t zero_time = sketch_latest_zero_time(sketch, &update.cell, 1);
+                latest_zero_time = zero_time == REDISMODULE_NO_EXPIRE || zero_time > latest_zero_time ? zero_time : latest_zero_time;
+            }
+        }
+    } else {
+        SketchCell *restored = &sketch->cells[(size_t)row * sketch->width];
+        memcpy(restored, cells, cells_len);
+        latest_zero_time = sketch_latest_zero_time(sketch, restored, sketch->width);
+    }
+
+    sketch_extend_expire(key, latest_zero_time, is_new, degrading_counter_now());
+
+    RedisModule_ReplicateVerbatim(ctx);
+
+    return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(sketch_increment_RedisCommand, StatsSketchIncrement)
+DEGRADING_COUNTER_TIMED_COMMAND(sketch_query_RedisCommand, StatsSketchQuery)
+
+// ------- Native Type Callbacks.
+
+void *sketch_rdb_load(RedisModuleIO *io, int encoding_version) {
+    if (encoding_version != SKETCH_ENCODING_VERSION) {
+        return NULL;
+    }
+
+    const int decay = (int)RedisModule_LoadUnsigned(io);
+    const double rate = RedisModule_LoadDouble(io);
+    const long long interval = RedisModule_LoadSigned(io);
+    const uint64_t width = RedisModule_LoadUnsigned(io);
+    const uint64_t depth = RedisModule_LoadUnsigned(io);
+
+    if (interval < 1 || width < 1 || width > SKETCH_MAX_WIDTH || depth < 1 || depth > SKETCH_MAX_DEPTH || width * depth > SKETCH_MAX_CELLS) {
+        return NULL;
+    }
+
+    SketchData *sketch = sketch_create(decay, rate, interval, (uint32_t)width, (uint32_t)depth);
+
+    // A row at a time, as one buffer each, rather than a double and a signed integer per cell.
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        size_t len;
+        char *cells = RedisModule_LoadStringBuffer(io, &len);
+
+        if (len != (size_t)sketch->width * sizeof(SketchCell)) {
+            RedisModule_Free(cells);
+            RedisModule_Free(sketch);
+            return NULL;
+        }
+
+        memcpy(&sketch->cells[(size_t)row * sketch->width], cells, len);
+        RedisModule_Free(cells);
+    }
+
+    return sketch;
+}
+
+void sketch_rdb_save(RedisModuleIO *io, void *value) {
+    const SketchData *sketch = value;
+
+    RedisModule_SaveUnsigned(io, sketch->decay);
+    RedisModule_SaveDouble(io, sketch->rate);
+    RedisModule_SaveSigned(io, sketch->interval);
+    RedisModule_SaveUnsigned(io, sketch->width);
+    RedisModule_SaveUnsigned(io, sketch->depth);
+
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        RedisModule_SaveStringBuffer(io, (const char *)&sketch->cells[(size_t)row * sketch->width], (size_t)sketch->width * sizeof(SketchCell));
+    }
+}
+
+void sketch_aof_rewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
+    const SketchData *sketch = value;
+    char rate[32];
+
+    // Doubles are written out with enough digits to come back bit for bit.
+    snprintf(rate, sizeof(rate), "%.17g", sketch->rate);
+
+    // One command per row keeps every argument well under the bulk string limit, even for the widest sketches.
+    for (uint32_t row = 0; row < sketch->depth; row++) {
+        RedisModule_EmitAOF(aof, "DC.CMS.RESTORE", "slcllllb",
+                            key,
+                            (long long)sketch->decay,
+                            rate,
+                            sketch->interval,
+                            (long long)sketch->width,
+                            (long long)sketch->depth,
+                            (long long)row,
+                            (const char *)&sketch->cells[(size_t)row * sketch->width], (size_t)sketch->width * sizeof(SketchCell));
+    }
+}
+
+void sketch_free(void *value) {
+    RedisModule_Free(value);
+}
+
+size_t sketch_mem_usage(const void *value) {
+    const SketchData *sketch = value;
+
+    return sketch_size(sketch->width, sketch->depth);
+}
+
+size_t sketch_free_effort(RedisModuleString *key, const void *value) {
+    // A single allocation no matter how many cells.
+    return 1;
+}
+
+// Called from `RedisModule_OnLoad` to create the type and its commands.
+int sketch_register(RedisModuleCtx *ctx) {
+    RedisModuleTypeMethods tm = {
+        .version = REDISMODULE_TYPE_METHOD_VERSION,
+        .rdb_load = sketch_rdb_load,
+        .rdb_save = sketch_rdb_save,
+        .aof_rewrite = sketch_aof_rewrite,
+        .mem_usage = sketch_mem_usage,
+        .free = sketch_free,
+        .free_effort = sketch_free_effort
+    };
+
+    Sketch = RedisModule_CreateDataType(ctx,
+        SKETCH_TYPE_NAME,
+        SKETCH_ENCODING_VERSION,
+        &tm);
+
+    if (Sketch == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    // A whole batch of items per call, so neither of these is O(1).
+    if (RedisModule_CreateCommand(ctx, "dc.cms.incr",
+        sketch_increment_RedisCommand_Timed, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // Cells are never removed, so unlike the other types reading a sketch doesn't write anything.
+    if (RedisModule_CreateCommand(ctx, "dc.cms.query",
+        sketch_query_RedisCommand_Timed, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.cms.restore",
+        sketch_restore_RedisCommand, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,158 @@
+#include "stats.h"
+#include <stdio.h>
+
+// Latencies are kept in an HDR style histogram: every power of two range of microseconds is split into
+// STATS_SUB_BUCKETS linear buckets, so each bucket is within 25% of its neighbours no matter the magnitude. 96 buckets
+// cover everything up to roughly 30 seconds, anything slower lands in the last one.
+#define STATS_SUB_BUCKET_BITS 2
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+#define STATS_BUCKETS 96
+
+typedef struct CommandStats {
+    const char *name;
+    unsigned long long calls;
+    unsigned long long total_us;
+    unsigned long long buckets[STATS_BUCKETS];
+} CommandStats;
+
+// Every command runs on the main thread, as does `INFO`, so none of this needs to be synchronized.
+static CommandStats Commands[StatsCommandCount] = {
+    [StatsIncrement] = { .name = "dc_incr" },
+    [StatsDecrement] = { .name = "dc_decr" },
+    [StatsPeek] = { .name = "dc_peek" },
+    [StatsMultiIncrement] = { .name = "dc_mincr" },
+    [StatsMultiPeek] = { .name = "dc_mpeek" },
+    [StatsWindowIncrement] = { .name = "dc_wincr" },
+    [StatsWindowPeek] = { .name = "dc_wpeek" },
+    [StatsLeaderboardIncrement] = { .name = "dc_zincr" },
+    [StatsLeaderboardScore] = { .name = "dc_zscore" },
+    [StatsLeaderboardRank] = { .name = "dc_zrank" },
+    [StatsLeaderboardRange] = { .name = "dc_zrange" },
+    [StatsHashIncrement] = { .name = "dc_hincr" },
+    [StatsHashPeek] = { .name = "dc_hpeek" },
+    [StatsHashGetAll] = { .name = "dc_hgetall" },
+    [StatsSum] = { .name = "dc_sum" },
+    [StatsCountAbove] = { .name = "dc_countabove" },
+    [StatsProfile] = { .name = "dc_profile" },
+    [StatsDescribe] = { .name = "dc_describe" },
+    [StatsWatch] = { .name = "dc_watch" },
+    [StatsAllow] = { .name = "dc_allow" },
+    [StatsSketchIncrement] = { .name = "dc_cms_incr" },
+    [StatsSketchQuery] = { .name = "dc_cms_query" },
+    [StatsExport] = { .name = "dc_export" },
+    [StatsImport] = { .name = "dc_import" },
+};
+
+static unsigned long long LazyDeletions = 0;
+static unsigned long long ParseErrors = 0;
+
+// Which bucket does a latency of `value` microseconds fall into?
+static int stats_bucket_index(const uint64_t value) {
+    if (value < STATS_SUB_BUCKETS) {
+        return (int)value;
+    }
+
+    const int most_significant_bit = 63 - __builtin_clzll(value);
+    const int sub_bucket = (int)(value >> (most_significant_bit - STATS_SUB_BUCKET_BITS)) & (STATS_SUB_BUCKETS - 1);
+    const int index = (most_significant_bit - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS + sub_bucket;
+
+    return index < STATS_BUCKETS ? index : STATS_BUCKETS - 1;
+}
+
+// The largest latency, in microseconds, that lands in bucket `index`.
+static unsigned long long stats_bucket_upper_bound(const int index) {
+    if (index < STATS_SUB_BUCKETS) {
+        return (unsigned long long)index;
+    }
+
+    const int shift = index / STATS_SUB_BUCKETS - 1;
+    const unsigned long long sub_bucket = (unsigned long long)(index % STATS_SUB_BUCKETS);
+
+    return ((STATS_SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+}
+
+// Approximate the given percentile (0 - 1) by walking the histogram.
+static unsigned long long stats_percentile(const CommandStats *stats, const double percentile) {
+    if (stats->calls == 0) {
+        return 0;
+    }
+
+    const double target = percentile * (double)stats->calls;
+    unsigned long long seen = 0;
+
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += stats->buckets[i];
+
+        if ((double)seen >= target) {
+            return stats_bucket_upper_bound(i);
+        }
+    }
+
+    return stats_bucket_upper_bound(STATS_BUCKETS - 1);
+}
+
+void stats_record_call(const StatsCommand command, const uint64_t elapsed_us) {
+    CommandStats *stats = &Commands[command];
+
+    stats->calls++;
+    stats->total_us += elapsed_us;
+    stats->buckets[stats_bucket_index(elapsed_us)]++;
+}
+
+void stats_record_lazy_deletion(void) {
+    LazyDeletions++;
+}
+
+void stats_record_parse_error(void) {
+    ParseErrors++;
+}
+
+void stats_add_info(RedisModuleInfoCtx *ctx, const size_t live_counters, const size_t pool_bytes) {
+    RedisModule_InfoAddSection(ctx, "stats");
+    RedisModule_InfoAddFieldULongLong(ctx, "live_counters", live_counters);
+    RedisModule_InfoAddFieldULongLong(ctx, "pool_bytes", pool_bytes);
+    RedisModule_InfoAddFieldULongLong(ctx, "lazy_deletions", LazyDeletions);
+    RedisModule_InfoAddFieldULongLong(ctx, "parse_errors", ParseErrors);
+
+    // One line per command, in the same spirit as `INFO commandstats` / `INFO latencystats`.
+    RedisModule_InfoAddSection(ctx, "commands");
+
+    for (int i = 0; i < StatsCommandCount; i++) {
+        const CommandStats *stats = &Commands[i];
+
+        RedisModule_InfoBeginDictField(ctx, stats->name);
+        RedisModule_InfoAddFieldULongLong(ctx, "calls", stats->calls);
+        RedisModule_InfoAddFieldULongLong(ctx, "usec", stats->total_us);
+        RedisModule_InfoAddFieldDouble(ctx, "usec_per_call", stats->calls == 0 ? 0 : (double)stats->total_us / (double)stats->calls);
+        RedisModule_InfoAddFieldULongLong(ctx, "p50", stats_percentile(stats, 0.5));
+        RedisModule_InfoAddFieldULongLong(ctx, "p99", stats_percentile(stats, 0.99));
+        RedisModule_InfoAddFieldULongLong(ctx, "p999", stats_percentile(stats, 0.999));
+        RedisModule_InfoEndDictField(ctx);
+    }
+
+    // The raw histograms, only listing the buckets that have seen a call. `le_N` is the number of calls that took at most
+    // N microseconds and more than the previous bucket's bound.
+    RedisModule_InfoAddSection(ctx, "latency");
+
+    for (int i = 0; i < StatsCommandCount; i++) {
+        const CommandStats *stats = &Commands[i];
+
+        if (stats->calls == 0) {
+            continue;
+        }
+
+        RedisModule_InfoBeginDictField(ctx, stats->name);
+
+        for (int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+            if (stats->buckets[bucket] == 0) {
+                continue;
+            }
+
+            char field[32];
+            snprintf(field, sizeof(field), "le_%llu", stats_bucket_upper_bound(bucket));
+            RedisModule_InfoAddFieldULongLong(ctx, field, stats->buckets[bucket]);
+        }
+
+        RedisModule_InfoEndDictField(ctx);
+    }
+}
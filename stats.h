@@ -0,0 +1,48 @@
+#ifndef DEGRADING_COUNTER_STATS_H
+#define DEGRADING_COUNTER_STATS_H
+
+#include "redismodule.h"
+#include <stdint.h>
+
+// The commands we keep call counts and latency histograms for.
+typedef enum StatsCommand {
+    StatsIncrement = 0,
+    StatsDecrement,
+    StatsPeek,
+    StatsMultiIncrement,
+    StatsMultiPeek,
+    StatsWindowIncrement,
+    StatsWindowPeek,
+    StatsLeaderboardIncrement,
+    StatsLeaderboardScore,
+    StatsLeaderboardRank,
+    StatsLeaderboardRange,
+    StatsHashIncrement,
+    StatsHashPeek,
+    StatsHashGetAll,
+    StatsSum,
+    StatsCountAbove,
+    StatsProfile,
+    StatsDescribe,
+    StatsWatch,
+    StatsAllow,
+    StatsSketchIncrement,
+    StatsSketchQuery,
+    StatsExport,
+    StatsImport,
+    StatsCommandCount // Not a command, just how many there are.
+} StatsCommand;
+
+// Record a single call to `command` that took `elapsed_us` microseconds.
+void stats_record_call(StatsCommand command, uint64_t elapsed_us);
+
+// Record a counter that was removed because it was found at zero, rather than by an explicit command.
+void stats_record_lazy_deletion(void);
+
+// Record a command that was rejected because its arguments couldn't be parsed.
+void stats_record_parse_error(void);
+
+// Add the module's sections to the output of `INFO`.
+void stats_add_info(RedisModuleInfoCtx *ctx, size_t live_counters, size_t pool_bytes);
+
+#endif
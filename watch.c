@@ -0,0 +1,600 @@
+#include "redismodule.h"
+#include "module.h"
+#include <string.h>
+
+// Threshold watches (DC.WATCH key BELOW <threshold> CHANNEL <name>). Decay is deterministic, so the moment a counter
+// drops below a threshold can be worked out up front (`degrading_counter_compute_crossing_time`). Each watch is parked
+// in a hierarchical timer wheel until then, and when it comes due the key name is published to the watch's channel and
+// the watch is dropped. Writes to a watched counter move its watches to the new crossing time.
+//
+// The wheel has WATCH_WHEEL_LEVELS levels of 64 slots, level `l` slots are 64^l milliseconds wide. A watch goes in the
+// lowest level whose span reaches its due time, and falls down a level each time the wheel gets to its slot, so every
+// watch is touched at most once per level. Each level keeps a bitmap of its occupied slots, which makes finding the
+// next thing to do a rotate and a count of trailing zeros per level. There's a single Redis timer, armed for exactly
+// that moment, so an idle wheel costs nothing and a busy one wakes up once per millisecond that has work due.
+//
+// Watches live in memory only. They aren't replicated, persisted or carried over a restart, a client that needs one to
+// survive those should set it again. They go away with their key: deletes, expiry, eviction and flushes all reach us
+// through keyspace and server events, whoever caused them.
+
+#define WATCH_WHEEL_BITS 6
+#define WATCH_WHEEL_SLOTS (1 << WATCH_WHEEL_BITS)
+#define WATCH_WHEEL_LEVELS 6
+// Watches due further out than this (about two years) sit in the top level and get put back each time it comes around.
+#define WATCH_WHEEL_HORIZON_MS ((mstime_t)1 << (WATCH_WHEEL_BITS * WATCH_WHEEL_LEVELS))
+
+typedef struct WatchedKey WatchedKey;
+
+typedef struct Watch {
+    struct Watch *prev, *next; // Neighbours in the wheel slot.
+    struct Watch *sibling; // The next watch on the same key.
+    WatchedKey *watched_key;
+    mstime_t fires_at; // REDISMODULE_NO_EXPIRE when the counter isn't headed below the threshold, it's not in the wheel.
+    unsigned char level, slot; // Where in the wheel it is.
+    double threshold;
+    RedisModuleString *channel;
+} Watch;
+
+struct WatchedKey {
+    int db;
+    RedisModuleString *key_name;
+    Watch *watches;
+};
+
+typedef struct WatchWheel {
+    Watch *slots[WATCH_WHEEL_LEVELS][WATCH_WHEEL_SLOTS];
+    uint64_t occupied[WATCH_WHEEL_LEVELS]; // Bit `s` is set when `slots[level][s]` isn't empty.
+    mstime_t current; // Everything due at or before this has been handled.
+    RedisModuleTimerID timer;
+    mstime_t timer_at; // When the timer will fire, 0 if it isn't armed.
+} WatchWheel;
+
+static WatchWheel Wheel;
+
+// Key name to WatchedKey, one dictionary per database.
+static RedisModuleDict **WatchedKeys;
+static int WatchedKeysDbCount;
+
+// How many watches exist, so writes to counters can skip the lookup entirely when nobody is watching anything.
+static size_t WatchCount;
+
+// Set while the wheel fires watches. Checking a counter can expire its key, and the event that comes with it mustn't
+// touch watches the wheel is still holding on to.
+static int WatchWheelFiring;
+
+// ------- Timer Wheel
+
+static inline uint64_t watch_rotate_right(const uint64_t bits, const unsigned int by) {
+    return by == 0 ? bits : (bits >> by) | (bits << (64 - by));
+}
+
+// Put a watch in the slot for its due time, or for `earliest` if it's already overdue.
+static void watch_wheel_link(Watch *watch, const mstime_t earliest) {
+    mstime_t due = watch->fires_at < earliest ? earliest : watch->fires_at;
+
+    if (due - Wheel.current >= WATCH_WHEEL_HORIZON_MS) {
+        due = Wheel.current + WATCH_WHEEL_HORIZON_MS - 1;
+    }
+
+    const uint64_t delta = (uint64_t)(due - Wheel.current);
+    int level = 0;
+
+    while (level < WATCH_WHEEL_LEVELS - 1 && delta >= (uint64_t)1 << (WATCH_WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+
+    const int slot = (int)(((uint64_t)due >> (WATCH_WHEEL_BITS * level)) & (WATCH_WHEEL_SLOTS - 1));
+
+    watch->level = (unsigned char)level;
+    watch->slot = (unsigned char)slot;
+    watch->prev = NULL;
+    watch->next = Wheel.slots[level][slot];
+
+    if (watch->next != NULL) {
+        watch->next->prev = watch;
+    }
+
+    Wheel.slots[level][slot] = watch;
+    Wheel.occupied[level] |= (uint64_t)1 << slot;
+}
+
+static void watch_wheel_unlink(Watch *watch) {
+    if (watch->prev != NULL) {
+        watch->prev->next = watch->next;
+    } else {
+        Wheel.slots[watch->level][watch->slot] = watch->next;
+    }
+
+    if (watch->next != NULL) {
+        watch->next->prev = watch->prev;
+    }
+
+    if (Wheel.slots[watch->level][watch->slot] == NULL) {
+        Wheel.occupied[watch->level] &= ~((uint64_t)1 << watch->slot);
+    }
+}
+
+// Take every watch out of a slot, returning them as a list linked through `next`.
+static Watch *watch_wheel_take_slot(const int level, const int slot) {
+    Watch *watches = Wheel.slots[level][slot];
+
+    Wheel.slots[level][slot] = NULL;
+    Wheel.occupied[level] &= ~((uint64_t)1 << slot);
+
+    return watches;
+}
+
+static int watch_wheel_is_empty(void) {
+    for (int level = 0; level < WATCH_WHEEL_LEVELS; level++) {
+        if (Wheel.occupied[level] != 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// The next moment the wheel has something to do, either a level 0 slot coming due or a higher level slot that needs to
+// be moved down. REDISMODULE_NO_EXPIRE if it's empty.
+static mstime_t watch_wheel_next_event(void) {
+    mstime_t next = REDISMODULE_NO_EXPIRE;
+
+    for (int level = 0; level < WATCH_WHEEL_LEVELS; level++) {
+        if (Wheel.occupied[level] == 0) {
+            continue;
+        }
+
+        // Slot `s` at this level comes around next when the wheel reaches a multiple of the slot width whose slot number
+        // is `s`. Rotating the bitmap so the slot after the current one is bit 0 makes that the lowest set bit.
+        const int shift = WATCH_WHEEL_BITS * level;
+        const uint64_t position = (uint64_t)Wheel.current >> shift;
+        const uint64_t rotated = watch_rotate_right(Wheel.occupied[level], (unsigned int)((position + 1) & (WATCH_WHEEL_SLOTS - 1)));
+        const mstime_t at = (mstime_t)((position + 1 + (uint64_t)__builtin_ctzll(rotated)) << shift);
+
+        if (next == REDISMODULE_NO_EXPIRE || at < next) {
+            next = at;
+        }
+    }
+
+    return next;
+}
+
+static void watch_fire(RedisModuleCtx *ctx, Watch *watch);
+
+// Handle everything that's due up to and including `now`.
+static void watch_wheel_advance(RedisModuleCtx *ctx, const mstime_t now) {
+    for (;;) {
+        const mstime_t at = watch_wheel_next_event();
+
+        if (at == REDISMODULE_NO_EXPIRE || at > now) {
+            break;
+        }
+
+        Wheel.current = at;
+
+        // Move the higher level slots that start now down first, their watches may be due right away.
+        for (int level = WATCH_WHEEL_LEVELS - 1; level > 0; level--) {
+            const int shift = WATCH_WHEEL_BITS * level;
+
+            if (((uint64_t)at & (((uint64_t)1 << shift) - 1)) != 0) {
+                continue;
+            }
+
+            Watch *watch = watch_wheel_take_slot(level, (int)(((uint64_t)at >> shift) & (WATCH_WHEEL_SLOTS - 1)));
+
+            while (watch != NULL) {
+                Watch *next = watch->next;
+                // Anything due right now lands in the level 0 slot that's about to be handled below.
+                watch_wheel_link(watch, at);
+                watch = next;
+            }
+        }
+
+        // Firing a watch can put it straight back into the wheel, so the slot is emptied before any of them fire.
+        Watch *watch = watch_wheel_take_slot(0, (int)((uint64_t)at & (WATCH_WHEEL_SLOTS - 1)));
+
+        while (watch != NULL) {
+            Watch *next = watch->next;
+            watch_fire(ctx, watch);
+            watch = next;
+        }
+    }
+
+    // Nothing is due before `now`, so we can skip straight to it.
+    if (now > Wheel.current) {
+        Wheel.current = now;
+    }
+}
+
+static void watch_timer_callback(RedisModuleCtx *ctx, void *data);
+
+// Make sure the timer goes off in time for the next thing the wheel has to do.
+static void watch_arm_timer(RedisModuleCtx *ctx) {
+    const mstime_t next = watch_wheel_next_event();
+
+    if (next == REDISMODULE_NO_EXPIRE || (Wheel.timer_at != 0 && Wheel.timer_at <= next)) {
+        return;
+    }
+
+    if (Wheel.timer_at != 0) {
+        RedisModule_StopTimer(ctx, Wheel.timer, NULL);
+    }
+
+    const mstime_t now = RedisModule_Milliseconds();
+
+    Wheel.timer = RedisModule_CreateTimer(ctx, next > now ? next - now : 0, watch_timer_callback, NULL);
+    Wheel.timer_at = next;
+}
+
+static void watch_timer_callback(RedisModuleCtx *ctx, void *data) {
+    Wheel.timer_at = 0;
+
+    WatchWheelFiring = 1;
+    watch_wheel_advance(ctx, RedisModule_Milliseconds());
+    WatchWheelFiring = 0;
+
+    watch_arm_timer(ctx);
+}
+
+// Put a watch in the wheel for `fires_at`, moving it if it's already there.
+static void watch_schedule(RedisModuleCtx *ctx, Watch *watch, const mstime_t fires_at) {
+    if (watch->fires_at != REDISMODULE_NO_EXPIRE) {
+        watch_wheel_unlink(watch);
+    }
+
+    watch->fires_at = fires_at;
+
+    if (fires_at != REDISMODULE_NO_EXPIRE) {
+        // An empty wheel might not have moved in a long time. With nothing in it, it can skip straight to now.
+        if (watch_wheel_is_empty() && Wheel.current < RedisModule_Milliseconds()) {
+            Wheel.current = RedisModule_Milliseconds();
+        }
+
+        watch_wheel_link(watch, Wheel.current + 1);
+        watch_arm_timer(ctx);
+    }
+}
+
+// ------- Watched Keys
+
+static RedisModuleDict *watch_keys_for_db(const int db, const int create) {
+    if (db >= WatchedKeysDbCount) {
+        if (!create) {
+            return NULL;
+        }
+
+        WatchedKeys = RedisModule_Realloc(WatchedKeys, sizeof(RedisModuleDict*) * (size_t)(db + 1));
+        memset(WatchedKeys + WatchedKeysDbCount, 0, sizeof(RedisModuleDict*) * (size_t)(db + 1 - WatchedKeysDbCount));
+        WatchedKeysDbCount = db + 1;
+    }
+
+    if (WatchedKeys[db] == NULL && create) {
+        WatchedKeys[db] = RedisModule_CreateDict(NULL);
+    }
+
+    return WatchedKeys[db];
+}
+
+static WatchedKey *watch_find_key(const int db, RedisModuleString *key_name) {
+    RedisModuleDict *keys = watch_keys_for_db(db, 0);
+
+    return keys == NULL ? NULL : RedisModule_DictGet(keys, key_name, NULL);
+}
+
+// Unlink a watch from its key (and the wheel) and free it, dropping the key as well once nothing watches it.
+static void watch_remove(Watch *watch) {
+    WatchedKey *watched_key = watch->watched_key;
+    Watch **link = &watched_key->watches;
+
+    if (watch->fires_at != REDISMODULE_NO_EXPIRE) {
+        watch_wheel_unlink(watch);
+    }
+
+    while (*link != watch) {
+        link = &(*link)->sibling;
+    }
+
+    *link = watch->sibling;
+
+    RedisModule_FreeString(NULL, watch->channel);
+    RedisModule_Free(watch);
+    WatchCount--;
+
+    if (watched_key->watches == NULL) {
+        RedisModule_DictDel(WatchedKeys[watched_key->db], watched_key->key_name, NULL);
+        RedisModule_FreeString(NULL, watched_key->key_name);
+        RedisModule_Free(watched_key);
+    }
+}
+
+// Called by the wheel when a watch comes due. The counter is checked again before publishing, in case something the
+// watch wasn't told about changed it.
+static void watch_fire(RedisModuleCtx *ctx, Watch *watch) {
+    const mstime_t now = RedisModule_Milliseconds();
+
+    watch->fires_at = REDISMODULE_NO_EXPIRE; // The wheel has already let go of it.
+
+    if (RedisModule_SelectDb(ctx, watch->watched_key->db) == REDISMODULE_OK) {
+        RedisModuleKey *key = RedisModule_OpenKey(ctx, watch->watched_key->key_name, REDISMODULE_READ);
+        const DegradingCounterData *counter = degrading_counter_from_key(key);
+
+        // Something else took the key's place. It never dropped below anything, so there's nothing to tell anyone.
+        if (counter == NULL && RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY) {
+            RedisModule_CloseKey(key);
+            watch_remove(watch);
+            return;
+        }
+
+        // Not there yet. That's usually rounding in the exponential decay, so try again shortly.
+        if (counter != NULL && degrading_counter_compute_value(ctx, counter, degrading_counter_clock()) >= watch->threshold) {
+            const mstime_t fires_at = degrading_counter_compute_crossing_time(counter, watch->threshold);
+
+            RedisModule_CloseKey(key);
+
+            if (fires_at == REDISMODULE_NO_EXPIRE) {
+                watch_remove(watch);
+            } else {
+                watch_schedule(ctx, watch, fires_at > now ? fires_at : now + 1);
+            }
+
+            return;
+        }
+
+        RedisModule_CloseKey(key);
+    }
+
+    // A counter that's gone has degraded all the way, so it's below any threshold we'd accept.
+    RedisModule_PublishMessage(ctx, watch->channel, watch->watched_key->key_name);
+    watch_remove(watch);
+}
+
+// Move every watch on `watched_key` to the counter's new crossing time, dropping the ones it's no longer headed for.
+// With a NULL counter, one that degraded all the way and was deleted for it, they publish right away instead.
+static void watch_reschedule_key(RedisModuleCtx *ctx, WatchedKey *watched_key, const DegradingCounterData *counter) {
+    Watch *watch = watched_key->watches;
+
+    // Removing the last watch frees the key too, so the next one is picked up before anything is removed.
+    while (watch != NULL) {
+        Watch *sibling = watch->sibling;
+
+        if (counter == NULL) {
+            RedisModule_PublishMessage(ctx, watch->channel, watched_key->key_name);
+            watch_remove(watch);
+        } else {
+            const mstime_t fires_at = degrading_counter_compute_crossing_time(counter, watch->threshold);
+
+            if (fires_at == REDISMODULE_NO_EXPIRE) {
+                watch_remove(watch);
+            } else {
+                watch_schedule(ctx, watch, fires_at);
+            }
+        }
+
+        watch = sibling;
+    }
+}
+
+// Drop every watch on `watched_key` without publishing anything.
+static void watch_drop_key(WatchedKey *watched_key) {
+    Watch *watch = watched_key->watches;
+
+    // The last one takes the key with it, so we're done with `watched_key` once it's gone.
+    while (watch != NULL) {
+        Watch *sibling = watch->sibling;
+        watch_remove(watch);
+        watch = sibling;
+    }
+}
+
+// Called after every write to a counter to move its watches to the new crossing time. A write that deletes the counter
+// calls it with NULL before announcing the delete, which publishes to its watches (see `watch_keyspace_event`). Costs
+// nothing beyond a branch when there aren't any watches.
+void watch_counter_changed(RedisModuleCtx *ctx, RedisModuleString *key_name, const DegradingCounterData *counter) {
+    if (WatchCount == 0) {
+        return;
+    }
+
+    WatchedKey *watched_key = watch_find_key(RedisModule_GetSelectedDb(ctx), key_name);
+
+    if (watched_key != NULL) {
+        watch_reschedule_key(ctx, watched_key, counter);
+    }
+}
+
+// ------- Events
+
+// Keyspace events for anything that can take a watched key away or put something else in its place. Our own writes
+// already told us (see `watch_counter_changed`), these are for DEL, UNLINK, RENAME, RESTORE and the like, expiry and
+// eviction. A key that still holds a counter afterwards has its watches moved, a counter that expired reached zero
+// and publishes to them, and anything else just drops them.
+static int watch_keyspace_event(RedisModuleCtx *ctx, int type, const char *event, RedisModuleString *key_name) {
+    // A key the wheel expired while checking on it is found empty by `watch_fire`, which publishes the same as we would.
+    if (WatchCount == 0 || WatchWheelFiring) {
+        return REDISMODULE_OK;
+    }
+
+    // Opening the key can expire it, which lands back in here, so the watches are only looked up once it's open.
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ);
+    const DegradingCounterData *counter = degrading_counter_from_key(key);
+    const int is_empty = RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY;
+    WatchedKey *watched_key = watch_find_key(RedisModule_GetSelectedDb(ctx), key_name);
+
+    if (watched_key != NULL) {
+        if (counter != NULL) {
+            watch_reschedule_key(ctx, watched_key, counter);
+        } else if (is_empty && type == REDISMODULE_NOTIFY_EXPIRED) {
+            watch_reschedule_key(ctx, watched_key, NULL);
+        } else {
+            watch_drop_key(watched_key);
+        }
+    }
+
+    RedisModule_CloseKey(key);
+
+    return REDISMODULE_OK;
+}
+
+// FLUSHDB and FLUSHALL don't send keyspace events, every watch in the flushed databases goes once they're done.
+static void watch_flush_event(RedisModuleCtx *ctx, RedisModuleEvent event, uint64_t subevent, void *data) {
+    const RedisModuleFlushInfo *info = data;
+
+    if (subevent != REDISMODULE_SUBEVENT_FLUSHDB_END || WatchCount == 0) {
+        return;
+    }
+
+    for (int db = 0; db < WatchedKeysDbCount; db++) {
+        if (WatchedKeys[db] == NULL || (info->dbnum != -1 && info->dbnum != db)) {
+            continue;
+        }
+
+        RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(WatchedKeys[db], "^", NULL, 0);
+        WatchedKey *watched_key;
+
+        // Dropping the last watch on a key deletes it from the dictionary, so the iterator is started over each time.
+        while (RedisModule_DictNextC(iter, NULL, (void **)&watched_key) != NULL) {
+            watch_drop_key(watched_key);
+            RedisModule_DictIteratorReseekC(iter, "^", NULL, 0);
+        }
+
+        RedisModule_DictIteratorStop(iter);
+    }
+}
+
+// SWAPDB moves every key, so the watches go along with them.
+static void watch_swapdb_event(RedisModuleCtx *ctx, RedisModuleEvent event, uint64_t subevent, void *data) {
+    const RedisModuleSwapDbInfo *info = data;
+    const int first = info->dbnum_first, second = info->dbnum_second;
+
+    if (WatchCount == 0 || (first >= WatchedKeysDbCount && second >= WatchedKeysDbCount)) {
+        return;
+    }
+
+    watch_keys_for_db(first > second ? first : second, 1);
+
+    RedisModuleDict *swapped = WatchedKeys[first];
+    WatchedKeys[first] = WatchedKeys[second];
+    WatchedKeys[second] = swapped;
+
+    for (int i = 0; i < 2; i++) {
+        const int db = i == 0 ? first : second;
+
+        if (WatchedKeys[db] == NULL) {
+            continue;
+        }
+
+        RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(WatchedKeys[db], "^", NULL, 0);
+        WatchedKey *watched_key;
+
+        while (RedisModule_DictNextC(iter, NULL, (void **)&watched_key) != NULL) {
+            watched_key->db = db;
+        }
+
+        RedisModule_DictIteratorStop(iter);
+    }
+}
+
+// ------- Commands
+
+// Watch a counter (DC.WATCH): publish the key name to a channel once the counter drops below a threshold. Replies with
+// the time (Unix milliseconds) it's expected to, 0 if it's already below or -1 if it never will (nothing is watched
+// for either). Watching the same key, threshold and channel again replaces the existing watch.
+// DC.WATCH blocked:user:42 BELOW 5 CHANNEL unblocks
+int watch_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 6) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    double threshold;
+
+    if (strcmp(RedisModule_StringPtrLen(argv[2], NULL), "BELOW") != 0 ||
+        strcmp(RedisModule_StringPtrLen(argv[4], NULL), "CHANNEL") != 0) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR syntax error, expected DC.WATCH key BELOW <threshold> CHANNEL <name>. (Remember argument names are case sensitive.)");
+    }
+
+    if (RedisModule_StringToDouble(argv[3], &threshold) != REDISMODULE_OK) {
+        stats_record_parse_error();
+        return RedisModule_ReplyWithError(ctx, "ERR invalid value for threshold: must be a signed double.");
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ);
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    const DegradingCounterData *counter = degrading_counter_from_key(key);
+
+    if (counter == NULL) {
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    if (degrading_counter_compute_value(ctx, counter, degrading_counter_now()) < threshold) {
+        return RedisModule_ReplyWithLongLong(ctx, 0);
+    }
+
+    const mstime_t fires_at = degrading_counter_compute_crossing_time(counter, threshold);
+
+    // A threshold of zero or less, or a counter that doesn't decay, would only ever sit there.
+    if (fires_at == REDISMODULE_NO_EXPIRE) {
+        return RedisModule_ReplyWithLongLong(ctx, -1);
+    }
+
+    const int db = RedisModule_GetSelectedDb(ctx);
+    WatchedKey *watched_key = watch_find_key(db, argv[1]);
+
+    if (watched_key == NULL) {
+        watched_key = RedisModule_Alloc(sizeof(WatchedKey));
+        watched_key->db = db;
+        watched_key->key_name = RedisModule_CreateStringFromString(NULL, argv[1]);
+        watched_key->watches = NULL;
+
+        RedisModule_DictSet(watch_keys_for_db(db, 1), argv[1], watched_key);
+    }
+
+    Watch *watch = watched_key->watches;
+
+    while (watch != NULL && (watch->threshold != threshold ||
+                             RedisModule_StringCompare(watch->channel, argv[5]) != 0)) {
+        watch = watch->sibling;
+    }
+
+    if (watch == NULL) {
+        watch = RedisModule_Alloc(sizeof(Watch));
+        watch->watched_key = watched_key;
+        watch->fires_at = REDISMODULE_NO_EXPIRE;
+        watch->threshold = threshold;
+        watch->channel = RedisModule_CreateStringFromString(NULL, argv[5]);
+        watch->sibling = watched_key->watches;
+        watched_key->watches = watch;
+        WatchCount++;
+    }
+
+    watch_schedule(ctx, watch, fires_at);
+
+    return RedisModule_ReplyWithLongLong(ctx, fires_at);
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(watch_RedisCommand, StatsWatch)
+
+// Called from `RedisModule_OnLoad` to create the command and hook up the events that clean up after keys.
+int watch_register(RedisModuleCtx *ctx) {
+    Wheel.current = RedisModule_Milliseconds();
+
+    if (RedisModule_SubscribeToKeyspaceEvents(ctx, REDISMODULE_NOTIFY_GENERIC|REDISMODULE_NOTIFY_EXPIRED|REDISMODULE_NOTIFY_EVICTED,
+                                              watch_keyspace_event) == REDISMODULE_ERR ||
+        RedisModule_SubscribeToServerEvent(ctx, RedisModuleEvent_FlushDB, watch_flush_event) == REDISMODULE_ERR ||
+        RedisModule_SubscribeToServerEvent(ctx, RedisModuleEvent_SwapDB, watch_swapdb_event) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    // Watches aren't part of the dataset, so DC.WATCH works on a replica too (it publishes on the replica).
+    if (RedisModule_CreateCommand(ctx, "dc.watch",
+        watch_RedisCommand_Timed, "readonly fast", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}
@@ -0,0 +1,449 @@
+#include "redismodule.h"
+#include "module.h"
+#include <limits.h>
+#include <string.h>
+
+// Sliding window counters answer "how much happened in the last N seconds", which a single decaying value can't. The
+// window is split into a ring of equally sized buckets that lives inline in the value, right behind a small header, so
+// an increment touches one contiguous allocation. Old buckets are only cleared when the key is accessed and a running
+// total is kept alongside them, so reading the window sum never has to walk the ring.
+
+#define WINDOW_COUNTER_TYPE_NAME "DeGrad-WN"
+#define WINDOW_COUNTER_ENCODING_VERSION 0
+
+// 64k buckets is already half a megabyte of doubles, anything finer grained than that should be a different window.
+#define WINDOW_COUNTER_MAX_BUCKETS 65536
+
+// The widest bucket DC.WINCR can create, a single bucket spanning the longest interval there is.
+#define WINDOW_COUNTER_MAX_BUCKET_WIDTH ((mstime_t)DEGRADING_COUNTER_MAX_NUMBER_OF_INCREMENTS * (MICROSECONDS_PER_DAY / MICROSECONDS_PER_MILLISECOND))
+
+static RedisModuleType *WindowCounter;
+
+typedef struct WindowCounterData {
+    double total; // Sum of every bucket, kept up to date so reads are O(1).
+    mstime_t bucket_width; // In milliseconds.
+    long long last_slot; // The newest slot the ring has been advanced to.
+    uint32_t bucket_count;
+    double buckets[]; // Slot `n` lives in `buckets[n % bucket_count]`.
+} WindowCounterData;
+
+// Slots are aligned to the Unix epoch rather than to the key's creation, that way the buckets of every key with the same
+// width line up with each other, and with whatever is charting them.
+static inline long long window_counter_slot(const WindowCounterData *window, const mstime_t now) {
+    return now / window->bucket_width;
+}
+
+static inline size_t window_counter_size(const uint32_t bucket_count) {
+    return sizeof(WindowCounterData) + (size_t)bucket_count * sizeof(double);
+}
+
+WindowCounterData *window_counter_create(const mstime_t bucket_width, const uint32_t bucket_count, const mstime_t now) {
+    WindowCounterData *window = RedisModule_Calloc(1, window_counter_size(bucket_count));
+
+    window->bucket_width = bucket_width;
+    window->bucket_count = bucket_count;
+    window->last_slot = window_counter_slot(window, now);
+
+    return window;
+}
+
+// Restored windows come from a client (DC.WRESTORE) or a payload (RESTORE), so they're held to what DC.WINCR could have
+// created. A negative slot would index the ring backwards, and one too far out overflows the expire.
+static int window_counter_is_valid_shape(const long long bucket_width, const long long last_slot, const long long bucket_count) {
+    return bucket_width >= 1 && bucket_width <= WINDOW_COUNTER_MAX_BUCKET_WIDTH &&
+           bucket_count >= 1 && bucket_count <= WINDOW_COUNTER_MAX_BUCKETS &&
+           last_slot >= 0 && last_slot <= LLONG_MAX / bucket_width - bucket_count;
+}
+
+// Summing the ring from scratch gets rid of whatever floating point error the running total has picked up.
+static void window_counter_recompute_total(WindowCounterData *window) {
+    double total = 0;
+
+    for (uint32_t i = 0; i < window->bucket_count; i++) {
+        total += window->buckets[i];
+    }
+
+    window->total = total;
+}
+
+// Move the ring forward to the current slot, clearing every bucket that has fallen out of the window on the way.
+void window_counter_advance(WindowCounterData *window, const mstime_t now) {
+    const long long slot = window_counter_slot(window, now);
+
+    if (slot <= window->last_slot) {
+        return;
+    }
+
+    // Nothing has touched the key for a whole window, so everything in it is stale.
+    if (slot - window->last_slot >= window->bucket_count) {
+        memset(window->buckets, 0, (size_t)window->bucket_count * sizeof(double));
+        window->total = 0;
+        window->last_slot = slot;
+        return;
+    }
+
+    int wrapped = 0;
+
+    for (long long next = window->last_slot + 1; next <= slot; next++) {
+        const uint32_t index = (uint32_t)(next % window->bucket_count);
+
+        window->total -= window->buckets[index];
+        window->buckets[index] = 0;
+        wrapped |= index == 0;
+    }
+
+    window->last_slot = slot;
+
+    // Subtracting buckets back out of the total isn't exact, so once per trip around the ring we start over from the
+    // buckets themselves. That keeps the drift bounded and the cost amortized to O(1) per bucket.
+    if (wrapped) {
+        window_counter_recompute_total(window);
+    }
+}
+
+// The window's total as of `now`, without moving the ring: the buckets that would be cleared come out of a copy of the
+// total instead. It comes to the same as `window_counter_advance` would leave, including summing what's left from
+// scratch once the ring wraps.
+static double window_counter_total_at(const WindowCounterData *window, const mstime_t now) {
+    const long long slot = window_counter_slot(window, now);
+
+    if (slot <= window->last_slot) {
+        return window->total;
+    }
+
+    if (slot - window->last_slot >= window->bucket_count) {
+        return 0;
+    }
+
+    double total = window->total;
+    int wrapped = 0;
+
+    for (long long next = window->last_slot + 1; next <= slot; next++) {
+        const uint32_t index = (uint32_t)(next % window->bucket_count);
+
+        total -= window->buckets[index];
+        wrapped |= index == 0;
+    }
+
+    if (wrapped) {
+        total = 0;
+
+        for (long long live = slot - window->bucket_count + 1; live <= window->last_slot; live++) {
+            total += window->buckets[live % window->bucket_count];
+        }
+    }
+
+    return total;
+}
+
+// Once the newest bucket has left the window the whole key is empty, so that's when it expires.
+void window_counter_update_expire(RedisModuleKey *key, const WindowCounterData *window) {
+    RedisModule_SetAbsExpire(key, (window->last_slot + window->bucket_count) * window->bucket_width);
+}
+
+// Replicate the ring a write left behind rather than the write itself. A replica replaying DC.WINCR would pick the
+// bucket from its own clock, which is off from ours by however long the replication stream took.
+static void window_counter_replicate_state(RedisModuleCtx *ctx, RedisModuleString *key_name, const WindowCounterData *window) {
+    RedisModule_Replicate(ctx, "DC.WRESTORE", "sllb",
+                          key_name,
+                          (long long)window->bucket_width,
+                          window->last_slot,
+                          (long long)window->bucket_count,
+                          (const char *)window->buckets, (size_t)window->bucket_count * sizeof(double));
+}
+
+// Parse `AMOUNT`, `WINDOW` and `BUCKETS` from the name/value pairs starting at `argv[2]`. Replies with an error and
+// returns REDISMODULE_ERR if anything is missing or invalid.
+int window_counter_parse_arguments(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc, double *amount,
+                                   mstime_t *bucket_width, uint32_t *bucket_count) {
+    int has_amount = 0;
+    mstime_t window_length = 0;
+    long long buckets = 0;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const char *arg_name = RedisModule_StringPtrLen(argv[i], NULL);
+
+        if (strcmp(arg_name, "AMOUNT") == 0) {
+            if (RedisModule_StringToDouble(argv[i + 1], amount) != REDISMODULE_OK) {
+                RedisModule_ReplyWithError(ctx, "ERR invalid value for AMOUNT: must be a signed double.");
+                stats_record_parse_error();
+                return REDISMODULE_ERR;
+            }
+
+            has_amount = 1;
+        } else if (strcmp(arg_name, "WINDOW") == 0) {
+            const char *window_str = RedisModule_StringPtrLen(argv[i + 1], NULL);
+            int number_of_increments;
+            CounterIncrements unit;
+
+            // Buckets are at least a millisecond wide.
+            if (degrading_counter_parse_interval_string(window_str, &number_of_increments, &unit) != 0 || unit == Microseconds) {
+                RedisModule_ReplyWithErrorFormat(ctx, "ERR invalid value for WINDOW: %s", window_str);
+                stats_record_parse_error();
+                return REDISMODULE_ERR;
+            }
+
+            window_length = degrading_counter_unit_in_milliseconds(unit) * (mstime_t)number_of_increments;
+        } else if (strcmp(arg_name, "BUCKETS") == 0) {
+            if (RedisModule_StringToLongLong(argv[i + 1], &buckets) != REDISMODULE_OK ||
+                buckets < 1 || buckets > WINDOW_COUNTER_MAX_BUCKETS) {
+                RedisModule_ReplyWithErrorFormat(ctx, "ERR invalid value for BUCKETS: must be an integer between 1 and %d.", WINDOW_COUNTER_MAX_BUCKETS);
+                stats_record_parse_error();
+                return REDISMODULE_ERR;
+            }
+        } else {
+            RedisModule_ReplyWithErrorFormat(ctx, "ERR unexpected argument: %s. (Remember argument names are case sensitive.)", arg_name);
+            stats_record_parse_error();
+            return REDISMODULE_ERR;
+        }
+    }
+
+    if (!has_amount || window_length == 0 || buckets == 0) {
+        RedisModule_ReplyWithError(ctx, "ERR AMOUNT, WINDOW and BUCKETS are all required.");
+        stats_record_parse_error();
+        return REDISMODULE_ERR;
+    }
+
+    // Buckets are whole milliseconds wide, a window that doesn't split evenly would silently be shorter than asked for.
+    if (window_length % buckets != 0) {
+        RedisModule_ReplyWithError(ctx, "ERR WINDOW must split into BUCKETS whole milliseconds.");
+        stats_record_parse_error();
+        return REDISMODULE_ERR;
+    }
+
+    *bucket_width = window_length / buckets;
+    *bucket_count = (uint32_t)buckets;
+
+    return REDISMODULE_OK;
+}
+
+// ------- Commands
+
+// DC.WINCR key AMOUNT <amount> WINDOW <interval> BUCKETS <count>
+int window_counter_increment_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Starting] (DC.WINCR) window_counter_increment_RedisCommand");
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 8) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ|REDISMODULE_WRITE);
+    const int key_type = RedisModule_KeyType(key);
+
+    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != WindowCounter) {
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    double amount;
+    mstime_t bucket_width;
+    uint32_t bucket_count;
+
+    // The arguments are validated even when the key exists so a typo doesn't go unnoticed until the key expires.
+    if (window_counter_parse_arguments(ctx, argv, argc, &amount, &bucket_width, &bucket_count) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+
+    const mstime_t now = degrading_counter_now() / MICROSECONDS_PER_MILLISECOND;
+    WindowCounterData *window;
+
+    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
+        window = window_counter_create(bucket_width, bucket_count, now);
+        RedisModule_ModuleTypeSetValue(key, WindowCounter, window);
+    } else {
+        // An existing window keeps the shape it was created with.
+        window = RedisModule_ModuleTypeGetValue(key);
+        window_counter_advance(window, now);
+    }
+
+    window->buckets[window->last_slot % window->bucket_count] += amount;
+    window->total += amount;
+
+    window_counter_update_expire(key, window);
+
+    RedisModule_ReplyWithDouble(ctx, window->total);
+    window_counter_replicate_state(ctx, argv[1], window);
+
+    DEGRADING_COUNTER_LOG_DEBUG(ctx, "[Finishing] (DC.WINCR) window_counter_increment_RedisCommand");
+
+    return REDISMODULE_OK;
+}
+
+// DC.WPEEK key
+int window_counter_peek_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ);
+    const int key_type = RedisModule_KeyType(key);
+
+    if (key_type == REDISMODULE_KEYTYPE_EMPTY) {
+        return RedisModule_ReplyWithNull(ctx);
+    }
+
+    if (RedisModule_ModuleTypeGetType(key) != WindowCounter) {
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    // The ring is left where it is, the next write moves it along (and replicates that).
+    const WindowCounterData *window = RedisModule_ModuleTypeGetValue(key);
+
+    return RedisModule_ReplyWithDouble(ctx, window_counter_total_at(window, degrading_counter_now() / MICROSECONDS_PER_MILLISECOND));
+}
+
+// DC.WRESTORE key <bucket width ms> <last slot> <bucket count> <buckets>
+//
+// Emitted by the AOF rewrite, and replicated in place of DC.WINCR, it recreates a window exactly as it was. `buckets`
+// is the raw array of doubles.
+int window_counter_restore_RedisCommand(RedisModuleCtx *ctx, RedisModuleString **argv, const int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc != 6) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    long long bucket_width, last_slot, bucket_count;
+    size_t buckets_len;
+    const char *buckets = RedisModule_StringPtrLen(argv[5], &buckets_len);
+
+    if (RedisModule_StringToLongLong(argv[2], &bucket_width) != REDISMODULE_OK ||
+        RedisModule_StringToLongLong(argv[3], &last_slot) != REDISMODULE_OK ||
+        RedisModule_StringToLongLong(argv[4], &bucket_count) != REDISMODULE_OK ||
+        !window_counter_is_valid_shape(bucket_width, last_slot, bucket_count) ||
+        buckets_len != (size_t)bucket_count * sizeof(double)) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid window payload.");
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ|REDISMODULE_WRITE);
+    const int key_type = RedisModule_KeyType(key);
+
+    if (key_type != REDISMODULE_KEYTYPE_EMPTY &&
+        RedisModule_ModuleTypeGetType(key) != WindowCounter) {
+        return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    }
+
+    WindowCounterData *window = window_counter_create(bucket_width, (uint32_t)bucket_count, 0);
+    window->last_slot = last_slot;
+    memcpy(window->buckets, buckets, buckets_len);
+    window_counter_recompute_total(window);
+
+    RedisModule_ModuleTypeSetValue(key, WindowCounter, window);
+    window_counter_update_expire(key, window);
+
+    window_counter_replicate_state(ctx, argv[1], window);
+
+    return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+DEGRADING_COUNTER_TIMED_COMMAND(window_counter_increment_RedisCommand, StatsWindowIncrement)
+DEGRADING_COUNTER_TIMED_COMMAND(window_counter_peek_RedisCommand, StatsWindowPeek)
+
+// ------- Native Type Callbacks.
+
+void *window_counter_rdb_load(RedisModuleIO *io, int encoding_version) {
+    if (encoding_version != WINDOW_COUNTER_ENCODING_VERSION) {
+        return NULL;
+    }
+
+    const mstime_t bucket_width = RedisModule_LoadSigned(io);
+    const long long last_slot = RedisModule_LoadSigned(io);
+    const uint64_t bucket_count = RedisModule_LoadUnsigned(io);
+
+    if (bucket_count > WINDOW_COUNTER_MAX_BUCKETS || !window_counter_is_valid_shape(bucket_width, last_slot, (long long)bucket_count)) {
+        return NULL;
+    }
+
+    WindowCounterData *window = window_counter_create(bucket_width, (uint32_t)bucket_count, 0);
+    window->last_slot = last_slot;
+
+    for (uint32_t i = 0; i < window->bucket_count; i++) {
+        window->buckets[i] = RedisModule_LoadDouble(io);
+    }
+
+    // The total isn't saved, it's cheaper to rebuild it than to store it and it comes back without any drift.
+    window_counter_recompute_total(window);
+
+    return window;
+}
+
+void window_counter_rdb_save(RedisModuleIO *io, void *ptr) {
+    const WindowCounterData *window = ptr;
+
+    RedisModule_SaveSigned(io, window->bucket_width);
+    RedisModule_SaveSigned(io, window->last_slot);
+    RedisModule_SaveUnsigned(io, window->bucket_count);
+
+    for (uint32_t i = 0; i < window->bucket_count; i++) {
+        RedisModule_SaveDouble(io, window->buckets[i]);
+    }
+}
+
+void window_counter_aof_rewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
+    const WindowCounterData *window = value;
+
+    // Replaying the increments isn't possible, they've been summed into buckets, so we hand the ring over as is.
+    RedisModule_EmitAOF(aof, "DC.WRESTORE", "sllb",
+                        key,
+                        (long long)window->bucket_width,
+                        window->last_slot,
+                        (long long)window->bucket_count,
+                        (const char *)window->buckets, (size_t)window->bucket_count * sizeof(double));
+}
+
+void window_counter_free(void *value) {
+    RedisModule_Free(value);
+}
+
+size_t window_counter_mem_usage(const void *value) {
+    const WindowCounterData *window = value;
+
+    return window_counter_size(window->bucket_count);
+}
+
+size_t window_counter_free_effort(RedisModuleString *key, const void *value) {
+    // A single allocation no matter how many buckets.
+    return 1;
+}
+
+// Called from `RedisModule_OnLoad` to create the type and its commands.
+int window_counter_register(RedisModuleCtx *ctx) {
+    RedisModuleTypeMethods tm = {
+        .version = REDISMODULE_TYPE_METHOD_VERSION,
+        .rdb_load = window_counter_rdb_load,
+        .rdb_save = window_counter_rdb_save,
+        .aof_rewrite = window_counter_aof_rewrite,
+        .mem_usage = window_counter_mem_usage,
+        .free = window_counter_free,
+        .free_effort = window_counter_free_effort
+    };
+
+    WindowCounter = RedisModule_CreateDataType(ctx,
+        WINDOW_COUNTER_TYPE_NAME,
+        WINDOW_COUNTER_ENCODING_VERSION,
+        &tm);
+
+    if (WindowCounter == NULL) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.wincr",
+        window_counter_increment_RedisCommand_Timed, "fast write", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.wpeek",
+        window_counter_peek_RedisCommand_Timed, "readonly fast", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "dc.wrestore",
+        window_counter_restore_RedisCommand, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    return REDISMODULE_OK;
+}